@@ -0,0 +1,236 @@
+// Headless benchmark suite behind `scons bench`. Prints a table and writes the results as
+// JSON (to the file given as the first argument, or bench.json) for tracking over time.
+// Each result is the median of several repetitions.
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "OpenGLWindow.hpp"
+
+struct Result {
+    std::string name;
+    std::string unit;
+    double value;
+};
+
+static std::vector<Result> results;
+
+// Median over reps of f(), which returns the measured value.
+static void measure(std::string const& name, std::string const& unit, std::function<double()> f, unsigned reps = 5) {
+    std::vector<double> values;
+    for (unsigned r = 0; r < reps; ++r)
+        values.push_back(f());
+    std::sort(values.begin(), values.end());
+    const double median = values[values.size() / 2];
+    results.push_back(Result { name, unit, median });
+    std::printf("%-36s %14.2f %s\n", name.c_str(), median, unit.c_str());
+}
+
+static double secondsSince(std::uint64_t startNs) { return (oglw::clockNs() - startNs) * 1e-9; }
+
+static oglw::OpenGLWindowParams sized(unsigned width, unsigned height) {
+    oglw::OpenGLWindowParams params;
+    params.width = width;
+    params.height = height;
+    return params;
+}
+
+static void benchCreation() {
+    for (unsigned size : { 800u, 1920u }) {
+        const unsigned count = size == 800 ? 2000 : 200;
+        measure("window_create_destroy_" + std::to_string(size), "us", [&]() {
+            const std::uint64_t start = oglw::clockNs();
+            for (unsigned i = 0; i < count; ++i) {
+                oglw::HeadlessWindow win(sized(size, size * 9 / 16));
+                win.process();
+            }
+            return secondsSince(start) * 1e6 / count;
+        });
+    }
+}
+
+static void benchDispatch() {
+    struct Case { const char* name; oglw::Event first, second; };
+    const Case cases[] = {
+        { "keydown", oglw::Event::keyDown('A'), oglw::Event::keyDown('B') },
+        { "keyup", oglw::Event::keyUp('A'), oglw::Event::keyUp('B') },
+        { "mousedown", oglw::Event::mouseDown(1, 2, oglw::MouseInfo::Button::Left), oglw::Event::mouseDown(3, 4, oglw::MouseInfo::Button::Right) },
+        { "mouseup", oglw::Event::mouseUp(1, 2, oglw::MouseInfo::Button::Left), oglw::Event::mouseUp(3, 4, oglw::MouseInfo::Button::Right) },
+        { "activate", oglw::Event::activate(true), oglw::Event::activate(false) },
+        // Coalesced: one callback per process(), so this measures the queue and bookkeeping
+        { "mousemove", oglw::Event::mouseMove(1, 2), oglw::Event::mouseMove(3, 4) },
+        { "resize", oglw::Event::resize(640, 480), oglw::Event::resize(800, 600) },
+    };
+
+    const unsigned count = 200000;
+    for (Case const& c : cases) {
+        oglw::HeadlessWindow win;
+        unsigned long long calls = 0;
+        win.keydownCallback = [&](oglw::KeyInfo) { ++calls; };
+        win.keyupCallback = [&](oglw::KeyInfo) { ++calls; };
+        win.mousedownCallback = [&](oglw::MouseInfo) { ++calls; };
+        win.mouseupCallback = [&](oglw::MouseInfo) { ++calls; };
+        win.mousemoveCallback = [&](oglw::MouseInfo) { ++calls; };
+        win.resizeCallback = [&](unsigned, unsigned) { ++calls; };
+        win.activateCallback = [&](bool) { ++calls; };
+
+        measure(std::string("dispatch_") + c.name, "Mevents/s", [&]() {
+            for (unsigned i = 0; i < count; ++i)
+                win.postEvent(i & 1 ? c.second : c.first);
+            const std::uint64_t start = oglw::clockNs();
+            win.process();
+            return count / secondsSince(start) / 1e6;
+        });
+        if (calls == 0)
+            throw std::runtime_error(std::string("no callbacks for ") + c.name);
+    }
+}
+
+static void benchPlotting() {
+    const unsigned width = 1280, height = 720;
+    oglw::PixelSurface surface(width, height);
+    const double pixels = double(width) * height;
+    std::vector<std::uint32_t> sprite(64 * 64, oglw::rgba(255, 0, 0, 128));
+
+    measure("plot_per_pixel", "Mpx/s", [&]() {
+        const std::uint64_t start = oglw::clockNs();
+        for (unsigned y = 0; y < height; ++y)
+            for (unsigned x = 0; x < width; ++x)
+                surface.plot(x, y, oglw::rgba(x, y, 0));
+        return pixels / secondsSince(start) / 1e6;
+    });
+    measure("plot_fill_rect", "Mpx/s", [&]() {
+        const std::uint64_t start = oglw::clockNs();
+        for (unsigned y = 0; y < height; y += 16)
+            surface.fillRect(0, y, width, 16, oglw::rgba(0, y, 0));
+        return pixels / secondsSince(start) / 1e6;
+    });
+    measure("plot_blit_blend_64", "Mpx/s", [&]() {
+        const std::uint64_t start = oglw::clockNs();
+        for (unsigned y = 0; y + 64 <= height; y += 64)
+            for (unsigned x = 0; x + 64 <= width; x += 64)
+                surface.blit(sprite.data(), 64, 64, 64, x, y);
+        return (width / 64) * (height / 64) * 4096.0 / secondsSince(start) / 1e6;
+    });
+    if (surface.getPixel(0, 0) == 0)
+        throw std::runtime_error("nothing was drawn");
+}
+
+static void benchFrameLoop() {
+    const unsigned frames = 100000;
+    {
+        oglw::HeadlessWindow win;
+        win.displayFunc = []() { };
+        measure("frame_empty_display_process", "ns/frame", [&]() {
+            const std::uint64_t start = oglw::clockNs();
+            for (unsigned i = 0; i < frames; ++i) {
+                win.display();
+                win.process();
+            }
+            return secondsSince(start) * 1e9 / frames;
+        });
+
+        oglw::FramePacing unpaced;
+        unpaced.targetFps = 0;
+        unpaced.updateRate = 0;
+        unpaced.maxFrames = frames;
+        measure("frame_empty_run_unpaced", "ns/frame", [&]() {
+            const oglw::RunStats stats = win.run(unpaced);
+            return stats.wallSeconds * 1e9 / stats.frames;
+        });
+    }
+    {
+        // The whole surface uploaded every frame, and only a 64x64 rectangle of it.
+        oglw::HeadlessWindow win(sized(1280, 720));
+        bool full = true;
+        win.displayFunc = [&]() {
+            if (full)
+                win.pixels().markAllDirty();
+            else
+                win.pixels().markDirty(600, 320, 64, 64);
+        };
+        for (const char* name : { "frame_pixel_surface_720p", "frame_pixel_surface_720p_dirty_64x64" }) {
+            measure(name, "us/frame", [&]() {
+                const std::uint64_t start = oglw::clockNs();
+                for (unsigned i = 0; i < 1000; ++i) {
+                    win.display();
+                    win.process();
+                }
+                return secondsSince(start) * 1e6 / 1000;
+            });
+            full = false;
+        }
+    }
+}
+
+static void benchCapture() {
+    const unsigned width = 1280, height = 720, frames = 120;
+    const struct { const char* name; oglw::CaptureFormat format; const char* path; } formats[] = {
+        { "raw", oglw::CaptureFormat::Raw, "bench_capture.tmp" },
+        { "y4m", oglw::CaptureFormat::Y4M, "bench_capture.tmp" },
+    };
+    for (auto const& f : formats) {
+        measure(std::string("capture_") + f.name + "_720p", "frames/s", [&]() {
+            oglw::HeadlessWindow win(sized(width, height));
+            win.displayFunc = [&]() { win.pixels().clear(oglw::rgba(1, 2, 3)); };
+            oglw::CaptureParams params;
+            params.path = f.path;
+            params.format = f.format;
+            win.startCapture(params);
+            const std::uint64_t start = oglw::clockNs();
+            for (unsigned i = 0; i < frames; ++i) {
+                win.display();
+                win.process();
+            }
+            const oglw::CaptureStats stats = win.stopCapture();
+            const double seconds = secondsSince(start);
+            std::remove(f.path);
+            if (stats.writeFailed || stats.written != frames)
+                throw std::runtime_error("capture lost frames");
+            return frames / seconds;
+        }, 3);
+    }
+}
+
+static void writeJson(std::ostream& out) {
+    out << "{\"suite\":\"oglw\",\"compiler\":\"";
+#if defined(__clang__)
+    out << "clang " << __clang_major__ << '.' << __clang_minor__;
+#elif defined(__GNUC__)
+    out << "gcc " << __GNUC__ << '.' << __GNUC_MINOR__;
+#elif defined(_MSC_VER)
+    out << "msvc " << _MSC_VER;
+#endif
+    out << "\",\"pixel_kernels\":\"" << oglw::kernels::isaName(oglw::kernels::active().isa) << "\",\"results\":[";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        out << (i ? "," : "") << "{\"name\":\"" << results[i].name << "\",\"unit\":\"" << results[i].unit
+            << "\",\"value\":" << results[i].value << '}';
+    }
+    out << "]}\n";
+}
+
+int main(int argc, char** argv) {
+    try {
+        benchCreation();
+        benchDispatch();
+        benchPlotting();
+        benchFrameLoop();
+        benchCapture();
+
+        const char* path = argc > 1 ? argv[1] : "bench.json";
+        std::ofstream out(path);
+        writeJson(out);
+        if (!out)
+            throw std::runtime_error(std::string("can't write ") + path);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what();
+        return 1;
+    }
+}
@@ -0,0 +1,119 @@
+// Frame rate of the headless window with capture off and in each format and overflow
+// policy, plus a check of what ended up on disk.
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "OpenGLWindow.hpp"
+
+static long fileSize(const char* path) {
+    std::FILE* f = std::fopen(path, "rb");
+    if (!f)
+        return -1;
+    std::fseek(f, 0, SEEK_END);
+    const long size = std::ftell(f);
+    std::fclose(f);
+    return size;
+}
+
+struct Run {
+    const char* name;
+    bool capture;
+    oglw::CaptureFormat format;
+    oglw::CaptureOverflow overflow;
+    const char* path;
+};
+
+int main() {
+    try {
+        const unsigned width = 1280, height = 720, frames = 120;
+        const Run runs[] = {
+            { "off", false, oglw::CaptureFormat::Raw, oglw::CaptureOverflow::Block, "" },
+            { "raw block", true, oglw::CaptureFormat::Raw, oglw::CaptureOverflow::Block, "bench_capture.raw" },
+            { "raw drop", true, oglw::CaptureFormat::Raw, oglw::CaptureOverflow::Drop, "bench_capture.raw" },
+            { "y4m block", true, oglw::CaptureFormat::Y4M, oglw::CaptureOverflow::Block, "bench_capture.y4m" },
+            { "y4m drop", true, oglw::CaptureFormat::Y4M, oglw::CaptureOverflow::Drop, "bench_capture.y4m" },
+            { "png block", true, oglw::CaptureFormat::Png, oglw::CaptureOverflow::Block, "bench_capture_%03u.png" },
+            { "png drop", true, oglw::CaptureFormat::Png, oglw::CaptureOverflow::Drop, "bench_capture_%03u.png" },
+        };
+
+        std::printf("%-10s %9s %9s %8s %8s %10s\n", "mode", "fps", "written", "dropped", "blocked", "MB");
+        for (Run const& run : runs) {
+            oglw::OpenGLWindowParams params;
+            params.width = width;
+            params.height = height;
+            oglw::HeadlessWindow win(params);
+            unsigned frame = 0;
+            win.displayFunc = [&]() {
+                win.pixels().clear(oglw::rgba(frame & 255, 64, 128));
+                win.pixels().fillRect(frame * 8 % width, 100, 64, 64, oglw::rgba(255, 255, 255));
+                ++frame;
+            };
+
+            if (run.capture) {
+                oglw::CaptureParams capture;
+                capture.path = run.path;
+                capture.format = run.format;
+                capture.overflow = run.overflow;
+                win.startCapture(capture);
+            }
+
+            const std::uint64_t start = oglw::clockNs();
+            for (unsigned i = 0; i < frames; ++i) {
+                win.display();
+                win.process();
+            }
+            const double seconds = (oglw::clockNs() - start) * 1e-9;
+            const oglw::CaptureStats stats = win.stopCapture();
+            std::printf("%-10s %9.1f %9llu %8llu %7.2fs %10.1f\n", run.name, frames / seconds,
+                stats.written, stats.dropped, stats.blockedSeconds, stats.bytesWritten / 1e6);
+            if (!run.capture)
+                continue;
+
+            if (stats.writeFailed || stats.written + stats.dropped != frames
+                || (run.overflow == oglw::CaptureOverflow::Block && stats.dropped != 0)) {
+                std::cerr << run.name << ": frames went missing\n";
+                return 1;
+            }
+
+            const unsigned long long frameBytes = static_cast<unsigned long long>(width) * height;
+            if (run.format == oglw::CaptureFormat::Raw) {
+                if (fileSize(run.path) != static_cast<long>(stats.written * frameBytes * 4))
+                    throw std::runtime_error("raw capture has the wrong size");
+            }
+            else if (run.format == oglw::CaptureFormat::Y4M) {
+                char header[64];
+                const int headerLength = std::snprintf(header, sizeof(header), "YUV4MPEG2 W%u H%u F60:1 Ip A1:1 C444\n", width, height);
+                if (fileSize(run.path) != static_cast<long>(headerLength + stats.written * (6 + frameBytes * 3)))
+                    throw std::runtime_error("y4m capture has the wrong size");
+            }
+            else {
+                char name[64];
+                std::snprintf(name, sizeof(name), run.path, 0u);
+                unsigned char signature[8] = {};
+                std::FILE* f = std::fopen(name, "rb");
+                if (!f || std::fread(signature, 1, 8, f) != 8 || std::memcmp(signature, "\x89PNG\r\n\x1a\n", 8) != 0)
+                    throw std::runtime_error("png capture is missing or broken");
+                std::fclose(f);
+            }
+
+            if (run.format == oglw::CaptureFormat::Png) {
+                for (unsigned i = 0; i < frames; ++i) {
+                    char name[64];
+                    std::snprintf(name, sizeof(name), run.path, i);
+                    std::remove(name);
+                }
+            }
+            else {
+                std::remove(run.path);
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what();
+        return 1;
+    }
+}
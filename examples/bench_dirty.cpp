@@ -0,0 +1,103 @@
+// Dirty-rectangle presenting: a 64x64 sprite moving over a static 1080p background,
+// presented with dirty tracking and with the threshold at 0 (always the whole surface).
+// Checks that both leave the framebuffer identical to the surface after every frame.
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "OpenGLWindow.hpp"
+
+namespace {
+    const unsigned width = 1920, height = 1080, spriteSize = 64, frames = 300;
+
+    struct Result {
+        double msPerFrame;
+        double bytesPerFrame;
+        oglw::PresentStats stats;
+    };
+
+    Result run(double threshold) {
+        oglw::OpenGLWindowParams params;
+        params.width = width;
+        params.height = height;
+        oglw::HeadlessWindow win(params);
+        win.setDirtyThreshold(threshold);
+
+        oglw::PixelSurface sprite;
+        sprite.resize(spriteSize, spriteSize);
+        for (unsigned y = 0; y < spriteSize; ++y)
+            for (unsigned x = 0; x < spriteSize; ++x)
+                sprite.setPixel(x, y, oglw::rgba(255, x * 4, y * 4, 200));
+
+        // Background drawn once; each frame restores the sprite's old place and draws it anew.
+        int spriteX = 0, spriteY = 0, lastX = 0, lastY = 0;
+        bool first = true;
+        win.displayFunc = [&] {
+            oglw::PixelSurface& s = win.pixels();
+            if (first) {
+                for (unsigned y = 0; y < height; ++y)
+                    s.fillRect(0, y, width, 1, oglw::rgba(y & 255, 64, 128));
+                first = false;
+            }
+            else {
+                for (int y = lastY; y < lastY + int(spriteSize); ++y)
+                    s.fillRect(lastX, y, spriteSize, 1, oglw::rgba(y & 255, 64, 128));
+            }
+            s.blit(sprite, spriteX, spriteY);
+            lastX = spriteX;
+            lastY = spriteY;
+        };
+
+        win.display();
+        win.resetPresentStats();
+
+        double totalNs = 0;
+        for (unsigned f = 0; f < frames; ++f) {
+            spriteX = (f * 7) % (width - spriteSize);
+            spriteY = (f * 3) % (height - spriteSize);
+
+            const std::uint64_t start = oglw::clockNs();
+            win.display();
+            totalNs += oglw::clockNs() - start;
+            win.process();
+
+            oglw::PixelSurface& s = win.pixels();
+            for (unsigned y = 0; y < height; ++y)
+                if (std::memcmp(win.framebuffer() + y * width, s.row(y), width * sizeof(std::uint32_t)) != 0)
+                    throw std::runtime_error("framebuffer differs from the pixel surface");
+        }
+
+        Result r;
+        r.msPerFrame = totalNs / frames * 1e-6;
+        r.stats = win.presentStats();
+        r.bytesPerFrame = r.stats.bytesPerFrame();
+        return r;
+    }
+}
+
+int main() {
+    try {
+        const Result full = run(0.0);
+        const Result dirty = run(0.5);
+
+        std::printf("%-8s %12s %14s %8s %8s %8s\n", "mode", "ms/frame", "bytes/frame", "full", "partial", "rects");
+        std::printf("%-8s %12.3f %14.0f %8llu %8llu %8llu\n", "full", full.msPerFrame, full.bytesPerFrame,
+            full.stats.fullFrames, full.stats.partialFrames, full.stats.rects);
+        std::printf("%-8s %12.3f %14.0f %8llu %8llu %8llu\n", "dirty", dirty.msPerFrame, dirty.bytesPerFrame,
+            dirty.stats.fullFrames, dirty.stats.partialFrames, dirty.stats.rects);
+        std::printf("bytes copied: %.1fx fewer, display %.1fx faster\n",
+            full.bytesPerFrame / dirty.bytesPerFrame, full.msPerFrame / dirty.msPerFrame);
+
+        if (dirty.stats.partialFrames != frames || dirty.bytesPerFrame >= full.bytesPerFrame) {
+            std::cerr << "dirty tracking did not reduce the copy\n";
+            return 1;
+        }
+    }
+    catch (std::exception const& e) {
+        std::cerr << "Exception: " << e.what() << '\n';
+        return 1;
+    }
+}
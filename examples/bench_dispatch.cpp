@@ -0,0 +1,106 @@
+// Event dispatch cost of the std::function callbacks versus a statically dispatched
+// handler. The dispatch call itself is timed on pre-built events in a tight loop (best
+// of five runs), next to a handler that handles nothing: the window's own bookkeeping
+// per event. What each handler adds on top of that is printed separately. The last
+// columns go through postEvent() and process() as a whole.
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+#include "OpenGLWindow.hpp"
+
+struct Counters {
+    unsigned long long keys = 0;
+    unsigned long long buttons = 0;
+    long long checksum = 0;
+};
+
+// Only handles keys and mouse buttons; moves, resizes etc. compile out.
+struct StaticHandler : oglw::EventHandler {
+    Counters counters;
+
+    void onKeyDown(oglw::KeyInfo const& k) { ++counters.keys; counters.checksum += k.key; }
+    void onKeyUp(oglw::KeyInfo const& k) { ++counters.keys; counters.checksum -= k.key; }
+    void onMouseDown(oglw::MouseInfo const& m) { ++counters.buttons; counters.checksum += m.x; }
+    void onMouseUp(oglw::MouseInfo const& m) { ++counters.buttons; counters.checksum -= m.y; }
+};
+
+// Exposes the dispatch that process() runs for every queued event.
+template <class Handler>
+struct Direct : oglw::BasicHeadlessWindow<Handler> {
+    using oglw::BasicHeadlessWindow<Handler>::dispatchEvent;
+};
+
+template <typename Window>
+double nsPerDispatch(Window& win, oglw::Event const& event, unsigned count) {
+    double best = 0;
+    for (unsigned run = 0; run < 5; ++run) {
+        const auto start = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < count; ++i)
+            win.dispatchEvent(event);
+        const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+        best = run == 0 || ns < best ? ns : best;
+    }
+    return best;
+}
+
+template <typename Window>
+double eventsPerSecond(Window& win, oglw::Event const& event, unsigned count) {
+    const unsigned rounds = 20;
+    double seconds = 0;
+    for (unsigned r = 0; r < rounds; ++r) {
+        for (unsigned i = 0; i < count; ++i)
+            win.postEvent(event);
+
+        const auto start = std::chrono::steady_clock::now();
+        win.process();
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return count * double(rounds) / seconds;
+}
+
+int main() {
+    try {
+        const unsigned count = 1000000;
+        const oglw::Event events[] = {
+            oglw::Event::keyDown('W'),
+            oglw::Event::keyUp('W'),
+            oglw::Event::mouseDown(10, 20, oglw::MouseInfo::Button::Left),
+            oglw::Event::mouseUp(10, 20, oglw::MouseInfo::Button::Left),
+        };
+        const char* names[] = { "keydown", "keyup", "mousedown", "mouseup" };
+
+        Direct<oglw::CallbackHandler> dynamicWin;
+        Counters dynamicCounters;
+        dynamicWin.keydownCallback = [&](oglw::KeyInfo k) { ++dynamicCounters.keys; dynamicCounters.checksum += k.key; };
+        dynamicWin.keyupCallback = [&](oglw::KeyInfo k) { ++dynamicCounters.keys; dynamicCounters.checksum -= k.key; };
+        dynamicWin.mousedownCallback = [&](oglw::MouseInfo m) { ++dynamicCounters.buttons; dynamicCounters.checksum += m.x; };
+        dynamicWin.mouseupCallback = [&](oglw::MouseInfo m) { ++dynamicCounters.buttons; dynamicCounters.checksum -= m.y; };
+
+        Direct<StaticHandler> staticWin;
+        Direct<oglw::EventHandler> emptyWin;
+
+        std::printf("%-10s %17s %10s %14s | %22s %10s | %18s %14s\n", "event", "std::function ns", "static ns",
+            "no handler ns", "std::function adds ns", "static adds", "queued std::function", "queued static");
+        for (unsigned i = 0; i < 4; ++i) {
+            const double dynamicNs = nsPerDispatch(dynamicWin, events[i], count);
+            const double staticNs = nsPerDispatch(staticWin, events[i], count);
+            const double emptyNs = nsPerDispatch(emptyWin, events[i], count);
+            const double dynamicRate = eventsPerSecond(dynamicWin, events[i], count);
+            const double staticRate = eventsPerSecond(staticWin, events[i], count);
+            std::printf("%-10s %17.2f %10.2f %14.2f | %22.2f %10.2f | %14.1f M/s %10.1f M/s\n", names[i], dynamicNs,
+                staticNs, emptyNs, dynamicNs - emptyNs, staticNs - emptyNs, dynamicRate / 1e6, staticRate / 1e6);
+        }
+
+        if (dynamicCounters.keys != staticWin.counters.keys || dynamicCounters.checksum != staticWin.counters.checksum) {
+            std::cerr << "handlers saw different events\n";
+            return 1;
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what();
+        return 1;
+    }
+}
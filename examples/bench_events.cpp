@@ -0,0 +1,73 @@
+// Posts 10k synthetic events per frame to a headless window and checks that each
+// frame's process() consumes all of them, so input latency stays within one frame
+// no matter how many events arrive. Also reports the cost of process() per event.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+#include "OpenGLWindow.hpp"
+
+int main() {
+    try {
+        const unsigned eventsPerFrame = 10000;
+        const unsigned frames = 200;
+
+        oglw::HeadlessWindow win;
+
+        unsigned long long moveCallbacks = 0, keyCallbacks = 0, clickCallbacks = 0;
+        unsigned long long collapsedMoves = 0;
+        win.keepMouseMoveHistory = true;
+        win.mousemoveCallback = [&](oglw::MouseInfo) { ++moveCallbacks; collapsedMoves += win.mouseMoves().size(); };
+        win.keydownCallback = [&](oglw::KeyInfo) { ++keyCallbacks; };
+        win.mousedownCallback = [&](oglw::MouseInfo) { ++clickCallbacks; };
+
+        double worstMs = 0, totalMs = 0;
+        unsigned long long postedMoves = 0, postedKeys = 0, postedClicks = 0;
+
+        for (unsigned frame = 0; frame < frames; ++frame) {
+            for (unsigned i = 0; i < eventsPerFrame; ++i) {
+                const int x = static_cast<int>(i % win.getSizeX());
+                const int y = static_cast<int>(frame % win.getSizeY());
+                if (i % 1000 == 999) {
+                    win.postEvent(oglw::Event::keyDown('A' + i % 26));
+                    ++postedKeys;
+                }
+                else if (i % 1000 == 500) {
+                    win.postEvent(oglw::Event::mouseDown(x, y, oglw::MouseInfo::Button::Left));
+                    ++postedClicks;
+                }
+                else {
+                    win.postEvent(oglw::Event::mouseMove(x, y));
+                    ++postedMoves;
+                }
+            }
+
+            win.display();
+            const auto start = std::chrono::steady_clock::now();
+            win.process();
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            worstMs = std::max(worstMs, ms);
+            totalMs += ms;
+
+            // Everything posted before this frame's process() must have been delivered by now.
+            if (keyCallbacks != postedKeys || clickCallbacks != postedClicks || collapsedMoves != postedMoves) {
+                std::cerr << "frame " << frame << ": events left in the queue after process()\n";
+                return 1;
+            }
+        }
+
+        std::printf("events/frame          %u\n", eventsPerFrame);
+        std::printf("process() avg ms      %.3f\n", totalMs / frames);
+        std::printf("process() worst ms    %.3f\n", worstMs);
+        std::printf("ns/event              %.1f\n", totalMs * 1e6 / (double(frames) * eventsPerFrame));
+        std::printf("move callbacks/frame  %.1f (from %.1f moves)\n", double(moveCallbacks) / frames, double(postedMoves) / frames);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what();
+        return 1;
+    }
+}
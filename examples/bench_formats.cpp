@@ -0,0 +1,134 @@
+// Pixel formats: checks that every format converts to and from RGBA8 without drift and
+// that a window presents each one correctly, then compares memory traffic and speed of
+// full-screen fills, sprite blits and presenting at 1080p.
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "OpenGLWindow.hpp"
+
+namespace {
+    const unsigned width = 1920, height = 1080, frames = 60;
+
+    void check(bool ok, std::string const& what) {
+        if (!ok)
+            throw std::runtime_error(what);
+    }
+
+    // Converting to RGBA8 and back gives the same pixel, for every pixel value (RGB565)
+    // or every 8-bit level (R32F); converting RGBA8 in and out loses only low bits.
+    void checkRoundTrip(oglw::RGBA8) {
+        for (unsigned i = 0; i < 1000000; ++i) {
+            const std::uint32_t c = static_cast<std::uint32_t>(std::rand()) * 2654435761u;
+            check(oglw::RGBA8::toRGBA8(oglw::RGBA8::fromRGBA8(c)) == c, "rgba8 round trip");
+        }
+    }
+
+    void checkRoundTrip(oglw::RGB565) {
+        for (unsigned p = 0; p < 65536; ++p) {
+            const std::uint16_t pixel = static_cast<std::uint16_t>(p);
+            check(oglw::RGB565::fromRGBA8(oglw::RGB565::toRGBA8(pixel)) == pixel, "rgb565 round trip");
+        }
+        for (unsigned v = 0; v < 256; ++v) {
+            const std::uint32_t back = oglw::RGB565::toRGBA8(oglw::RGB565::fromRGBA8(oglw::rgba(v, v, v)));
+            check(std::abs(int(back & 0xff) - int(v)) < 8, "rgb565 red precision");
+            check(std::abs(int((back >> 8) & 0xff) - int(v)) < 4, "rgb565 green precision");
+            check(back >> 24 == 255, "rgb565 alpha");
+        }
+        check(oglw::RGB565::toRGBA8(0xffff) == oglw::rgba(255, 255, 255), "rgb565 white");
+    }
+
+    void checkRoundTrip(oglw::R32F) {
+        for (unsigned v = 0; v < 256; ++v) {
+            const std::uint32_t c = oglw::rgba(v, 0, 0);
+            check(oglw::R32F::toRGBA8(oglw::R32F::fromRGBA8(c)) == oglw::rgba(v, v, v), "r32f round trip");
+        }
+        check(oglw::R32F::toRGBA8(-1.0f) == oglw::rgba(0, 0, 0) && oglw::R32F::toRGBA8(2.0f) == oglw::rgba(255, 255, 255),
+            "r32f clamping");
+    }
+
+    template <class Format>
+    struct FormatHandler : oglw::EventHandler {
+        typedef Format PixelFormat;
+        std::function<void()> draw;
+        void onDisplay() { if (draw) draw(); }
+    };
+
+    template <class Format>
+    void run() {
+        typedef oglw::BasicHeadlessWindow<FormatHandler<Format>> Window;
+        typedef typename Window::Surface Surface;
+        typedef typename Surface::Pixel Pixel;
+        checkRoundTrip(Format());
+
+        oglw::OpenGLWindowParams params;
+        params.width = width;
+        params.height = height;
+        Window win(params);
+
+        Surface sprite(64, 64);
+        for (unsigned y = 0; y < 64; ++y)
+            for (unsigned x = 0; x < 64; ++x)
+                sprite.setPixel(x, y, Surface::color(oglw::rgba(x * 4, y * 4, 255)));
+
+        // What the window shows must be the drawn pixels converted with Format::toRGBA8.
+        const Pixel background = Surface::color(oglw::rgba(10, 200, 30));
+        const Pixel lineColor = Surface::color(oglw::rgba(255, 255, 255));
+        win.draw = [&] {
+            Surface& s = win.pixels();
+            s.clear(background);
+            s.blit(sprite, 100, 50);
+            s.drawLine(0, 0, width - 1, height - 1, lineColor);
+        };
+        win.display();
+        Surface& s = win.pixels();
+        for (unsigned y = 0; y < height; ++y)
+            for (unsigned x = 0; x < width; ++x)
+                check(win.framebuffer()[y * width + x] == Format::toRGBA8(s.getPixel(x, y)), std::string(Format::name()) + " present");
+        check(win.framebuffer()[0] == Format::toRGBA8(lineColor), std::string(Format::name()) + " line");
+        check(win.framebuffer()[(height - 1) * width] == Format::toRGBA8(background), std::string(Format::name()) + " clear");
+
+        // Fill: every frame rewrites the whole surface; present copies and converts all of it.
+        unsigned frame = 0;
+        win.draw = [&] {
+            win.pixels().fillRect(0, 0, width, height, Surface::color(oglw::rgba(frame, 255 - frame, 128)));
+        };
+        std::uint64_t start = oglw::clockNs();
+        for (frame = 0; frame < frames; ++frame)
+            win.display();
+        const double fillPresentMs = (oglw::clockNs() - start) * 1e-6 / frames;
+
+        Surface& surface = win.pixels();
+        start = oglw::clockNs();
+        for (frame = 0; frame < frames; ++frame)
+            surface.fillRect(0, 0, width, height, Surface::color(oglw::rgba(frame, 1, 2)));
+        const double fillMs = (oglw::clockNs() - start) * 1e-6 / frames;
+
+        start = oglw::clockNs();
+        for (frame = 0; frame < frames; ++frame)
+            for (unsigned i = 0; i < 500; ++i)
+                surface.blit(sprite, (i * 37 + frame) % (width - 64), (i * 91) % (height - 64));
+        const double blitMs = (oglw::clockNs() - start) * 1e-6 / frames;
+
+        const double surfaceMb = surface.sizeInBytes() / 1e6;
+        std::printf("%-8s %10.2f %10.3f %10.2f %12.3f %14.3f\n", Format::name(), surfaceMb, fillMs,
+            surfaceMb / fillMs, blitMs, fillPresentMs);
+    }
+}
+
+int main() {
+    try {
+        std::printf("%-8s %10s %10s %10s %12s %14s\n", "format", "MB", "fill ms", "GB/s", "500 blits ms", "fill+present");
+        run<oglw::RGBA8>();
+        run<oglw::RGB565>();
+        run<oglw::R32F>();
+    }
+    catch (std::exception const& e) {
+        std::cerr << "Exception: " << e.what() << '\n';
+        return 1;
+    }
+}
@@ -0,0 +1,69 @@
+// Per-frame cost of each GL error checking policy. Every frame issues a bit of GL work
+// and then runs the check, which is what is timed.
+//
+// Needs a GL context; on the headless backend each policy is listed with n/a.
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+#include "OpenGLWindow.hpp"
+
+#if defined(_WIN32) && !defined(OGLW_HEADLESS)
+static void* loadGlProc(const char* name) { return reinterpret_cast<void*>(wglGetProcAddress(name)); }
+#else
+static void* loadGlProc(const char*) { return nullptr; }
+#endif
+
+int main() {
+    try {
+        oglw::Window win;
+        const unsigned frames = 2000;
+
+        const oglw::GlErrorCheck policies[] = {
+            oglw::GlErrorCheck::EveryFrame,
+            oglw::GlErrorCheck::EveryNFrames,
+            oglw::GlErrorCheck::DebugOnly,
+            oglw::GlErrorCheck::DebugCallback,
+            oglw::GlErrorCheck::Never,
+        };
+
+        std::printf("%-16s %-16s %14s\n", "policy", "in effect", "ns/frame");
+        for (auto policy : policies) {
+            oglw::GlErrorChecker checker;
+            const oglw::GlErrorCheck effective = checker.setPolicy(policy, 60, &loadGlProc);
+            if (!oglw::glContextCurrent()) {
+                checker.setPolicy(oglw::GlErrorCheck::Never, 1, &loadGlProc);
+                std::printf("%-16s %-16s %14s\n", oglw::glErrorCheckName(policy), oglw::glErrorCheckName(effective), "n/a");
+                continue;
+            }
+
+            double ns = 0;
+            for (unsigned i = 0; i < frames; ++i) {
+                glClear(GL_COLOR_BUFFER_BIT);
+                glBegin(GL_TRIANGLES);
+                glVertex2f(-1, -1); glVertex2f(1, -1); glVertex2f(0, 1);
+                glEnd();
+
+                const auto start = std::chrono::steady_clock::now();
+                GLenum err = checker.check();
+                std::string queued;
+                if (checker.takeQueued(queued))
+                    err = GL_INVALID_OPERATION;
+                ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+                if (err)
+                    throw oglw::WindowOpenGLException("OpenGL Error occured: " + std::to_string(err));
+                win.process();
+            }
+            checker.setPolicy(oglw::GlErrorCheck::Never, 1, &loadGlProc);
+
+            std::printf("%-16s %-16s %14.1f\n", oglw::glErrorCheckName(policy), oglw::glErrorCheckName(effective), ns / frames);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what();
+        return 1;
+    }
+}
@@ -0,0 +1,82 @@
+// Polled input: checks that win.input() follows the events of each process() call, then
+// measures the cost of querying it and of the tracking itself with no callbacks registered.
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+#include "OpenGLWindow.hpp"
+
+#define CHECK(cond) do { if (!(cond)) throw std::runtime_error("check failed: " #cond); } while (0)
+
+static void checkSnapshot() {
+    typedef oglw::MouseInfo::Button Button;
+    oglw::HeadlessWindow win;
+
+    win.postEvent(oglw::Event::keyDown('W'));
+    win.postEvent(oglw::Event::keyDown(200));
+    win.postEvent(oglw::Event::keyDown('Q'));
+    win.postEvent(oglw::Event::keyUp('Q'));
+    win.postEvent(oglw::Event::mouseMove(10, 20));
+    win.postEvent(oglw::Event::mouseDown(15, 25, Button::Left));
+    CHECK(!win.input().keyDown('W'));               // nothing visible before process()
+    win.process();
+
+    oglw::InputSnapshot const& in = win.input();
+    CHECK(in.keyDown('W') && in.keyDown(200) && !in.keyDown('Q') && !in.keyDown('A'));
+    CHECK(in.keyPressed('Q') && in.keyPressed('W'));
+    CHECK(in.buttonDown(unsigned(Button::Left)) && !in.buttonDown(unsigned(Button::Right)));
+    CHECK(in.mouseX == 15 && in.mouseY == 25 && in.mouseDeltaX == 15 && in.mouseDeltaY == 25);
+
+    win.postEvent(oglw::Event::keyUp('W'));
+    win.postEvent(oglw::Event::mouseMove(12, 30));
+    win.postEvent(oglw::Event::mouseUp(12, 30, Button::Left));
+    win.process();
+    CHECK(!in.keyDown('W') && in.keyDown(200) && !in.keyPressed('Q'));
+    CHECK(!in.buttonDown(unsigned(Button::Left)) && !in.buttonPressed(unsigned(Button::Left)));
+    CHECK(in.mouseDeltaX == -3 && in.mouseDeltaY == 5);
+
+    win.process();
+    CHECK(in.mouseDeltaX == 0 && in.mouseDeltaY == 0);
+
+    win.postEvent(oglw::Event::activate(false));
+    win.process();
+    CHECK(!in.keyDown(200));
+}
+
+int main() {
+    try {
+        checkSnapshot();
+
+        oglw::HeadlessWindow win;
+        for (unsigned k = 0; k < 256; k += 3)
+            win.postEvent(oglw::Event::keyDown(k));
+        win.process();
+
+        // Every key, every "frame"
+        const unsigned frames = 200000;
+        unsigned long long held = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned f = 0; f < frames; ++f) {
+            oglw::InputSnapshot const& in = win.input();
+            for (unsigned k = 0; k < 256; ++k)
+                held += in.keyDown(k ^ (f & 1));
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::printf("keyDown query: %.2f ns (%llu held)\n", seconds * 1e9 / (frames * 256.0), held / frames);
+
+        // Event throughput with tracking only
+        const unsigned count = 1000000;
+        for (unsigned i = 0; i < count; ++i)
+            win.postEvent(i & 1 ? oglw::Event::keyUp(i & 255) : oglw::Event::keyDown(i & 255));
+        start = std::chrono::steady_clock::now();
+        win.process();
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::printf("process() with no callbacks: %.2f M events/s\n", count / seconds / 1e6);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what();
+        return 1;
+    }
+}
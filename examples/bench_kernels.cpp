@@ -0,0 +1,134 @@
+// Checks that every pixel kernel implementation the CPU supports matches the scalar
+// one bit for bit, then reports pixels/sec for clear, rect fill, blended blit and lines.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "PixelKernels.hpp"
+
+using namespace oglw::kernels;
+
+const int width = 1920;
+const int height = 1080;
+
+struct Image {
+    std::vector<std::uint32_t> pixels = std::vector<std::uint32_t>(width * height);
+    std::uint32_t* row(int y) { return pixels.data() + y * width; }
+};
+
+std::uint32_t random32() {
+    return (static_cast<std::uint32_t>(std::rand()) << 16) ^ static_cast<std::uint32_t>(std::rand());
+}
+
+// Draws the same mix of fills, blits and lines through the given kernels.
+void drawScene(Image& image, std::vector<std::uint32_t> const& sprite, int spriteSize, KernelTable const& k, unsigned seed) {
+    std::srand(seed);
+    k.fill(image.pixels.data(), image.pixels.size(), random32());
+    for (int i = 0; i < 200; ++i) {
+        const int x = std::rand() % width, y = std::rand() % height;
+        const int w = std::rand() % 300, h = std::rand() % 300;
+        const std::uint32_t color = random32();
+        for (int yy = y; yy < std::min(y + h, height); ++yy)
+            k.fill(image.row(yy) + x, std::min(x + w, width) - x, color);
+
+        const int sx = std::rand() % (width - spriteSize), sy = std::rand() % (height - spriteSize);
+        for (int yy = 0; yy < spriteSize; ++yy)
+            k.blend(image.row(sy + yy) + sx, sprite.data() + yy * spriteSize, spriteSize);
+
+        line(image.pixels.data(), width, width, height,
+            std::rand() % (width + 200) - 100, std::rand() % (height + 200) - 100,
+            std::rand() % (width + 200) - 100, std::rand() % (height + 200) - 100, random32(), k);
+    }
+}
+
+template <typename F>
+double pixelsPerSecond(double pixelsPerCall, F call) {
+    unsigned calls = 0;
+    const auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed;
+    do {
+        call();
+        ++calls;
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed.count() < 0.25);
+    return pixelsPerCall * calls / elapsed.count();
+}
+
+int main() {
+    const int spriteSize = 64;
+    std::vector<std::uint32_t> sprite(spriteSize * spriteSize);
+    for (auto& p : sprite)
+        p = random32();
+
+    std::vector<KernelTable> tables;
+    for (Isa isa : { Isa::Scalar, Isa::SSE2, Isa::AVX2 }) {
+        if (isaSupported(isa) && kernelsFor(isa).isa == isa)
+            tables.push_back(kernelsFor(isa));
+    }
+
+    Image reference;
+    drawScene(reference, sprite, spriteSize, tables.front(), 1234);
+    for (auto const& k : tables) {
+        Image image;
+        drawScene(image, sprite, spriteSize, k, 1234);
+        if (image.pixels != reference.pixels) {
+            std::cerr << isaName(k.isa) << " output differs from scalar\n";
+            return 1;
+        }
+    }
+
+    // Format conversions and the 16-bit fill, on odd lengths to cover the tails.
+    std::vector<std::uint16_t> rgb565(4099);
+    std::vector<float> gray(4099);
+    for (std::size_t i = 0; i < rgb565.size(); ++i) {
+        rgb565[i] = static_cast<std::uint16_t>(random32());
+        gray[i] = (static_cast<int>(random32() % 3000) - 1000) / 1000.0f;
+    }
+    for (auto const& k : tables) {
+        std::vector<std::uint32_t> expected(rgb565.size()), converted(rgb565.size());
+        tables.front().rgb565ToRgba8(expected.data(), rgb565.data(), rgb565.size());
+        k.rgb565ToRgba8(converted.data(), rgb565.data(), rgb565.size());
+        bool same = converted == expected;
+        tables.front().grayToRgba8(expected.data(), gray.data(), gray.size());
+        k.grayToRgba8(converted.data(), gray.data(), gray.size());
+        same = same && converted == expected;
+        std::vector<std::uint16_t> filled(rgb565.size(), 0);
+        k.fill16(filled.data() + 1, filled.size() - 2, 0xbeef);
+        same = same && filled.front() == 0 && filled.back() == 0 && filled[1] == 0xbeef && filled[filled.size() - 2] == 0xbeef;
+        std::vector<std::uint32_t> source(rgb565.size());
+        for (auto& p : source)
+            p = random32();
+        tables.front().modulate(expected.data(), source.data(), source.size(), 0xc0ff8040u);
+        k.modulate(converted.data(), source.data(), source.size(), 0xc0ff8040u);
+        same = same && converted == expected;
+        if (!same) {
+            std::cerr << isaName(k.isa) << " format kernels differ from scalar\n";
+            return 1;
+        }
+    }
+
+    std::printf("active kernels: %s\n", isaName(active().isa));
+    std::printf("%-8s %14s %14s %14s %14s\n", "isa", "clear Mpx/s", "rect Mpx/s", "blit Mpx/s", "line Mpx/s");
+    for (auto const& k : tables) {
+        Image image;
+        const double clear = pixelsPerSecond(width * height, [&]() {
+            k.fill(image.pixels.data(), image.pixels.size(), 0xff00ff00u);
+        });
+        const double rect = pixelsPerSecond(500.0 * 300, [&]() {
+            for (int y = 100; y < 400; ++y)
+                k.fill(image.row(y) + 101, 500, 0xff0000ffu);
+        });
+        const double blit = pixelsPerSecond(spriteSize * spriteSize, [&]() {
+            for (int y = 0; y < spriteSize; ++y)
+                k.blend(image.row(y + 7) + 13, sprite.data() + y * spriteSize, spriteSize);
+        });
+        const double lines = pixelsPerSecond(64.0 * width, [&]() {
+            for (int i = 0; i < 64; ++i)
+                line(image.pixels.data(), width, width, height, 0, i, width - 1, i + 37, 0xffffffffu, k);
+        });
+        std::printf("%-8s %14.1f %14.1f %14.1f %14.1f\n", isaName(k.isa), clear / 1e6, rect / 1e6, blit / 1e6, lines / 1e6);
+    }
+}
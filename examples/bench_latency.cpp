@@ -0,0 +1,121 @@
+// Input-to-present latency: a headless window on a simulated clock, fed synthetic
+// events with controlled arrival times, must report exactly the queue time, the time
+// to present and the number of frames each event waited. Then measures what tracing
+// costs per event on the real clock and prints the distribution as JSON.
+
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "OpenGLWindow.hpp"
+
+namespace {
+    std::uint64_t simulatedNs = 0;
+    std::uint64_t simulatedClock() { return simulatedNs; }
+
+    const std::uint64_t ms = 1000000;
+
+    void check(bool ok, std::string const& what) {
+        if (!ok)
+            throw std::runtime_error(what);
+    }
+
+    // 60 Hz: process() at the start of each 16 ms frame, present 5 ms later.
+    void simulated() {
+        oglw::HeadlessWindow win;
+        win.setEventClock(&simulatedClock);
+        win.setLatencyTracing(true);
+
+        std::vector<oglw::KeyInfo> keys;
+        win.keydownCallback = [&](oglw::KeyInfo const& k) { keys.push_back(k); };
+        oglw::MouseInfo lastMove = oglw::MouseInfo();
+        win.mousemoveCallback = [&](oglw::MouseInfo const& m) { lastMove = m; };
+
+        auto frame = [&](unsigned n) {
+            simulatedNs = n * 16 * ms;
+            win.process();
+            simulatedNs += 5 * ms;
+            win.display();
+        };
+
+        // Everything but the last move arrives after frame 0's process() and before its
+        // present at 5 ms, so it misses frame 0 and is shown by frame 1.
+        frame(0);
+        win.postEvent(oglw::Event::keyDown(1).at(1 * ms));
+        win.postEvent(oglw::Event::keyDown(2).at(3 * ms));
+        win.postEvent(oglw::Event::mouseMove(10, 10).at(4 * ms));
+        win.postEvent(oglw::Event::mouseMove(20, 20).at(6 * ms));
+        frame(1);
+
+        check(keys.size() == 2, "key callbacks");
+        check(keys[0].time.arrivalNs == 1 * ms && keys[0].time.dispatchNs == 16 * ms, "key 1 stamps");
+        check(keys[0].time.queuedNs() == 15 * ms, "key 1 queued time");
+        check(keys[1].time.arrivalNs == 3 * ms && keys[1].time.dispatchNs == 16 * ms, "key 2 stamps");
+        check(lastMove.x == 20 && lastMove.time.arrivalNs == 6 * ms, "collapsed move carries the last arrival");
+
+        // Presented at 21 ms: 20, 18, 17 and 15 ms after arrival; two frames for all but
+        // the last move.
+        oglw::InputLatency const& latency = win.latency();
+        check(latency.arrivalToPresent().count() == 4, "traced events");
+        check(latency.arrivalToPresent().max() == 20 * ms, "longest arrival to present");
+        check(latency.dispatchToPresent().max() == 5 * ms, "dispatch to present");
+        check(latency.frames().max() == 2 && latency.frames().percentile(0) == 1, "frames waited");
+
+        // Frame 2 presents at 37 ms; one key arrives just before, one just after.
+        frame(2);
+        win.resetLatency();
+        win.postEvent(oglw::Event::keyDown(3).at(38 * ms));
+        win.postEvent(oglw::Event::keyDown(4).at(36 * ms));
+        frame(3);
+        check(latency.frames().count() == 2 && latency.frames().max() == 2 && latency.frames().percentile(0) == 1,
+            "frames waited around a present");
+        check(latency.frames().percentile(0.5) == 1 && latency.frames().percentile(0.95) == 2
+            && latency.frames().percentile(0.99) == 2, "percentiles reach the slow frame");
+        check(latency.arrivalToPresent().max() == 53 * ms - 36 * ms, "arrival to present");
+
+        std::ostringstream json;
+        latency.writeJson(json);
+        std::printf("simulated: %s", json.str().c_str());
+    }
+
+    // Real clock: per-event cost of stamping and tracing.
+    void overhead() {
+        const unsigned frames = 2000, eventsPerFrame = 64;
+        double nsPerEvent[2];
+        for (int traced = 0; traced < 2; ++traced) {
+            oglw::HeadlessWindow win;
+            win.setLatencyTracing(traced != 0);
+            unsigned long long calls = 0;
+            win.keydownCallback = [&](oglw::KeyInfo const&) { ++calls; };
+            const std::uint64_t start = oglw::clockNs();
+            for (unsigned f = 0; f < frames; ++f) {
+                for (unsigned e = 0; e < eventsPerFrame; ++e)
+                    win.postEvent(oglw::Event::keyDown(e));
+                win.process();
+                win.display();
+            }
+            nsPerEvent[traced] = double(oglw::clockNs() - start) / (frames * eventsPerFrame);
+            check(calls == frames * eventsPerFrame, "callbacks");
+            if (traced) {
+                std::ostringstream json;
+                win.latency().writeJson(json);
+                std::printf("real clock: %s", json.str().c_str());
+            }
+        }
+        std::printf("ns per event (post, process, display): %.1f untraced, %.1f traced\n", nsPerEvent[0], nsPerEvent[1]);
+    }
+}
+
+int main() {
+    try {
+        simulated();
+        overhead();
+    }
+    catch (std::exception const& e) {
+        std::cerr << "Exception: " << e.what() << '\n';
+        return 1;
+    }
+}
@@ -0,0 +1,54 @@
+// Pacing accuracy and CPU usage of Window::run() on the headless backend, compared
+// with the unpaced `while (win.display(), win.process());` loop.
+
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+#include "OpenGLWindow.hpp"
+
+void report(const char* name, oglw::RunStats const& s) {
+    std::printf("%-14s %8.1f fps %6.1f%% cpu  late %3llu  dropped %3llu  updates %5llu (dropped %llu)  wake p50 %6.1f us  p99 %7.1f us\n",
+        name, s.fps(), s.cpuUsage() * 100, s.lateFrames, s.droppedFrames, s.updates, s.droppedUpdates,
+        s.wakeError.percentile(0.5) / 1e3, s.wakeError.percentile(0.99) / 1e3);
+}
+
+int main() {
+    try {
+        oglw::HeadlessWindow win;
+
+        double position = 0, previous = 0, rendered = 0;
+        win.updateFunc = [&](double dt) { previous = position; position += 100 * dt; };
+        win.displayFunc = [&]() {
+            const double alpha = win.interpolationAlpha();
+            rendered = previous + (position - previous) * alpha;
+            win.pixels().fillRect(static_cast<int>(rendered) % win.getSizeX(), 100, 16, 16, oglw::rgba(255, 255, 255));
+        };
+
+        oglw::FramePacing unpaced;
+        unpaced.targetFps = 0;
+        unpaced.maxSeconds = 2;
+        report("unpaced", win.run(unpaced));
+
+        for (double fps : { 30.0, 60.0, 144.0 }) {
+            oglw::FramePacing pacing;
+            pacing.targetFps = fps;
+            pacing.updateRate = 120;
+            pacing.maxSeconds = 2;
+            char name[32];
+            std::snprintf(name, sizeof(name), "paced %.0f", fps);
+            report(name, win.run(pacing));
+        }
+
+        // A display that takes 25 ms can't keep 60 fps; expect late and dropped frames.
+        win.displayFunc = [&]() { oglw::waitUntil(oglw::clockNs() + 25000000, 25000000); };
+        oglw::FramePacing overloaded;
+        overloaded.maxSeconds = 1;
+        report("overloaded 60", win.run(overloaded));
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what();
+        return 1;
+    }
+}
@@ -0,0 +1,85 @@
+// Compares plotting N points per frame with glRasterPos2i + glDrawPixels per point
+// against writing them into the window's pixel surface, presented once per frame.
+//
+// The per-pixel column needs a GL context; on the headless backend it prints n/a.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "OpenGLWindow.hpp"
+
+struct Point { int x, y; };
+
+// Each measurement gets a fresh window, so the pixel surface is only presented
+// by the runs that use it. Returns a negative time if the run needs GL and there is
+// no context.
+template <typename F>
+double msPerFrame(oglw::OpenGLWindowParams const& params, unsigned frames, bool usesGl, F draw) {
+    oglw::Window win(params);
+    if (usesGl && !oglw::glContextCurrent())
+        return -1;
+
+    glDisable(GL_DEPTH_TEST);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(0, params.width, params.height, 0, -1, 1);
+
+    win.displayFunc = [&]() { draw(win); };
+    win.display();
+
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < frames; ++i) {
+        win.display();
+        win.process();
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::milli>(elapsed).count() / frames;
+}
+
+int main() {
+    try {
+        auto params = oglw::OpenGLWindowParams{};
+        params.width = 1024;
+        params.height = 1024;
+
+        const GLubyte color[3] = { 255, 0, 0 };
+        const std::uint32_t packed = oglw::rgba(255, 0, 0);
+
+        std::printf("%10s %16s %16s\n", "points", "per-pixel ms", "batched ms");
+        for (unsigned count : { 1000u, 100000u, 1000000u }) {
+            std::vector<Point> points(count);
+            for (auto& p : points) {
+                p.x = std::rand() % params.width;
+                p.y = std::rand() % params.height;
+            }
+            const unsigned frames = count >= 1000000u ? 5 : 50;
+
+            const double perPixel = msPerFrame(params, frames, true, [&](oglw::Window&) {
+                for (auto const& p : points) {
+                    glRasterPos2i(p.x, p.y);
+                    glDrawPixels(1, 1, GL_RGB, GL_UNSIGNED_BYTE, color);
+                }
+            });
+
+            const double batched = msPerFrame(params, frames, false, [&](oglw::Window& win) {
+                oglw::PixelSurface& surface = win.pixels();
+                surface.clear();
+                for (auto const& p : points)
+                    surface.setPixel(p.x, p.y, packed);
+            });
+
+            if (perPixel < 0)
+                std::printf("%10u %16s %16.3f\n", count, "n/a", batched);
+            else
+                std::printf("%10u %16.3f %16.3f\n", count, perPixel, batched);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what();
+        return 1;
+    }
+}
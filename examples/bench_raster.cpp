@@ -0,0 +1,396 @@
+// Software rasterizer on the headless backend: checks that meshes are watertight
+// (stencil counts every pixel of a jittered grid and of a sphere's front faces once),
+// that depth testing doesn't depend on drawing order in any depth format, culling,
+// stencil masking, and that the AVX2 tiles give the same pixels and depths as the scalar
+// ones. Then measures triangles and pixels per second on reference meshes: spheres, a
+// grid of small triangles and layers of full-screen quads, for each depth format.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "OpenGLWindow.hpp"
+
+namespace {
+    using oglw::RasterVertex;
+    using oglw::RasterState;
+    using oglw::DepthFormat;
+    typedef oglw::SoftwareRasterizer<oglw::RGBA8> Rasterizer;
+
+    const unsigned width = 1920, height = 1080;
+    const DepthFormat formats[] = { DepthFormat::D16, DepthFormat::D24, DepthFormat::D32F };
+
+    void check(bool ok, std::string const& what) {
+        if (!ok)
+            throw std::runtime_error(what);
+    }
+
+    const char* formatName(DepthFormat f) {
+        return f == DepthFormat::D16 ? "d16" : f == DepthFormat::D24 ? "d24" : "d32f";
+    }
+
+    // Column vectors, row-major storage.
+    struct Mat4 {
+        float m[16];
+
+        static Mat4 perspective(float fovY, float aspect, float zNear, float zFar) {
+            const float f = 1.f / std::tan(fovY / 2);
+            Mat4 p = { { f / aspect, 0, 0, 0,   0, f, 0, 0,
+                0, 0, (zFar + zNear) / (zNear - zFar), 2 * zFar * zNear / (zNear - zFar),   0, 0, -1, 0 } };
+            return p;
+        }
+
+        RasterVertex apply(float x, float y, float z, std::uint32_t color) const {
+            return RasterVertex { m[0] * x + m[1] * y + m[2] * z + m[3], m[4] * x + m[5] * y + m[6] * z + m[7],
+                m[8] * x + m[9] * y + m[10] * z + m[11], m[12] * x + m[13] * y + m[14] * z + m[15], color };
+        }
+    };
+
+    struct Mesh {
+        std::vector<RasterVertex> vertices;
+        std::vector<std::uint32_t> indices;
+
+        std::size_t triangles() const { return indices.size() / 3; }
+    };
+
+    // UV sphere of the given radius at (cx, cy, cz) in camera space, counterclockwise
+    // from outside, colored by its normal.
+    void addSphere(Mesh& mesh, Mat4 const& projection, float cx, float cy, float cz, float radius, unsigned slices, unsigned stacks) {
+        const std::uint32_t base = static_cast<std::uint32_t>(mesh.vertices.size());
+        const float pi = 3.14159265f;
+        for (unsigned i = 0; i <= stacks; ++i) {
+            const float theta = pi * i / stacks;
+            for (unsigned j = 0; j <= slices; ++j) {
+                const float phi = 2 * pi * j / slices;
+                const float nx = std::sin(theta) * std::cos(phi), ny = std::cos(theta), nz = std::sin(theta) * std::sin(phi);
+                const std::uint32_t color = oglw::rgba(static_cast<std::uint8_t>(127.5f + nx * 127), static_cast<std::uint8_t>(127.5f + ny * 127),
+                    static_cast<std::uint8_t>(127.5f + nz * 127));
+                mesh.vertices.push_back(projection.apply(cx + nx * radius, cy + ny * radius, cz + nz * radius, color));
+            }
+        }
+        for (unsigned i = 0; i < stacks; ++i) {
+            for (unsigned j = 0; j < slices; ++j) {
+                const std::uint32_t a = base + i * (slices + 1) + j, b = a + slices + 1;
+                const std::uint32_t quad[6] = { a, a + 1, b, b, a + 1, b + 1 };
+                mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+            }
+        }
+    }
+
+    // Two triangles per cell of a cols x rows grid over the whole view at depth z (NDC),
+    // interior vertices jittered by up to a third of a cell.
+    Mesh grid(unsigned cols, unsigned rows, float jitter, float z, unsigned seed) {
+        Mesh mesh;
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> offset(-jitter, jitter);
+        for (unsigned i = 0; i <= rows; ++i) {
+            for (unsigned j = 0; j <= cols; ++j) {
+                float x = -1.f + 2.f * j / cols, y = -1.f + 2.f * i / rows;
+                if (i > 0 && i < rows && j > 0 && j < cols) {
+                    x += offset(rng) * 2.f / cols;
+                    y += offset(rng) * 2.f / rows;
+                }
+                mesh.vertices.push_back(RasterVertex { x, y, z, 1.f, oglw::rgba(rng() & 255, rng() & 255, rng() & 255) });
+            }
+        }
+        for (unsigned i = 0; i < rows; ++i) {
+            for (unsigned j = 0; j < cols; ++j) {
+                const std::uint32_t a = i * (cols + 1) + j, b = a + cols + 1;
+                const std::uint32_t quad[6] = { a, a + 1, b + 1, a, b + 1, b };
+                mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+            }
+        }
+        return mesh;
+    }
+
+    Mesh spheres(unsigned count, unsigned slices, unsigned stacks) {
+        Mesh mesh;
+        const Mat4 projection = Mat4::perspective(1.f, float(width) / height, 0.5f, 100.f);
+        const unsigned side = static_cast<unsigned>(std::ceil(std::sqrt(float(count))));
+        for (unsigned i = 0; i < count; ++i) {
+            const float x = (i % side + 0.5f - side / 2.f) * 2.4f, y = (i / side + 0.5f - side / 2.f) * 2.4f;
+            addSphere(mesh, projection, x, y, -2.5f * side, 1.f, slices, stacks);
+        }
+        return mesh;
+    }
+
+    void draw(Rasterizer& r, oglw::PixelSurface& s, Mesh const& mesh, RasterState const& state = RasterState()) {
+        r.drawIndexed(s, mesh.vertices.data(), mesh.indices.data(), mesh.indices.size(), state);
+    }
+
+    RasterState counting() {
+        RasterState state;
+        state.cull = oglw::CullMode::None;
+        state.depthTest = false;
+        state.stencilTest = true;
+        state.depthPass = oglw::StencilOp::IncrementWrap;
+        return state;
+    }
+
+    unsigned countStencil(Rasterizer const& r, unsigned value) {
+        unsigned n = 0;
+        for (unsigned y = 0; y < r.depthStencil().height(); ++y)
+            for (unsigned x = 0; x < r.depthStencil().width(); ++x)
+                n += r.depthStencil().stencil(x, y) == value;
+        return n;
+    }
+
+    // A jittered grid covers every pixel exactly once, on odd sizes too.
+    void watertight() {
+        const unsigned sizes[][2] = { { 640, 360 }, { 333, 211 } };
+        for (auto const& size : sizes) {
+            oglw::PixelSurface s;
+            s.resize(size[0], size[1]);
+            Rasterizer r;
+            r.clear(s);
+            draw(r, s, grid(37, 23, 0.33f, 0.f, size[0]), counting());
+            check(countStencil(r, 1) == size[0] * size[1], "grid pixels drawn other than once");
+        }
+
+        // Front faces of a sphere cover its outline once; with back faces, twice.
+        oglw::PixelSurface s;
+        s.resize(640, 360);
+        Rasterizer r;
+        Mesh sphere;
+        addSphere(sphere, Mat4::perspective(1.f, 640.f / 360, 0.5f, 100.f), 0.3f, -0.2f, -3.f, 1.f, 48, 24);
+        RasterState front = counting();
+        front.cull = oglw::CullMode::Back;
+        r.clear(s);
+        draw(r, s, sphere, front);
+        const unsigned outline = countStencil(r, 1);
+        check(outline > 10000 && countStencil(r, 0) + outline == 640 * 360, "sphere front faces drawn other than once");
+        r.clear(s);
+        draw(r, s, sphere, counting());
+        check(countStencil(r, 2) == outline && countStencil(r, 0) + outline == 640 * 360, "sphere faces drawn other than twice");
+        std::printf("watertight: grids and a sphere (%u pixels) drawn once per pixel\n", outline);
+    }
+
+    // Two triangles that cut through each other look the same drawn in either order.
+    void depthOrder() {
+        const RasterVertex a[3] = { { -0.9f, -0.8f, -0.5f, 1, oglw::rgba(255, 0, 0) }, { 0.9f, -0.6f, 0.5f, 1, oglw::rgba(255, 0, 0) },
+            { 0.f, 0.9f, 0.f, 1, oglw::rgba(255, 0, 0) } };
+        const RasterVertex b[3] = { { -0.8f, 0.7f, 0.6f, 1, oglw::rgba(0, 0, 255) }, { 0.1f, -0.9f, 0.f, 1, oglw::rgba(0, 0, 255) },
+            { 0.9f, 0.8f, -0.6f, 1, oglw::rgba(0, 0, 255) } };
+        for (DepthFormat f : formats) {
+            oglw::PixelSurface images[2];
+            for (int order = 0; order < 2; ++order) {
+                images[order].resize(320, 240);
+                images[order].clear(0);
+                Rasterizer r(f);
+                r.clear(images[order]);
+                RasterState state;
+                state.cull = oglw::CullMode::None;
+                r.drawTriangles(images[order], order ? b : a, 3, state);
+                r.drawTriangles(images[order], order ? a : b, 3, state);
+            }
+            unsigned red = 0, blue = 0;
+            for (unsigned y = 0; y < 240; ++y) {
+                for (unsigned x = 0; x < 320; ++x) {
+                    check(images[0].getPixel(x, y) == images[1].getPixel(x, y), std::string("drawing order changes ") + formatName(f) + " results");
+                    red += images[0].getPixel(x, y) == oglw::rgba(255, 0, 0);
+                    blue += images[0].getPixel(x, y) == oglw::rgba(0, 0, 255);
+                }
+            }
+            check(red > 1000 && blue > 1000, "both triangles partly in front");
+        }
+        std::printf("depth: intersecting triangles independent of order in d16, d24 and d32f\n");
+    }
+
+    void cullingAndStencil() {
+        oglw::PixelSurface s;
+        s.resize(200, 100);
+        Rasterizer r;
+        const RasterVertex ccw[3] = { { -1, -1, 0, 1, 0xFFFFFFFFu }, { 1, -1, 0, 1, 0xFFFFFFFFu }, { 0, 1, 0, 1, 0xFFFFFFFFu } };
+        const RasterVertex cw[3] = { ccw[0], ccw[2], ccw[1] };
+        RasterState state;
+        state.depthTest = false;
+        for (int cull = 0; cull < 3; ++cull) {
+            state.cull = static_cast<oglw::CullMode>(cull);
+            r.resetStats();
+            r.drawTriangles(s, ccw, 3, state);
+            r.drawTriangles(s, cw, 3, state);
+            check(r.stats().pixelsWritten == (cull ? 1u : 2u) * 100 * 100 && r.stats().culled == (cull ? 1u : 0u), "culling");
+        }
+
+        // Mark a rectangle in the stencil buffer without drawing it, then fill the view
+        // where the stencil is set.
+        s.clear(0);
+        r.clear(s);
+        RasterState mark;
+        mark.cull = oglw::CullMode::None;
+        mark.depthTest = false;
+        mark.colorWrite = false;
+        mark.stencilTest = true;
+        mark.stencilRef = 1;
+        mark.depthPass = oglw::StencilOp::Replace;
+        const RasterVertex rect[6] = { { -0.5f, -0.5f, 0, 1, 0 }, { 0.5f, -0.5f, 0, 1, 0 }, { 0.5f, 0.5f, 0, 1, 0 },
+            { -0.5f, -0.5f, 0, 1, 0 }, { 0.5f, 0.5f, 0, 1, 0 }, { -0.5f, 0.5f, 0, 1, 0 } };
+        r.drawTriangles(s, rect, 6, mark);
+        RasterState masked;
+        masked.cull = oglw::CullMode::None;
+        masked.stencilTest = true;
+        masked.stencilFunc = oglw::CompareFunc::Equal;
+        masked.stencilRef = 1;
+        RasterVertex full[6];
+        for (unsigned i = 0; i < 6; ++i)
+            full[i] = RasterVertex { rect[i].x * 2, rect[i].y * 2, 0.5f, 1, oglw::rgba(0, 255, 0) };
+        r.drawTriangles(s, full, 6, masked);
+        unsigned green = 0;
+        for (unsigned y = 0; y < 100; ++y)
+            for (unsigned x = 0; x < 200; ++x)
+                green += s.getPixel(x, y) == oglw::rgba(0, 255, 0) && x >= 50 && x < 150 && y >= 25 && y < 75;
+        check(green == 100 * 50 && countStencil(r, 1) == 100 * 50, "stencil mask");
+        std::printf("culling and stencil masking: ok\n");
+    }
+
+    // Random triangles through all depth functions, crossing the near plane and the view's
+    // edges, give the same pixels and depths with AVX2 and scalar tiles.
+    void simdMatchesScalar() {
+        if (!oglw::kernels::isaSupported(oglw::kernels::Isa::AVX2)) {
+            std::printf("simd: no AVX2 on this CPU, scalar only\n");
+            return;
+        }
+        std::mt19937 rng(5);
+        std::uniform_real_distribution<float> coord(-1.5f, 1.5f), w(0.3f, 2.f);
+        std::vector<RasterVertex> vertices(3 * 600);
+        for (std::size_t i = 0; i < vertices.size(); ++i) {
+            const float vw = i % 50 == 0 ? -0.5f : w(rng);
+            vertices[i] = RasterVertex { coord(rng) * vw, coord(rng) * vw, coord(rng) * vw * 0.9f, vw,
+                oglw::rgba(rng() & 255, rng() & 255, rng() & 255, rng() & 255) };
+            if (i % 3 == 2 && i % 7 == 0)
+                vertices[i - 1].color = vertices[i - 2].color = vertices[i].color;
+        }
+        for (DepthFormat f : formats) {
+            oglw::PixelSurface images[2];
+            Rasterizer rasterizers[2] = { Rasterizer(f), Rasterizer(f) };
+            for (int simd = 0; simd < 2; ++simd) {
+                Rasterizer& r = rasterizers[simd];
+                r.setIsa(simd ? oglw::kernels::Isa::AVX2 : oglw::kernels::Isa::Scalar);
+                images[simd].resize(301, 203);
+                images[simd].clear(0);
+                r.clear(images[simd]);
+                for (int func = 0; func < 8; ++func) {
+                    RasterState state;
+                    state.cull = static_cast<oglw::CullMode>(func % 3);
+                    state.depthFunc = static_cast<oglw::CompareFunc>(func);
+                    state.depthWrite = func % 2 == 0;
+                    r.drawTriangles(images[simd], vertices.data() + func * 225, 225, state);
+                }
+            }
+            for (unsigned y = 0; y < 203; ++y)
+                for (unsigned x = 0; x < 301; ++x)
+                    check(images[0].getPixel(x, y) == images[1].getPixel(x, y)
+                        && rasterizers[0].depthStencil().depth(x, y) == rasterizers[1].depthStencil().depth(x, y),
+                        std::string("avx2 differs from scalar in ") + formatName(f));
+            check(rasterizers[0].stats().pixelsWritten == rasterizers[1].stats().pixelsWritten
+                && rasterizers[0].stats().clipped > 0, "avx2 and scalar statistics");
+        }
+        std::printf("simd: avx2 tiles match scalar ones in d16, d24 and d32f\n");
+    }
+
+    void window() {
+        oglw::OpenGLWindowParams params;
+        params.width = 160;
+        params.height = 120;
+        params.depthBits = 24;
+        oglw::HeadlessWindow win(params);
+        check(win.rasterizer().depthStencil().format() == DepthFormat::D24, "window depth format");
+        const RasterVertex tri[3] = { { -1, -1, 0, 1, oglw::rgba(9, 8, 7) }, { 1, -1, 0, 1, oglw::rgba(9, 8, 7) }, { 0, 1, 0, 1, oglw::rgba(9, 8, 7) } };
+        win.displayFunc = [&] {
+            win.pixels().clear(0);
+            win.rasterizer().clear(win.pixels());
+            win.rasterizer().drawTriangles(win.pixels(), tri, 3);
+        };
+        win.display();
+        check(win.framebuffer()[119 * 160 + 80] == oglw::rgba(9, 8, 7) && win.framebuffer()[0] == 0, "window framebuffer");
+    }
+
+    void measure(const char* name, Mesh const& mesh, std::function<void(Rasterizer&, oglw::PixelSurface&)> frame) {
+        std::vector<oglw::kernels::Isa> isas { oglw::kernels::Isa::Scalar };
+        if (oglw::kernels::isaSupported(oglw::kernels::Isa::AVX2))
+            isas.push_back(oglw::kernels::Isa::AVX2);
+        oglw::PixelSurface s;
+        s.resize(width, height);
+        for (oglw::kernels::Isa isa : isas) {
+            for (DepthFormat f : formats) {
+                Rasterizer r(f);
+                r.setIsa(isa);
+                frame(r, s);
+                r.resetStats();
+                unsigned frames = 0;
+                const std::uint64_t start = oglw::clockNs();
+                std::uint64_t elapsed = 0;
+                do {
+                    frame(r, s);
+                    ++frames;
+                    elapsed = oglw::clockNs() - start;
+                } while (elapsed < 300000000ull);
+                const double seconds = elapsed * 1e-9;
+                oglw::RasterStats const& stats = r.stats();
+                std::printf("%-8s %-6s %-5s %7.3f M tris/s %7.1f M pixels/s, %3.0f%% written, %7.2f ms/frame, %3.0f%% of tiles without edge tests\n",
+                    name, oglw::kernels::isaName(isa), formatName(f), mesh.triangles() * frames / seconds * 1e-6,
+                    stats.pixelsCovered / seconds * 1e-6, 100.0 * stats.pixelsWritten / std::max(1ull, stats.pixelsCovered),
+                    seconds * 1e3 / frames, 100.0 * stats.tilesCovered / std::max(1ull, stats.tilesCovered + stats.tilesPartial));
+            }
+        }
+    }
+
+    void benchmarks() {
+        // 16 spheres of 64x32 quads, about 65k triangles, half of them back faces.
+        const Mesh sphereMesh = spheres(16, 64, 32);
+        measure("spheres", sphereMesh, [&](Rasterizer& r, oglw::PixelSurface& s) {
+            s.clear(0);
+            r.clear(s);
+            draw(r, s, sphereMesh);
+        });
+
+        // 240x135 cells of 8x8 pixels: 64800 triangles of 32 pixels.
+        const Mesh small = grid(240, 135, 0.2f, 0.f, 3);
+        measure("small", small, [&](Rasterizer& r, oglw::PixelSurface& s) {
+            r.clear(s);
+            draw(r, s, small);
+        });
+
+        // Eight full-screen layers drawn back to front (every pixel passes) and front to
+        // back (all but the first layer fail the depth test).
+        Mesh layers;
+        for (unsigned i = 0; i < 8; ++i) {
+            const Mesh layer = grid(1, 1, 0.f, 0.8f - i * 0.2f, i);
+            for (std::uint32_t index : layer.indices)
+                layers.indices.push_back(index + static_cast<std::uint32_t>(layers.vertices.size()));
+            layers.vertices.insert(layers.vertices.end(), layer.vertices.begin(), layer.vertices.end());
+        }
+        Mesh reversed = layers;
+        for (std::size_t i = 0; i < reversed.vertices.size(); ++i)
+            reversed.vertices[i].z = -reversed.vertices[i].z;
+        measure("fill", layers, [&](Rasterizer& r, oglw::PixelSurface& s) {
+            r.clear(s);
+            draw(r, s, layers);
+        });
+        measure("overdraw", reversed, [&](Rasterizer& r, oglw::PixelSurface& s) {
+            r.clear(s);
+            draw(r, s, reversed);
+        });
+    }
+}
+
+int main() {
+    try {
+        watertight();
+        depthOrder();
+        cullingAndStencil();
+        simdMatchesScalar();
+        window();
+        benchmarks();
+    }
+    catch (std::exception const& e) {
+        std::cerr << "Exception: " << e.what() << '\n';
+        return 1;
+    }
+}
@@ -0,0 +1,124 @@
+// Shared memory frame export between two processes: a headless 1080p window publishes
+// frames as fast as it can while a forked consumer maps the newest one and checks it
+// for tearing (every frame is one color derived from its number). Reports the producer's
+// frame rate with and without sharing and how many frames the consumer saw.
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+    #include <sys/wait.h>
+    #include <unistd.h>
+#endif
+
+#include "OpenGLWindow.hpp"
+
+namespace {
+    const unsigned width = 1920, height = 1080;
+    const double seconds = 2.0;
+
+    std::uint32_t colorOf(std::uint64_t frame) { return oglw::rgba(frame & 255, (frame >> 8) & 255, 77); }
+
+    // Child process: exit status 0 if every frame it saw was whole.
+    int consume(std::string const& name) {
+        oglw::SharedFrameReader reader;
+        const std::uint64_t start = oglw::clockNs();
+        while (!reader.open(name)) {
+            if (oglw::clockNs() - start > 5e9)
+                return 2;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        unsigned long long seen = 0, lastFrame = 0;
+        double ageMs = 0;
+        while (oglw::clockNs() - start < (seconds + 1) * 1e9) {
+            if (!reader.acquireLatest()) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                continue;
+            }
+            if (reader.frame() <= lastFrame)
+                return 3;
+            lastFrame = reader.frame();
+            ageMs += (oglw::clockNs() - reader.timeNs()) * 1e-6;
+            const std::uint32_t expected = colorOf(reader.frame());
+            for (unsigned y = 0; y < height; y += 7) {
+                std::uint32_t const* row = reader.row(y);
+                if (row[0] != expected || row[width / 2] != expected || row[width - 1] != expected) {
+                    std::fprintf(stderr, "torn frame %llu at row %u\n", lastFrame, y);
+                    return 4;
+                }
+            }
+            ++seen;
+        }
+        std::printf("consumer: %llu frames seen of %llu published, mean age %.3f ms\n", seen, lastFrame,
+            seen ? ageMs / seen : 0.0);
+        return seen > 0 ? 0 : 5;
+    }
+
+    double produce(bool share, std::string const& name, oglw::SharedFrameStats* stats) {
+        oglw::OpenGLWindowParams params;
+        params.width = width;
+        params.height = height;
+        oglw::HeadlessWindow win(params);
+
+        std::uint64_t frame = 0;
+        win.displayFunc = [&] { win.pixels().clear(colorOf(frame)); };
+        if (share)
+            win.startSharing(name);
+
+        const std::uint64_t start = oglw::clockNs();
+        while (oglw::clockNs() - start < seconds * 1e9) {
+            ++frame;
+            win.display();
+            win.process();
+        }
+        const double fps = frame / ((oglw::clockNs() - start) * 1e-9);
+        if (share)
+            *stats = win.stopSharing();
+        return fps;
+    }
+}
+
+int main() {
+#ifdef _WIN32
+    std::cerr << "this benchmark forks; run it on a POSIX system\n";
+    return 0;
+#else
+    try {
+        const std::string name = "/oglw_bench_" + std::to_string(getpid());
+        const double plainFps = produce(false, name, nullptr);
+
+        std::fflush(stdout);
+        const pid_t child = fork();
+        if (child < 0)
+            throw std::runtime_error("fork failed");
+        if (child == 0) {
+            const int result = consume(name);
+            std::fflush(stdout);
+            _exit(result);
+        }
+
+        oglw::SharedFrameStats stats;
+        const double sharedFps = produce(true, name, &stats);
+        int status = 0;
+        waitpid(child, &status, 0);
+
+        const double mb = width * height * 4 / 1e6;
+        std::printf("producer without sharing: %8.1f fps\n", plainFps);
+        std::printf("producer with sharing:    %8.1f fps, %.2f GB/s published, %llu frames\n",
+            sharedFps, sharedFps * mb / 1e3, stats.published);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::cerr << "consumer failed with status " << (WIFEXITED(status) ? WEXITSTATUS(status) : -1) << '\n';
+            return 1;
+        }
+    }
+    catch (std::exception const& e) {
+        std::cerr << "Exception: " << e.what() << '\n';
+        return 1;
+    }
+#endif
+}
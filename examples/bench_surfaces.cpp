@@ -0,0 +1,102 @@
+// Creation cost of windows and offscreen surfaces, with thousands alive at once. On the
+// headless backend surfaces are pixel surfaces; on WinAPI they are FBO-backed contexts
+// sharing one hidden window, and a few real windows are opened side by side as well.
+
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "Surfaces.hpp"
+
+static double usSince(std::uint64_t startNs, unsigned count) { return (oglw::clockNs() - startNs) * 1e-3 / count; }
+
+int main() {
+    try {
+        {
+            const unsigned count = 8;
+            std::vector<std::unique_ptr<oglw::Window>> windows;
+            const std::uint64_t start = oglw::clockNs();
+            for (unsigned i = 0; i < count; ++i) {
+                oglw::OpenGLWindowParams params;
+                params.title = "window " + std::to_string(i);
+                params.width = 320;
+                params.height = 240;
+                windows.emplace_back(new oglw::Window(params));
+            }
+            std::printf("%u windows at once: %.1f us each\n", count, usSince(start, count));
+        }
+
+        const unsigned count = 4000;
+        oglw::OffscreenParams params;
+        params.width = 128;
+        params.height = 128;
+        oglw::SurfaceRegistry registry;
+        std::vector<oglw::OffscreenSurface*> surfaces;
+
+        std::uint64_t start = oglw::clockNs();
+        for (unsigned i = 0; i < count; ++i)
+            surfaces.push_back(&registry.create(params));
+        std::printf("%u surfaces: %.2f us each (new)\n", count, usSince(start, count));
+
+        // Each surface gets its own contents; read them all back.
+        std::vector<std::uint32_t> readback(params.width * params.height);
+        for (unsigned i = 0; i < count; ++i) {
+            surfaces[i]->makeCurrent();
+#if defined(_WIN32) && !defined(OGLW_HEADLESS)
+            glClearColor((i & 255) / 255.f, ((i >> 8) & 255) / 255.f, 0, 1);
+            glClear(GL_COLOR_BUFFER_BIT);
+#else
+            surfaces[i]->pixels().clear(oglw::rgba(i & 255, (i >> 8) & 255, 0));
+#endif
+        }
+        for (unsigned i = 0; i < count; ++i) {
+            surfaces[i]->readPixels(readback.data());
+            if (readback[params.width * 64 + 64] != oglw::rgba(i & 255, (i >> 8) & 255, 0))
+                throw std::runtime_error("surface " + std::to_string(i) + " has the wrong contents");
+        }
+
+        start = oglw::clockNs();
+        for (auto s : surfaces)
+            registry.destroy(*s);
+        std::printf("%u surfaces: %.2f us each (destroy)\n", count, usSince(start, count));
+
+        surfaces.clear();
+        start = oglw::clockNs();
+        for (unsigned i = 0; i < count; ++i)
+            surfaces.push_back(&registry.create(params));
+        std::printf("%u surfaces: %.2f us each (recycled)\n", count, usSince(start, count));
+        if (registry.size() != count)
+            throw std::runtime_error("registry lost track of surfaces");
+
+#if defined(_WIN32) && !defined(OGLW_HEADLESS)
+        // The registry's hidden window asked for a single-buffered format with no depth or
+        // stencil; windows opened after it still get the buffers they ask for.
+        const unsigned char requests[][2] = { { 16, 0 }, { 24, 8 } };
+        for (auto const& r : requests) {
+            oglw::OpenGLWindowParams windowParams;
+            windowParams.title = "depth " + std::to_string(r[0]);
+            windowParams.width = 320;
+            windowParams.height = 240;
+            windowParams.depthBits = r[0];
+            windowParams.stencilBits = r[1];
+            oglw::Window window(windowParams);
+            HDC dc = wglGetCurrentDC();
+            PIXELFORMATDESCRIPTOR pfd;
+            DescribePixelFormat(dc, GetPixelFormat(dc), sizeof(pfd), &pfd);
+            if (!(pfd.dwFlags & PFD_DOUBLEBUFFER) || pfd.cDepthBits < r[0] || pfd.cStencilBits < r[1])
+                throw std::runtime_error("window asking for depth " + std::to_string(r[0]) + ", stencil " +
+                                         std::to_string(r[1]) + " got another request's pixel format");
+        }
+#endif
+
+        for (auto s : surfaces)
+            registry.destroy(*s);
+        registry.trim();
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what();
+        return 1;
+    }
+}
@@ -0,0 +1,238 @@
+// Coroutine tasks (needs C++20): on a simulated clock, checks that tasks are resumed
+// at the start of display(), before displayFunc, only while the frame's budget lasts, that
+// nextFrame() resumes once per frame, that offloaded work comes back on the window
+// thread, that exceptions reach display() and that background work spread over frames
+// keeps each frame within the budget. Then compares, on the real clock, the worst frame
+// time of doing that work inside displayFunc with spreading it over frames.
+
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "OpenGLWindow.hpp"
+
+#ifndef OGLW_COROUTINES
+
+int main() {
+    std::cerr << "coroutine tasks need C++20; build with std=c++20\n";
+}
+
+#else
+
+namespace {
+    std::uint64_t simulatedNs = 0;
+    std::uint64_t simulatedClock() { return simulatedNs; }
+
+    const std::uint64_t ms = 1000000;
+
+    void check(bool ok, std::string const& what) {
+        if (!ok)
+            throw std::runtime_error(what);
+    }
+
+    // Ten 1 ms steps with a 2.5 ms budget: three steps a frame (the third runs past
+    // the budget by 0.5 ms), then one.
+    void budgeted() {
+        oglw::HeadlessWindow win;
+        win.tasks().setClock(&simulatedClock);
+        win.tasks().setBudget(2.5e-3);
+
+        std::vector<unsigned long long> stepFrames;
+        std::vector<unsigned long long> tickFrames;
+        bool displayedAfterSteps = true;
+        win.displayFunc = [&] { displayedAfterSteps = displayedAfterSteps && stepFrames.size() > 0; };
+
+        win.spawn([](oglw::HeadlessWindow& win, std::vector<unsigned long long>& frames) -> oglw::Task {
+            for (unsigned i = 0; i < 10; ++i) {
+                simulatedNs += ms;
+                frames.push_back(win.frameCount());
+                co_await win.budget();
+            }
+        }(win, stepFrames));
+        win.spawn([](oglw::HeadlessWindow& win, std::vector<unsigned long long>& frames) -> oglw::Task {
+            for (unsigned i = 0; i < 5; ++i) {
+                frames.push_back(win.frameCount());
+                co_await win.nextFrame();
+            }
+        }(win, tickFrames));
+        check(win.tasks().pending() == 2, "spawned tasks wait for display()");
+
+        for (unsigned f = 0; f < 7; ++f) {
+            simulatedNs = f * 16 * ms;
+            win.process();
+            win.display();
+        }
+
+        const std::vector<unsigned long long> expectedSteps { 0, 0, 0, 1, 1, 1, 2, 2, 2, 3 };
+        check(stepFrames == expectedSteps, "budgeted steps per frame");
+        // The stepper spends all of frame 0's budget, so the ticker is deferred to frame 1,
+        // where it goes first; it finishes with its sixth resume in frame 6.
+        const std::vector<unsigned long long> expectedTicks { 1, 2, 3, 4, 5 };
+        check(tickFrames == expectedTicks, "next frame ticks");
+        check(displayedAfterSteps, "tasks run before displayFunc");
+        check(win.tasks().idle(), "tasks finished");
+
+        oglw::TaskStats const& stats = win.tasks().stats();
+        check(stats.completed == 2 && stats.spawned == 2, "completed count");
+        check(stats.overrunFrames == 3 && stats.overrunNs.max() == ms / 2, "overruns");
+        std::ostringstream json;
+        win.tasks().writeJson(json);
+        std::printf("simulated: %s", json.str().c_str());
+    }
+
+    unsigned long long slowSum() {
+        unsigned long long sum = 0;
+        for (unsigned long long i = 0; i < 50000000; ++i)
+            sum += i % 7;
+        return sum;
+    }
+
+    struct Offloaded {
+        std::thread::id windowThread;
+        unsigned long long result = 0, framesWaited = 0;
+        bool workedElsewhere = false, resumedOnWindowThread = false;
+    };
+
+    // Coroutines take what they use as parameters: a lambda's captures would be gone
+    // with the closure by the time the task first runs.
+    oglw::Task sumInBackground(oglw::HeadlessWindow& win, Offloaded& out) {
+        const unsigned long long started = win.frameCount();
+        out.result = co_await win.offload([&out] {
+            out.workedElsewhere = std::this_thread::get_id() != out.windowThread;
+            return slowSum();
+        });
+        out.resumedOnWindowThread = std::this_thread::get_id() == out.windowThread;
+        out.framesWaited = win.frameCount() - started;
+    }
+
+    oglw::Task failInBackground(oglw::HeadlessWindow& win) {
+        co_await win.offload([] { throw std::runtime_error("from worker"); });
+    }
+
+    void offloaded() {
+        oglw::HeadlessWindow win;
+        Offloaded out;
+        out.windowThread = std::this_thread::get_id();
+        win.spawn(sumInBackground(win, out));
+
+        while (!win.tasks().idle()) {
+            win.process();
+            win.display();
+        }
+
+        check(out.result == slowSum(), "offloaded result");
+        check(out.workedElsewhere && out.resumedOnWindowThread, "offload threads");
+        std::printf("offload: resumed %llu frames later on the window thread\n", out.framesWaited);
+
+        // Exceptions from the worker come back through co_await, then out of display().
+        win.spawn(failInBackground(win));
+        bool caught = false;
+        while (!win.tasks().idle()) {
+            try {
+                win.display();
+            }
+            catch (std::runtime_error const& e) {
+                caught = std::string(e.what()) == "from worker";
+            }
+        }
+        check(caught, "exception from task");
+    }
+
+    void spin(std::uint64_t ns) {
+        const std::uint64_t end = oglw::clockNs() + ns;
+        while (oglw::clockNs() < end) { }
+    }
+
+    oglw::Task background(oglw::HeadlessWindow& win, std::uint64_t total, std::uint64_t step) {
+        for (std::uint64_t done = 0; done < total; done += step) {
+            spin(step);
+            co_await win.budget();
+        }
+    }
+
+    oglw::Task simulatedBackground(oglw::HeadlessWindow& win, std::uint64_t total, std::uint64_t step) {
+        for (std::uint64_t done = 0; done < total; done += step) {
+            simulatedNs += step;
+            co_await win.budget();
+        }
+    }
+
+    const unsigned frames = 30;
+    const std::uint64_t work = 20 * ms, step = ms / 4;
+
+    // 20 ms of work a frame for 30 frames, spread by a task that yields to budget() every
+    // 0.25 ms under a 2 ms budget, on the simulated clock: no frame runs past the budget
+    // by more than a step, whatever else the machine is doing.
+    void spreadWork() {
+        oglw::HeadlessWindow win;
+        win.tasks().setClock(&simulatedClock);
+        win.tasks().setBudget(2e-3);
+        win.spawn(simulatedBackground(win, frames * work, step));
+
+        std::uint64_t worst = 0;
+        unsigned f = 0;
+        for (; f < frames * 20 && !win.tasks().idle(); ++f) {
+            const std::uint64_t start = simulatedNs;
+            win.process();
+            win.display();
+            worst = std::max(worst, simulatedNs - start);
+        }
+        check(win.tasks().idle(), "background work finished");
+        check(worst <= 2 * ms + step, "budget kept frames short");
+        check(f >= frames * work / (2 * ms), "work spread over frames");
+        std::printf("simulated spread: %u frames, worst %.2f ms\n", f, worst * 1e-6);
+    }
+
+    // The same work inside displayFunc or spread over frames, on the real clock. Only
+    // printed: preemption can stretch any frame.
+    void frameTimes() {
+
+        for (int spread = 0; spread < 2; ++spread) {
+            oglw::HeadlessWindow win;
+            win.tasks().setBudget(2e-3);
+            if (spread) {
+                win.spawn(background(win, frames * work, step));
+            }
+            else {
+                win.displayFunc = [&] { spin(work); };
+            }
+
+            std::uint64_t worst = 0, total = 0;
+            unsigned f = 0;
+            for (; f < frames * 20 && (spread ? !win.tasks().idle() : f < frames); ++f) {
+                const std::uint64_t start = oglw::clockNs();
+                win.process();
+                win.display();
+                const std::uint64_t ns = oglw::clockNs() - start;
+                worst = std::max(worst, ns);
+                total += ns;
+            }
+            std::printf("%-22s worst frame %6.2f ms, %3u frames, %.1f ms of frames\n",
+                spread ? "spread over frames:" : "inside displayFunc:", worst * 1e-6, f, total * 1e-6);
+            if (spread) {
+                std::ostringstream json;
+                win.tasks().writeJson(json);
+                std::printf("real clock: %s", json.str().c_str());
+            }
+        }
+    }
+}
+
+int main() {
+    try {
+        budgeted();
+        offloaded();
+        spreadWork();
+        frameTimes();
+    }
+    catch (std::exception const& e) {
+        std::cerr << "Exception: " << e.what() << '\n';
+        return 1;
+    }
+}
+
+#endif // OGLW_COROUTINES
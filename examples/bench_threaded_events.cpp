@@ -0,0 +1,85 @@
+// Stress test for threadedEvents on the headless backend: a producer thread plays the
+// event pump and posts key events as fast as it can while the render thread runs frames
+// with a slow-ish display and resizes the window from its own thread. Reports throughput
+// and post-to-dispatch latency, and fails if any event is lost or arrives out of order. Meant to be run under ThreadSanitizer too:
+//   g++ -std=c++11 -O1 -g -fsanitize=thread -I../include bench_threaded_events.cpp -lGL -pthread
+
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "OpenGLWindow.hpp"
+
+int main() {
+    try {
+        oglw::OpenGLWindowParams params;
+        params.threadedEvents = true;
+        oglw::HeadlessWindow win(params);
+
+        const unsigned count = 1000000;
+        std::vector<std::uint64_t> postedNs(count);     // written by the producer before each post
+        oglw::LatencyHistogram latency;
+        unsigned next = 0;
+        bool ordered = true;
+        std::uint64_t firstNs = 0, lastNs = 0;
+
+        win.keydownCallback = [&](oglw::KeyInfo const& k) {
+            const std::uint64_t now = oglw::clockNs();
+            if (k.key != next)
+                ordered = false;
+            latency.add(now - postedNs[next]);
+            if (next == 0)
+                firstNs = now;
+            lastNs = now;
+            ++next;
+        };
+        unsigned resizes = 0, lastWidth = 0;
+        win.resizeCallback = [&](unsigned w, unsigned) { ++resizes; lastWidth = w; };
+        // Stand-in for real rendering, so events pile up between frames.
+        win.displayFunc = [&]() { oglw::waitUntil(oglw::clockNs() + 200000, 200000); };
+
+        std::atomic<bool> producerDone { false };
+        std::thread producer([&]() {
+            for (unsigned i = 0; i < count; ++i) {
+                postedNs[i] = oglw::clockNs();
+                win.postEvent(oglw::Event::keyDown(i));
+            }
+            producerDone.store(true, std::memory_order_release);
+        });
+
+        unsigned long long frames = 0;
+        while (next < count) {
+            const bool done = producerDone.load(std::memory_order_acquire);
+            win.resize(640 + frames % 64, 480);
+            win.process();
+            win.display();
+            ++frames;
+            if (done && next < count)
+                break;      // everything was posted and consumed, yet something is missing
+        }
+        producer.join();
+
+        if (resizes != frames || lastWidth != 640 + (frames - 1) % 64) {
+            std::cerr << "resizes from the render thread: dispatched " << resizes << " of " << frames << "\n";
+            return 1;
+        }
+        if (next != count || !ordered) {
+            std::cerr << "lost or reordered events: dispatched " << next << " of " << count
+                << (ordered ? "" : ", out of order") << "\n";
+            return 1;
+        }
+
+        const double seconds = (lastNs - firstNs) * 1e-9;
+        std::printf("%u events in %llu frames: %.2f M events/s, %.0f events/frame\n",
+            count, frames, seconds > 0 ? count / seconds / 1e6 : 0.0, static_cast<double>(count) / frames);
+        std::printf("post -> dispatch latency: p50 %.1f us  p99 %.1f us  max %.1f us\n",
+            latency.percentile(0.5) / 1e3, latency.percentile(0.99) / 1e3, latency.max() / 1e3);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what();
+        return 1;
+    }
+}
@@ -0,0 +1,85 @@
+// Tiled rendering scaling: frames per second of a per-pixel shader drawn through tileFunc
+// at 1080p and 4K, with 1 to N render threads (N = hardware threads, or the argument).
+// Also checks that every thread count produces the same image.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "OpenGLWindow.hpp"
+
+// A few dozen flops per pixel, roughly a simple fragment shader.
+static void shade(oglw::PixelSurface& surface, oglw::Tile const& tile, float time) {
+    for (unsigned y = tile.y; y < tile.y + tile.height; ++y) {
+        std::uint32_t* row = surface.row(y);
+        for (unsigned x = tile.x; x < tile.x + tile.width; ++x) {
+            const float fx = x * 0.01f, fy = y * 0.01f;
+            const float v = std::sin(fx + time) + std::sin(fy * 1.3f - time) + std::sin((fx + fy) * 0.7f);
+            const int c = static_cast<int>((v + 3.0f) * 42.0f);
+            row[x] = oglw::rgba(c, 255 - c, (c * 3) & 255);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        unsigned maxThreads = argc > 1 ? std::atoi(argv[1]) : std::thread::hardware_concurrency();
+        if (maxThreads == 0)
+            maxThreads = 1;
+
+        const struct { const char* name; unsigned width, height, frames; } sizes[] = {
+            { "1080p", 1920, 1080, 20 },
+            { "4K", 3840, 2160, 6 },
+        };
+
+        // 1, 2, 3, 4, 8, 16, ... and maxThreads itself
+        std::vector<unsigned> threadCounts;
+        for (unsigned t = 1; t < maxThreads; t = t < 4 ? t + 1 : t * 2)
+            threadCounts.push_back(t);
+        threadCounts.push_back(maxThreads);
+
+        std::printf("%-6s %8s %10s %9s\n", "size", "threads", "fps", "speedup");
+        for (auto const& size : sizes) {
+            oglw::OpenGLWindowParams params;
+            params.width = size.width;
+            params.height = size.height;
+            oglw::HeadlessWindow win(params);
+
+            float time = 0;
+            win.tileFunc = [&](oglw::PixelSurface& surface, oglw::Tile const& tile) { shade(surface, tile, time); };
+
+            std::vector<std::uint32_t> reference;
+            double singleFps = 0;
+            for (unsigned threads : threadCounts) {
+                win.setRenderThreads(threads);
+                time = 0;
+                win.display();      // warm up, and the image compared below
+
+                std::vector<std::uint32_t> image(win.framebuffer(), win.framebuffer() + size.width * size.height);
+                if (reference.empty())
+                    reference.swap(image);
+                else if (image != reference)
+                    throw std::runtime_error("tiled output differs between thread counts");
+
+                const std::uint64_t start = oglw::clockNs();
+                for (unsigned f = 0; f < size.frames; ++f) {
+                    time = f * 0.1f;
+                    win.display();
+                    win.process();
+                }
+                const double fps = size.frames / ((oglw::clockNs() - start) * 1e-9);
+                if (threads == 1)
+                    singleFps = fps;
+                std::printf("%-6s %8u %10.2f %8.2fx\n", size.name, threads, fps, fps / singleFps);
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what();
+        return 1;
+    }
+}
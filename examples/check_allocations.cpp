@@ -0,0 +1,264 @@
+// Steady-state heap allocations: replaces the global operator new to count every
+// allocation in the process, warms up headless windows that use events, latency tracing,
+// mouse move history, dirty presenting, tiles, threaded events, shared frames, sprite
+// batches, triangles and the frame arena, then fails if any later frame (posting its events, process(), display())
+// allocates, on any thread.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+    #include <unistd.h>
+#endif
+
+#include "OpenGLWindow.hpp"
+
+namespace {
+    std::atomic<unsigned long long> allocations(0);
+}
+
+void* operator new(std::size_t bytes) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(bytes ? bytes : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t bytes) { return operator new(bytes); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+    const unsigned width = 640, height = 360;
+    const unsigned warmupFrames = 200, frames = 2000;
+
+    struct Point {
+        int x, y;
+    };
+
+    // Calls frame(f) for the warm-up frames, then counts the allocations of each of the rest.
+    template <class Frame>
+    bool steady(const char* name, Frame frame) {
+        for (unsigned f = 0; f < warmupFrames; ++f)
+            frame(f);
+
+        unsigned long long allocating = 0, worst = 0, total = 0;
+        for (unsigned f = warmupFrames; f < warmupFrames + frames; ++f) {
+            const unsigned long long before = allocations.load(std::memory_order_relaxed);
+            frame(f);
+            const unsigned long long n = allocations.load(std::memory_order_relaxed) - before;
+            if (n) {
+                ++allocating;
+                total += n;
+                worst = std::max(worst, n);
+            }
+        }
+        std::printf("%-18s %5llu of %u frames allocated (%llu allocations, worst frame %llu)\n",
+            name, allocating, frames, total, worst);
+        return allocating == 0;
+    }
+
+    oglw::OpenGLWindowParams params(bool threaded = false) {
+        oglw::OpenGLWindowParams p;
+        p.width = width;
+        p.height = height;
+        p.threadedEvents = threaded;
+        return p;
+    }
+
+    // Synthetic input that repeats every 32 frames, so the warm-up sees the busiest frame.
+    template <class Window>
+    void postInput(Window& win, unsigned f) {
+        const unsigned moves = f % 32;
+        for (unsigned i = 0; i < moves; ++i)
+            win.postEvent(oglw::Event::mouseMove(int(i * 7 % width), int(f % height)));
+        win.postEvent(oglw::Event::keyDown(f % 100));
+        win.postEvent(oglw::Event::mouseDown(1, 2, oglw::MouseInfo::Button::Left));
+        win.postEvent(oglw::Event::mouseUp(1, 2, oglw::MouseInfo::Button::Left));
+        win.postEvent(oglw::Event::keyUp(f % 100));
+    }
+
+    // Callbacks, pixel drawing with dirty rectangles, latency tracing, move history and
+    // per-frame containers in the arena.
+    bool callbacks() {
+        oglw::HeadlessWindow win(params());
+        win.setLatencyTracing(true);
+        win.keepMouseMoveHistory = true;
+
+        unsigned long long keys = 0, moves = 0;
+        win.keydownCallback = [&](oglw::KeyInfo const& k) { keys += k.key; };
+        win.mousemoveCallback = [&](oglw::MouseInfo const&) { moves += win.mouseMoves().size(); };
+
+        unsigned frame = 0;
+        win.displayFunc = [&] {
+            oglw::FrameArena& arena = win.frameArena();
+            std::vector<Point, oglw::FrameAllocator<Point>> points { oglw::FrameAllocator<Point>(arena) };
+            const unsigned count = frame % 50 * 400;
+            for (unsigned i = 0; i < count; ++i)
+                points.push_back(Point { int(i % width), int(i * 3 % height) });
+            Point* origin = arena.create<Point>(Point { int(frame % width), int(frame % height) });
+
+            oglw::PixelSurface& s = win.pixels();
+            s.fillRect(origin->x, origin->y, 16, 16, oglw::rgba(frame & 255, 0, 0));
+            for (Point const& p : points)
+                s.setPixel(p.x, p.y, oglw::rgba(0, 255, 0));
+        };
+
+        const bool ok = steady("callbacks", [&](unsigned f) {
+            frame = f;
+            postInput(win, f);
+            win.process();
+            win.display();
+        });
+        oglw::FrameArena& arena = win.frameArena();
+        std::printf("%-18s peak %zu bytes, %zu reserved, %llu heap blocks\n", "  frame arena",
+            arena.peak(), arena.capacity(), arena.blockAllocations());
+        return ok && keys > 0 && moves > 0;
+    }
+
+    // Tiles drawn by the tile pool's workers.
+    bool tiles() {
+        oglw::HeadlessWindow win(params());
+        win.setRenderThreads(4);
+        win.tileFunc = [](oglw::PixelSurface& s, oglw::Tile const& t) {
+            s.fillRect(t.x, t.y, t.width, t.height, oglw::rgba(t.index & 255, t.worker * 60, 0));
+        };
+        return steady("tiles", [&](unsigned f) {
+            postInput(win, f);
+            win.process();
+            win.display();
+        });
+    }
+
+    // Statically dispatched handler.
+    struct Counter : oglw::EventHandler {
+        unsigned long long events = 0, displays = 0;
+        void onDisplay() { ++displays; }
+        void onKeyDown(oglw::KeyInfo const&) { ++events; }
+        void onMouseMove(oglw::MouseInfo const&) { ++events; }
+        void onMouseDown(oglw::MouseInfo const&) { ++events; }
+    };
+
+    bool handler() {
+        oglw::BasicHeadlessWindow<Counter> win(params());
+        return steady("static handler", [&](unsigned f) {
+            postInput(win, f);
+            win.process();
+            win.display();
+        });
+    }
+
+    // Events through the lock-free queue (posted from this thread between frames).
+    bool threaded() {
+        oglw::HeadlessWindow win(params(true));
+        unsigned long long keys = 0;
+        win.keydownCallback = [&](oglw::KeyInfo const&) { ++keys; };
+        return steady("threaded events", [&](unsigned f) {
+            postInput(win, f);
+            win.process();
+            win.display();
+        });
+    }
+
+    // Sprite batches on several layers, a varying number of quads a frame.
+    bool sprites() {
+        oglw::HeadlessWindow win(params());
+        const std::vector<std::uint32_t> image(16 * 16, oglw::rgba(200, 100, 50, 180));
+        const oglw::SpriteTexture texture = win.sprites().addTexture(image.data(), 16, 16, 16);
+
+        unsigned frame = 0;
+        win.displayFunc = [&] {
+            oglw::SpriteBatch& batch = win.sprites();
+            const unsigned count = frame % 32 * 50;
+            for (unsigned i = 0; i < count; ++i) {
+                batch.setLayer(i % 3);
+                batch.draw(texture, float(i * 13 % width), float(i * 7 % height), 24.f, 24.f, oglw::rgba(255, 255, 255, 200));
+                batch.fill(float(i * 5 % width), float(i * 11 % height), 4.f, 4.f, oglw::rgba(0, 0, 255));
+            }
+        };
+        return steady("sprites", [&](unsigned f) {
+            frame = f;
+            postInput(win, f);
+            win.process();
+            win.display();
+        });
+    }
+
+    // Depth and stencil tested triangles, some of them cut by the near plane.
+    bool triangles() {
+        oglw::HeadlessWindow win(params());
+        std::vector<oglw::RasterVertex> vertices;
+        for (unsigned i = 0; i < 300; ++i) {
+            const float x = (i % 20) / 10.f - 1.f, y = (i / 20) / 7.5f - 1.f, w = i % 17 == 0 ? -0.2f : 1.f;
+            vertices.push_back(oglw::RasterVertex { x, y, (i % 9) / 9.f - 0.5f, w, oglw::rgba(i & 255, 40, 90) });
+        }
+        unsigned frame = 0;
+        win.displayFunc = [&] {
+            win.rasterizer().clear(win.pixels());
+            oglw::RasterState state;
+            state.cull = oglw::CullMode::None;
+            state.stencilTest = frame % 2 == 0;
+            state.depthPass = oglw::StencilOp::Increment;
+            win.rasterizer().drawTriangles(win.pixels(), vertices.data(), vertices.size() - frame % 4 * 3, state);
+        };
+        return steady("triangles", [&](unsigned f) {
+            frame = f;
+            postInput(win, f);
+            win.process();
+            win.display();
+        });
+    }
+
+    bool sharing() {
+#ifdef _WIN32
+        const std::string name = "oglw_check_allocations";
+#else
+        const std::string name = "/oglw_check_allocations_" + std::to_string(getpid());
+#endif
+        oglw::HeadlessWindow win(params());
+        win.displayFunc = [&] { win.pixels().clear(oglw::rgba(1, 2, 3)); };
+        win.startSharing(name);
+        const bool ok = steady("shared frames", [&](unsigned f) {
+            postInput(win, f);
+            win.process();
+            win.display();
+        });
+        return win.stopSharing().published > 0 && ok;
+    }
+}
+
+int main() {
+    try {
+        // The hook has to see allocations at all for the rest to mean anything.
+        const unsigned long long before = allocations.load();
+        oglw::FrameArena probe(1024);
+        if (!probe.allocate(16) || allocations.load() == before) {
+            std::cerr << "operator new isn't hooked\n";
+            return 1;
+        }
+
+        bool ok = callbacks();
+        ok = tiles() && ok;
+        ok = handler() && ok;
+        ok = threaded() && ok;
+        ok = sprites() && ok;
+        ok = triangles() && ok;
+        ok = sharing() && ok;
+        if (!ok) {
+            std::cerr << "steady-state frames allocated\n";
+            return 1;
+        }
+    }
+    catch (std::exception const& e) {
+        std::cerr << "Exception: " << e.what() << '\n';
+        return 1;
+    }
+}
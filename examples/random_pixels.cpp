@@ -5,7 +5,7 @@
 #include <cstdint>
 
 #include "OpenGLWindow.hpp"
-#include <GL/GL.h>
+#include <GL/gl.h>
 
 int main() {
     try {
@@ -0,0 +1,120 @@
+// Records a scripted input session to a log, replays it into a fresh window as fast as
+// possible and at recorded speed, and checks that the callbacks see the same events in the
+// same frames. With an argument, replays that log as fast as possible and reports the rate.
+
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+#include "OpenGLWindow.hpp"
+
+// Order- and frame-sensitive hash of everything the callbacks saw.
+struct Trace {
+    unsigned long long hash = 1469598103934665603ull;
+    unsigned long long events = 0;
+    unsigned long long discrete = 0;   // callbacks that aren't coalesced
+    unsigned frame = 0;
+
+    void add(unsigned long long v) {
+        hash = (hash ^ (v + frame * 0x9E3779B97F4A7C15ull)) * 1099511628211ull;
+        ++events;
+        discrete += v < 3000000 || (v >= 4000000 && v < 6000000);
+    }
+
+    void attach(oglw::HeadlessWindow& win) {
+        win.keydownCallback = [this](oglw::KeyInfo k) { add(1000 + k.key); };
+        win.keyupCallback = [this](oglw::KeyInfo k) { add(2000 + k.key); };
+        win.mousemoveCallback = [this](oglw::MouseInfo m) { add(3000000 + m.x * 1000 + m.y); };
+        win.mousedownCallback = [this](oglw::MouseInfo m) { add(4000000 + m.x * 1000 + m.y + 100 * int(m.button)); };
+        win.mouseupCallback = [this](oglw::MouseInfo m) { add(5000000 + m.x * 1000 + m.y + 100 * int(m.button)); };
+        win.resizeCallback = [this](unsigned w, unsigned h) { add(6000000 + w * 1000 + h); };
+        win.activateCallback = [this](bool a) { add(7 + a); };
+    }
+};
+
+int main(int argc, char** argv) {
+    try {
+        if (argc > 1) {
+            oglw::HeadlessWindow win;
+            Trace trace;
+            trace.attach(win);
+            win.replayInput(argv[1]);
+            const std::uint64_t start = oglw::clockNs();
+            while (win.replaying()) {
+                win.process();
+                ++trace.frame;
+            }
+            const double seconds = (oglw::clockNs() - start) * 1e-9;
+            std::printf("%llu events in %u frames, %.3f s: %.2f M events/s\n",
+                trace.events, trace.frame, seconds, trace.events / seconds / 1e6);
+            return 0;
+        }
+
+        const char* path = "replay_input.log";
+        const unsigned frames = 200;
+
+        Trace recorded;
+        double recordedSeconds;
+        {
+            oglw::HeadlessWindow win;
+            recorded.attach(win);
+            win.recordInput(path);
+            std::mt19937 rng(42);
+            const std::uint64_t start = oglw::clockNs();
+            for (unsigned f = 0; f < frames; ++f) {
+                const unsigned n = rng() % 8;
+                for (unsigned i = 0; i < n; ++i) {
+                    const int x = rng() % 800, y = rng() % 600;
+                    switch (rng() % 6) {
+                        case 0: win.postEvent(oglw::Event::keyDown(rng() % 256)); break;
+                        case 1: win.postEvent(oglw::Event::keyUp(rng() % 256)); break;
+                        case 2: win.postEvent(oglw::Event::mouseDown(x, y, oglw::MouseInfo::Button::Left)); break;
+                        case 3: win.postEvent(oglw::Event::mouseUp(x, y, oglw::MouseInfo::Button::Right)); break;
+                        case 4: win.postEvent(oglw::Event::resize(640 + x, 480 + y)); break;
+                        default: win.postEvent(oglw::Event::mouseMove(x, y)); break;
+                    }
+                }
+                win.process();
+                ++recorded.frame;
+                oglw::waitUntil(oglw::clockNs() + 1000000, 100000);
+            }
+            recordedSeconds = (oglw::clockNs() - start) * 1e-9;
+            std::printf("recorded %llu events (%llu callbacks) over %u frames, %.3f s\n",
+                static_cast<unsigned long long>(win.stopRecording()), recorded.events, frames, recordedSeconds);
+        }
+
+        for (oglw::ReplaySpeed speed : { oglw::ReplaySpeed::Fastest, oglw::ReplaySpeed::Recorded }) {
+            oglw::HeadlessWindow win;
+            Trace replayed;
+            replayed.attach(win);
+            win.replayInput(path, speed);
+            const std::uint64_t start = oglw::clockNs();
+            const bool fastest = speed == oglw::ReplaySpeed::Fastest;
+            while (win.replaying()) {
+                win.process();
+                ++replayed.frame;
+                if (!fastest)
+                    oglw::waitUntil(oglw::clockNs() + 1000000, 100000);
+            }
+            const double seconds = (oglw::clockNs() - start) * 1e-9;
+            std::printf("%-9s replay: %llu events, %u frames, %.3f s\n",
+                fastest ? "fastest" : "recorded", replayed.events, replayed.frame, seconds);
+
+            // At recorded speed frames don't line up, so moves and resizes may coalesce differently.
+            if (replayed.discrete != recorded.discrete || (fastest && replayed.hash != recorded.hash)) {
+                std::cerr << "replay doesn't match the recording\n";
+                return 1;
+            }
+            if (!fastest && seconds < recordedSeconds * 0.5) {
+                std::cerr << "recorded-speed replay finished too early\n";
+                return 1;
+            }
+        }
+        std::remove(path);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what();
+        return 1;
+    }
+}
@@ -0,0 +1,43 @@
+// Reference consumer for Window::startSharing(): maps the newest frame a window published
+// under the given name and prints its number, age and the color of its center pixel.
+//
+//     shm_consumer <name> [seconds]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "SharedFrames.hpp"
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <name> [seconds]\n", argv[0]);
+        return 1;
+    }
+    const double seconds = argc > 2 ? std::atof(argv[2]) : 10.0;
+
+    oglw::SharedFrameReader reader;
+    const std::uint64_t start = oglw::clockNs();
+    while (!reader.open(argv[1])) {
+        if (oglw::clockNs() - start > seconds * 1e9) {
+            std::fprintf(stderr, "no frames published as %s\n", argv[1]);
+            return 1;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::printf("%s: %ux%u\n", argv[1], reader.width(), reader.height());
+
+    unsigned long long seen = 0;
+    while (oglw::clockNs() - start < seconds * 1e9) {
+        if (!reader.acquireLatest()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        ++seen;
+        const std::uint32_t center = reader.row(reader.height() / 2)[reader.width() / 2];
+        std::printf("frame %llu, %.2f ms old, center %08x\n", static_cast<unsigned long long>(reader.frame()),
+            (oglw::clockNs() - reader.timeNs()) * 1e-6, center);
+    }
+    std::printf("%llu frames\n", seen);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+namespace oglw {
+
+    // Half-open rectangle [x0, x1) x [y0, y1) in pixels.
+    struct DirtyRect {
+        int x0, y0, x1, y1;
+
+        std::uint64_t area() const { return std::uint64_t(x1 - x0) * std::uint64_t(y1 - y0); }
+        bool empty() const { return x0 >= x1 || y0 >= y1; }
+
+        // Overlapping or sharing an edge.
+        bool touches(DirtyRect const& o) const { return x0 <= o.x1 && o.x0 <= x1 && y0 <= o.y1 && o.y0 <= y1; }
+
+        DirtyRect united(DirtyRect const& o) const {
+            return DirtyRect { std::min(x0, o.x0), std::min(y0, o.y0), std::max(x1, o.x1), std::max(y1, o.y1) };
+        }
+    };
+
+    // Changed part of a surface as at most maxRects disjoint rectangles. Rectangles that
+    // touch are merged; when the set is full, a new one is merged with whichever existing
+    // rectangle grows the least, so the region may cover some unchanged pixels.
+    class DirtyRegion {
+    public:
+        static const unsigned maxRects = 16;
+
+    private:
+        DirtyRect m_Rects[maxRects];
+        unsigned m_Count = 0;
+        bool m_Full = false;
+
+        void remove(unsigned i) { m_Rects[i] = m_Rects[--m_Count]; }
+
+    public:
+        void add(DirtyRect r) {
+            if (m_Full || r.empty())
+                return;
+
+            // Absorb everything the rectangle touches; growing it may make it touch more.
+            for (unsigned i = 0; i < m_Count; ) {
+                if (m_Rects[i].touches(r)) {
+                    r = r.united(m_Rects[i]);
+                    remove(i);
+                    i = 0;
+                }
+                else {
+                    ++i;
+                }
+            }
+
+            if (m_Count == maxRects) {
+                unsigned best = 0;
+                std::uint64_t bestGrowth = ~std::uint64_t(0);
+                for (unsigned i = 0; i < m_Count; ++i) {
+                    const std::uint64_t growth = m_Rects[i].united(r).area() - m_Rects[i].area();
+                    if (growth < bestGrowth) {
+                        bestGrowth = growth;
+                        best = i;
+                    }
+                }
+                const DirtyRect merged = m_Rects[best].united(r);
+                remove(best);
+                add(merged);
+                return;
+            }
+            m_Rects[m_Count++] = r;
+        }
+
+        void markAll() { m_Full = true; m_Count = 0; }
+        void clear() { m_Full = false; m_Count = 0; }
+
+        // The whole surface changed (clear(), resize, untracked writes); rects() is empty then.
+        bool full() const { return m_Full; }
+        bool empty() const { return !m_Full && m_Count == 0; }
+        unsigned count() const { return m_Count; }
+        DirtyRect const* rects() const { return m_Rects; }
+
+        std::uint64_t area() const {
+            std::uint64_t a = 0;
+            for (unsigned i = 0; i < m_Count; ++i)
+                a += m_Rects[i].area();
+            return a;
+        }
+    };
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator for data that lives for one frame. Allocating moves a pointer; nothing
+// is freed on its own, the whole arena is rewound at once by reset(). Memory comes in
+// blocks that are kept from frame to frame. When a frame needed more than one block,
+// reset() replaces them with a single block holding all of it, so once the largest
+// frame has been seen the arena no longer touches the heap.
+namespace oglw {
+
+    class FrameArena {
+        struct Block {
+            std::unique_ptr<unsigned char[]> data;
+            std::size_t size;
+        };
+
+        std::vector<Block> m_Blocks;        // the last one is being allocated from
+        std::size_t m_Offset = 0;           // into the last block
+        std::size_t m_Used = 0;             // since the last reset, including alignment padding
+        std::size_t m_Peak = 0;
+        std::size_t m_BlockSize;
+        unsigned long long m_BlockAllocations = 0;
+
+        void addBlock(std::size_t size) {
+            m_Blocks.push_back(Block { std::unique_ptr<unsigned char[]>(new unsigned char[size]), size });
+            m_Offset = 0;
+            ++m_BlockAllocations;
+        }
+
+        void* bump(std::size_t bytes, std::size_t align) {
+            if (m_Blocks.empty())
+                return nullptr;
+            Block& block = m_Blocks.back();
+            const std::uintptr_t base = reinterpret_cast<std::uintptr_t>(block.data.get());
+            const std::uintptr_t aligned = (base + m_Offset + align - 1) & ~static_cast<std::uintptr_t>(align - 1);
+            const std::size_t start = static_cast<std::size_t>(aligned - base);
+            if (start > block.size || bytes > block.size - start)
+                return nullptr;
+            m_Used += start + bytes - m_Offset;
+            m_Offset = start + bytes;
+            return block.data.get() + start;
+        }
+
+    public:
+        // blockSize: first block, and the least a growing frame adds.
+        explicit FrameArena(std::size_t blockSize = 64 * 1024)
+            : m_BlockSize(std::max<std::size_t>(blockSize, 64))
+        { }
+
+        FrameArena(FrameArena const&) = delete;
+        FrameArena& operator=(FrameArena const&) = delete;
+
+        // align must be a power of two.
+        void* allocate(std::size_t bytes, std::size_t align = alignof(std::max_align_t)) {
+            if (void* p = bump(bytes, align))
+                return p;
+            addBlock(std::max(m_BlockSize, bytes + align));
+            return bump(bytes, align);
+        }
+
+        // Uninitialized room for count objects. Arena memory is never destroyed, hence
+        // only for types that don't need it.
+        template <class T>
+        T* allocateArray(std::size_t count) {
+            static_assert(std::is_trivially_destructible<T>::value, "the arena never runs destructors");
+            return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+        }
+
+        template <class T, class... Args>
+        T* create(Args&&... args) {
+            static_assert(std::is_trivially_destructible<T>::value, "the arena never runs destructors");
+            return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+
+        // Rewinds the arena; everything allocated from it is gone.
+        void reset() {
+            m_Peak = std::max(m_Peak, m_Used);
+            if (m_Blocks.size() > 1) {
+                const std::size_t total = capacity();
+                m_Blocks.clear();
+                addBlock(total);
+            }
+            m_Offset = 0;
+            m_Used = 0;
+        }
+
+        // Makes room for frames of this many bytes up front; only between frames.
+        void reserve(std::size_t bytes) {
+            if (m_Used == 0 && capacity() < bytes) {
+                m_Blocks.clear();
+                addBlock(bytes);
+            }
+        }
+
+        std::size_t used() const { return m_Used; }
+        std::size_t peak() const { return std::max(m_Peak, m_Used); }       // largest frame so far
+        std::size_t capacity() const {
+            std::size_t total = 0;
+            for (Block const& b : m_Blocks)
+                total += b.size;
+            return total;
+        }
+        // Times the arena went to the heap; stops changing once it's warmed up.
+        unsigned long long blockAllocations() const { return m_BlockAllocations; }
+    };
+
+    // Standard allocator on a FrameArena, for containers that live for one frame:
+    //     std::vector<Vertex, FrameAllocator<Vertex>> v(FrameAllocator<Vertex>(win.frameArena()));
+    // Deallocation does nothing; the memory comes back with the arena's reset().
+    template <class T>
+    struct FrameAllocator {
+        typedef T value_type;
+
+        FrameArena* arena;
+
+        explicit FrameAllocator(FrameArena& arena) : arena(&arena) { }
+        template <class U>
+        FrameAllocator(FrameAllocator<U> const& other) : arena(other.arena) { }
+
+        T* allocate(std::size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+        void deallocate(T*, std::size_t) { }
+    };
+
+    template <class T, class U>
+    bool operator==(FrameAllocator<T> const& a, FrameAllocator<U> const& b) { return a.arena == b.arena; }
+    template <class T, class U>
+    bool operator!=(FrameAllocator<T> const& a, FrameAllocator<U> const& b) { return a.arena != b.arena; }
+}
@@ -0,0 +1,312 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FrameTiming.hpp"
+
+// Asynchronous frame dumping: the render thread copies each frame into one of a few
+// preallocated buffers and a writer thread encodes them to disk.
+namespace oglw {
+
+    enum class CaptureFormat {
+        Raw,    // RGBA8 frames back to back, top row first, no header
+        Y4M,    // YUV4MPEG2, 4:4:4, BT.601 studio range
+        Png,    // one RGB PNG per frame (stored, not compressed); path is a printf pattern, e.g. "frame_%05u.png"
+    };
+
+    enum class CaptureOverflow {
+        Block,  // the render thread waits for a free buffer
+        Drop,   // the frame is skipped and counted
+    };
+
+    struct CaptureParams {
+        std::string path = "capture.y4m";
+        CaptureFormat format = CaptureFormat::Y4M;
+        CaptureOverflow overflow = CaptureOverflow::Block;
+        unsigned buffers = 4;
+        unsigned fps = 60;          // only recorded in the Y4M header
+    };
+
+    struct CaptureStats {
+        unsigned long long submitted = 0;
+        unsigned long long written = 0;
+        unsigned long long dropped = 0;     // full ring with CaptureOverflow::Drop, or frame size changed
+        unsigned long long bytesWritten = 0;
+        double blockedSeconds = 0;          // render thread waiting for a buffer
+        bool writeFailed = false;
+    };
+
+    class FrameCapture {
+        CaptureParams m_Params;
+        unsigned m_Width, m_Height;
+        std::size_t m_FrameBytes;
+        std::unique_ptr<std::uint8_t[]> m_Ring;
+
+        mutable std::mutex m_Mutex;
+        std::condition_variable m_Cv;
+        unsigned long long m_Produced = 0;      // guarded by m_Mutex
+        unsigned long long m_Consumed = 0;
+        bool m_Stopping = false;
+        CaptureStats m_Stats;
+        std::thread m_Writer;
+
+        std::FILE* m_File = nullptr;
+        std::vector<std::uint8_t> m_Scratch;     // writer thread only
+
+        std::uint8_t* slot(unsigned long long i) { return m_Ring.get() + (i % m_Params.buffers) * m_FrameBytes; }
+
+        static std::uint32_t crc32(std::uint32_t crc, const std::uint8_t* p, std::size_t n) {
+            static std::uint32_t table[256];
+            static bool init = [] {
+                for (std::uint32_t i = 0; i < 256; ++i) {
+                    std::uint32_t c = i;
+                    for (int k = 0; k < 8; ++k)
+                        c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                    table[i] = c;
+                }
+                return true;
+            }();
+            (void)init;
+            crc = ~crc;
+            for (std::size_t i = 0; i < n; ++i)
+                crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+            return ~crc;
+        }
+
+        static void putBE32(std::vector<std::uint8_t>& out, std::uint32_t v) {
+            const std::uint8_t b[4] = { std::uint8_t(v >> 24), std::uint8_t(v >> 16), std::uint8_t(v >> 8), std::uint8_t(v) };
+            out.insert(out.end(), b, b + 4);
+        }
+
+        static void putChunk(std::vector<std::uint8_t>& out, const char* type, std::vector<std::uint8_t> const& data) {
+            putBE32(out, static_cast<std::uint32_t>(data.size()));
+            const std::size_t start = out.size();
+            out.insert(out.end(), type, type + 4);
+            out.insert(out.end(), data.begin(), data.end());
+            putBE32(out, crc32(0, out.data() + start, out.size() - start));
+        }
+
+        // RGB PNG with the image data in stored (uncompressed) deflate blocks.
+        void encodePng(const std::uint8_t* rgba) {
+            std::vector<std::uint8_t> raw;
+            raw.reserve(static_cast<std::size_t>(m_Height) * (1 + 3 * m_Width));
+            for (unsigned y = 0; y < m_Height; ++y) {
+                raw.push_back(0);       // filter: none
+                const std::uint8_t* row = rgba + static_cast<std::size_t>(y) * m_Width * 4;
+                for (unsigned x = 0; x < m_Width; ++x)
+                    raw.insert(raw.end(), row + x * 4, row + x * 4 + 3);
+            }
+
+            std::vector<std::uint8_t> z;
+            z.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+            z.push_back(0x78);
+            z.push_back(0x01);
+            std::uint32_t a = 1, b = 0;
+            for (std::size_t pos = 0; pos < raw.size() || pos == 0; ) {
+                const std::size_t len = raw.size() - pos < 65535 ? raw.size() - pos : 65535;
+                const bool last = pos + len == raw.size();
+                z.push_back(last ? 1 : 0);
+                z.push_back(std::uint8_t(len));
+                z.push_back(std::uint8_t(len >> 8));
+                z.push_back(std::uint8_t(~len));
+                z.push_back(std::uint8_t(~len >> 8));
+                z.insert(z.end(), raw.begin() + pos, raw.begin() + pos + len);
+                for (std::size_t i = pos; i < pos + len; ++i) {
+                    a = (a + raw[i]) % 65521;
+                    b = (b + a) % 65521;
+                }
+                pos += len;
+                if (last)
+                    break;
+            }
+            putBE32(z, (b << 16) | a);
+
+            std::vector<std::uint8_t> ihdr;
+            putBE32(ihdr, m_Width);
+            putBE32(ihdr, m_Height);
+            const std::uint8_t rest[5] = { 8, 2, 0, 0, 0 };      // 8 bits, RGB, deflate, adaptive filters, no interlace
+            ihdr.insert(ihdr.end(), rest, rest + 5);
+
+            static const std::uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+            m_Scratch.assign(signature, signature + 8);
+            putChunk(m_Scratch, "IHDR", ihdr);
+            putChunk(m_Scratch, "IDAT", z);
+            putChunk(m_Scratch, "IEND", std::vector<std::uint8_t>());
+        }
+
+        void encodeY4m(const std::uint8_t* rgba) {
+            static const char frameHeader[] = "FRAME\n";
+            const std::size_t plane = static_cast<std::size_t>(m_Width) * m_Height;
+            m_Scratch.resize(sizeof(frameHeader) - 1 + plane * 3);
+            std::memcpy(m_Scratch.data(), frameHeader, sizeof(frameHeader) - 1);
+            std::uint8_t* yp = m_Scratch.data() + sizeof(frameHeader) - 1;
+            std::uint8_t* up = yp + plane;
+            std::uint8_t* vp = up + plane;
+            for (std::size_t i = 0; i < plane; ++i) {
+                const int r = rgba[i * 4], g = rgba[i * 4 + 1], b = rgba[i * 4 + 2];
+                yp[i] = static_cast<std::uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+                up[i] = static_cast<std::uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+                vp[i] = static_cast<std::uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+            }
+        }
+
+        bool writeFrame(const std::uint8_t* rgba, unsigned long long index) {
+            const std::uint8_t* data = rgba;
+            std::size_t size = m_FrameBytes;
+            std::FILE* file = m_File;
+
+            if (m_Params.format == CaptureFormat::Y4M) {
+                encodeY4m(rgba);
+                data = m_Scratch.data();
+                size = m_Scratch.size();
+            }
+            else if (m_Params.format == CaptureFormat::Png) {
+                encodePng(rgba);
+                data = m_Scratch.data();
+                size = m_Scratch.size();
+                char name[1024];
+                std::snprintf(name, sizeof(name), m_Params.path.c_str(), static_cast<unsigned>(index));
+                file = std::fopen(name, "wb");
+                if (!file)
+                    return false;
+            }
+
+            const bool ok = std::fwrite(data, 1, size, file) == size;
+            if (file != m_File)
+                std::fclose(file);
+            if (ok) {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Stats.bytesWritten += size;
+            }
+            return ok;
+        }
+
+        void writerLoop() {
+            for (;;) {
+                unsigned long long index;
+                {
+                    std::unique_lock<std::mutex> lock(m_Mutex);
+                    m_Cv.wait(lock, [this] { return m_Consumed < m_Produced || m_Stopping; });
+                    if (m_Consumed == m_Produced)
+                        return;
+                    index = m_Consumed;
+                }
+
+                const bool ok = writeFrame(slot(index), index);
+
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                ++m_Consumed;
+                if (ok)
+                    ++m_Stats.written;
+                else
+                    m_Stats.writeFailed = true;
+                m_Cv.notify_all();
+            }
+        }
+
+    public:
+        // Opens the output and starts the writer. Returns false if the file can't be created.
+        bool start(CaptureParams const& params, unsigned width, unsigned height) {
+            m_Params = params;
+            if (m_Params.buffers < 1)
+                m_Params.buffers = 1;
+            m_Width = width;
+            m_Height = height;
+            m_FrameBytes = static_cast<std::size_t>(width) * height * 4;
+            m_Ring.reset(new std::uint8_t[m_FrameBytes * m_Params.buffers]);
+
+            if (m_Params.format != CaptureFormat::Png) {
+                m_File = std::fopen(m_Params.path.c_str(), "wb");
+                if (!m_File)
+                    return false;
+                std::setvbuf(m_File, nullptr, _IOFBF, 1 << 20);
+                if (m_Params.format == CaptureFormat::Y4M)
+                    std::fprintf(m_File, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C444\n", width, height, m_Params.fps);
+            }
+            m_Writer = std::thread([this] { writerLoop(); });
+            return true;
+        }
+
+        unsigned width() const { return m_Width; }
+        unsigned height() const { return m_Height; }
+
+        // Render thread: a buffer of width * height RGBA8 pixels (top row first) for the next
+        // frame, or nullptr if the frame is dropped. Call commit() once it's filled in.
+        std::uint8_t* acquire() {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            ++m_Stats.submitted;
+            if (m_Produced - m_Consumed == m_Params.buffers) {
+                if (m_Params.overflow == CaptureOverflow::Drop) {
+                    ++m_Stats.dropped;
+                    return nullptr;
+                }
+                const std::uint64_t start = clockNs();
+                m_Cv.wait(lock, [this] { return m_Produced - m_Consumed < m_Params.buffers; });
+                m_Stats.blockedSeconds += (clockNs() - start) * 1e-9;
+            }
+            return slot(m_Produced);
+        }
+
+        void commit() {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            ++m_Produced;
+            m_Cv.notify_all();
+        }
+
+        // Frames with another size than the capture's are dropped.
+        void dropFrame() {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            ++m_Stats.submitted;
+            ++m_Stats.dropped;
+        }
+
+        // Copies a frame of RGBA8 pixels; pitch is in pixels. bottomUp flips the rows (GL readback order).
+        void submit(std::uint32_t const* pixels, std::size_t pitch, bool bottomUp = false) {
+            std::uint8_t* dest = acquire();
+            if (!dest)
+                return;
+            const std::size_t rowBytes = static_cast<std::size_t>(m_Width) * 4;
+            for (unsigned y = 0; y < m_Height; ++y) {
+                const unsigned srcY = bottomUp ? m_Height - 1 - y : y;
+                std::memcpy(dest + y * rowBytes, pixels + srcY * pitch, rowBytes);
+            }
+            commit();
+        }
+
+        CaptureStats stats() const {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            return m_Stats;
+        }
+
+        // Writes out everything queued, then closes the output.
+        CaptureStats stop() {
+            if (m_Writer.joinable()) {
+                {
+                    std::lock_guard<std::mutex> lock(m_Mutex);
+                    m_Stopping = true;
+                    m_Cv.notify_all();
+                }
+                m_Writer.join();
+            }
+            if (m_File) {
+                if (std::fclose(m_File) != 0)
+                    m_Stats.writeFailed = true;
+                m_File = nullptr;
+            }
+            return m_Stats;
+        }
+
+        FrameCapture() = default;
+        FrameCapture(FrameCapture const&) = delete;
+        FrameCapture& operator=(FrameCapture const&) = delete;
+        ~FrameCapture() { stop(); }
+    };
+}
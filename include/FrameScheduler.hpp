@@ -0,0 +1,148 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#ifdef _WIN32
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+#include "FrameTiming.hpp"
+
+namespace oglw {
+
+    struct FramePacing {
+        double targetFps = 60;                  // 0 renders as fast as possible
+        double updateRate = 60;                 // fixed simulation steps per second, 0 disables onUpdate
+        unsigned maxUpdatesPerFrame = 5;        // simulation time beyond this is dropped instead of caught up
+        double spinSeconds = 0.002;             // sleep until this close to a deadline, then spin
+        unsigned long long maxFrames = 0;       // stop after this many frames (0: until the window closes)
+        double maxSeconds = 0;                  // stop after this long (0: until the window closes)
+    };
+
+    struct RunStats {
+        unsigned long long frames = 0;
+        unsigned long long lateFrames = 0;      // finished after their deadline
+        unsigned long long droppedFrames = 0;   // deadlines that passed without a new frame
+        unsigned long long updates = 0;
+        unsigned long long droppedUpdates = 0;  // simulation steps skipped because of maxUpdatesPerFrame
+        double wallSeconds = 0;
+        double cpuSeconds = 0;                  // whole process, over the same interval
+        double sleptSeconds = 0;
+        LatencyHistogram wakeError;             // how far past each deadline the loop woke up, ns
+
+        double fps() const { return wallSeconds > 0 ? frames / wallSeconds : 0; }
+        double cpuUsage() const { return wallSeconds > 0 ? cpuSeconds / wallSeconds : 0; }
+    };
+
+    // CPU time consumed by the whole process so far.
+    inline double processCpuSeconds() {
+#ifdef _WIN32
+        FILETIME creation, exit, kernel, user;
+        if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+            return 0;
+        auto toSeconds = [](FILETIME const& t) {
+            return ((static_cast<unsigned long long>(t.dwHighDateTime) << 32) | t.dwLowDateTime) * 1e-7;
+        };
+        return toSeconds(kernel) + toSeconds(user);
+#else
+        timespec ts;
+        if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) != 0)
+            return 0;
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+    }
+
+    // Sleeps while the deadline is further away than spinNs, then spins on the clock.
+    // Returns the time spent sleeping, in ns.
+    inline std::uint64_t waitUntil(std::uint64_t deadlineNs, std::uint64_t spinNs) {
+        std::uint64_t slept = 0;
+        std::uint64_t now = clockNs();
+        while (now + spinNs < deadlineNs) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(deadlineNs - now - spinNs));
+            const std::uint64_t after = clockNs();
+            slept += after - now;
+            now = after;
+        }
+        while (now < deadlineNs) {
+            std::this_thread::yield();
+            now = clockNs();
+        }
+        return slept;
+    }
+
+    // Fixed-timestep loop: process() -> update(dt) as many steps as are due -> display(alpha)
+    // -> wait for the next frame deadline. alpha is how far (0..1) the render time is past
+    // the last simulation step, for interpolating between the last two states.
+    template <typename Process, typename Update, typename Display>
+    RunStats runFrameLoop(FramePacing const& pacing, Process process, Update update, Display display) {
+        RunStats stats;
+
+        const bool paced = pacing.targetFps > 0;
+        const std::uint64_t periodNs = paced ? static_cast<std::uint64_t>(1e9 / pacing.targetFps) : 0;
+        const std::uint64_t spinNs = static_cast<std::uint64_t>(pacing.spinSeconds * 1e9);
+        const double dt = pacing.updateRate > 0 ? 1.0 / pacing.updateRate : 0;
+
+        const std::uint64_t startNs = clockNs();
+        const double startCpu = processCpuSeconds();
+        std::uint64_t previousNs = startNs;
+        std::uint64_t deadlineNs = startNs + periodNs;
+        std::uint64_t sleptNs = 0;
+        double accumulator = 0;
+
+        while (process()) {
+            const std::uint64_t nowNs = clockNs();
+            double alpha = 0;
+            if (dt > 0) {
+                accumulator += (nowNs - previousNs) * 1e-9;
+                unsigned steps = 0;
+                while (accumulator >= dt && steps < pacing.maxUpdatesPerFrame) {
+                    update(dt);
+                    accumulator -= dt;
+                    ++steps;
+                }
+                stats.updates += steps;
+                if (accumulator >= dt) {
+                    const double behind = std::floor(accumulator / dt);
+                    stats.droppedUpdates += static_cast<unsigned long long>(behind);
+                    accumulator -= behind * dt;
+                }
+                alpha = accumulator / dt;
+            }
+            previousNs = nowNs;
+
+            display(alpha);
+            ++stats.frames;
+
+            const std::uint64_t doneNs = clockNs();
+            if ((pacing.maxFrames && stats.frames >= pacing.maxFrames)
+                || (pacing.maxSeconds > 0 && (doneNs - startNs) * 1e-9 >= pacing.maxSeconds))
+                break;
+
+            if (!paced)
+                continue;
+
+            if (doneNs > deadlineNs) {
+                // Missed it; this frame takes the next free slot instead of bursting to catch up.
+                ++stats.lateFrames;
+                const std::uint64_t missed = (doneNs - deadlineNs) / periodNs + 1;
+                stats.droppedFrames += missed;
+                deadlineNs += missed * periodNs;
+            }
+            sleptNs += waitUntil(deadlineNs, spinNs);
+            stats.wakeError.add(clockNs() - deadlineNs);
+            deadlineNs += periodNs;
+        }
+
+        stats.wallSeconds = (clockNs() - startNs) * 1e-9;
+        stats.cpuSeconds = processCpuSeconds() - startCpu;
+        stats.sleptSeconds = sleptNs * 1e-9;
+        return stats;
+    }
+}
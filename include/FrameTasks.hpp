@@ -0,0 +1,348 @@
+#pragma once
+
+// Coroutine tasks resumed by the window at the start of display(), before displayFunc,
+// within a per-frame time budget. Needs C++20 coroutines; with an older standard this header
+// is empty and OGLW_COROUTINES stays undefined.
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+    #if __has_include(<coroutine>)
+        #define OGLW_COROUTINES 1
+    #endif
+#endif
+
+#ifdef OGLW_COROUTINES
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "FrameTiming.hpp"
+
+namespace oglw {
+
+    // Return type of task coroutines. A task doesn't start until it's spawned on a
+    // TaskScheduler, which then owns it; an exception that escapes it is rethrown from
+    // the window's display().
+    class Task {
+    public:
+        struct promise_type {
+            std::exception_ptr error;
+
+            Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+            void return_void() { }
+            void unhandled_exception() { error = std::current_exception(); }
+        };
+
+        typedef std::coroutine_handle<promise_type> Handle;
+
+        Task(Task&& other) noexcept : m_Handle(std::exchange(other.m_Handle, nullptr)) { }
+        Task& operator=(Task&& other) noexcept {
+            if (this != &other) {
+                if (m_Handle)
+                    m_Handle.destroy();
+                m_Handle = std::exchange(other.m_Handle, nullptr);
+            }
+            return *this;
+        }
+        ~Task() {
+            if (m_Handle)
+                m_Handle.destroy();
+        }
+
+        Handle release() { return std::exchange(m_Handle, nullptr); }
+
+    private:
+        explicit Task(Handle handle) : m_Handle(handle) { }
+        Handle m_Handle;
+    };
+
+    struct TaskStats {
+        unsigned long long frames = 0;              // frames that resumed at least one task
+        unsigned long long resumes = 0;
+        unsigned long long spawned = 0;
+        unsigned long long completed = 0;
+        unsigned long long offloaded = 0;           // steps handed to the worker threads
+        unsigned long long overrunFrames = 0;       // the last resume ran past the budget
+        unsigned long long deferredFrames = 0;      // budget spent with tasks still waiting to run
+        LatencyHistogram frameNs;                   // time spent resuming tasks, per frame
+        LatencyHistogram overrunNs;                 // how far past the budget, per overrun frame
+    };
+
+    class TaskScheduler {
+        // Job for the worker threads; context is an awaiter living in the suspended coroutine.
+        struct Job {
+            void (*run)(void*);
+            void* context;
+        };
+
+        std::vector<Task::Handle> m_Ready;      // resumed with the next frame, before m_Next
+        std::vector<Task::Handle> m_Next;       // waiting for the next frame
+        std::vector<Task::Handle> m_Running;    // this frame's, swapped with m_Ready
+        bool m_InFrame = false;
+        std::size_t m_Live = 0;
+        std::uint64_t m_BudgetNs = 2000000;
+        std::uint64_t m_Deadline = 0;
+        std::uint64_t (*m_Clock)() = &clockNs;
+        std::exception_ptr m_Error;
+        TaskStats m_Stats;
+
+        // Worker threads, started by the first offload.
+        unsigned m_WorkerCount = 0;
+        std::vector<std::thread> m_Workers;
+        std::mutex m_JobMutex;
+        std::condition_variable m_JobWake;
+        std::deque<Job> m_Jobs;
+        bool m_Stopping = false;
+
+        // Tasks whose offloaded step finished, handed back by the workers.
+        std::mutex m_DoneMutex;
+        std::vector<Task::Handle> m_Done;
+        std::atomic<bool> m_HasDone { false };
+
+        void workerLoop() {
+            for (;;) {
+                Job job;
+                {
+                    std::unique_lock<std::mutex> lock(m_JobMutex);
+                    m_JobWake.wait(lock, [this] { return m_Stopping || !m_Jobs.empty(); });
+                    if (m_Jobs.empty())
+                        return;
+                    job = m_Jobs.front();
+                    m_Jobs.pop_front();
+                }
+                job.run(job.context);
+            }
+        }
+
+        void submit(Job job) {
+            if (m_Workers.empty()) {
+                unsigned count = m_WorkerCount;
+                if (!count) {
+                    const unsigned hw = std::thread::hardware_concurrency();    // 0 if unknown
+                    count = hw > 1 ? hw - 1 : 1;
+                }
+                for (unsigned i = 0; i < count; ++i)
+                    m_Workers.emplace_back([this] { workerLoop(); });
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_JobMutex);
+                m_Jobs.push_back(job);
+            }
+            m_JobWake.notify_one();
+            ++m_Stats.offloaded;
+        }
+
+        // From a worker thread.
+        void finished(Task::Handle handle) {
+            std::lock_guard<std::mutex> lock(m_DoneMutex);
+            m_Done.push_back(handle);
+            m_HasDone.store(true, std::memory_order_release);
+        }
+
+        void takeFinished(std::vector<Task::Handle>& into) {
+            if (!m_HasDone.load(std::memory_order_acquire))
+                return;
+            std::lock_guard<std::mutex> lock(m_DoneMutex);
+            into.insert(into.end(), m_Done.begin(), m_Done.end());
+            m_Done.clear();
+            m_HasDone.store(false, std::memory_order_relaxed);
+        }
+
+        void resume(Task::Handle handle) {
+            handle.resume();
+            ++m_Stats.resumes;
+            if (handle.done()) {
+                if (handle.promise().error && !m_Error)
+                    m_Error = handle.promise().error;
+                handle.destroy();
+                --m_Live;
+                ++m_Stats.completed;
+            }
+        }
+
+        void stopWorkers() {
+            {
+                std::lock_guard<std::mutex> lock(m_JobMutex);
+                m_Stopping = true;
+            }
+            m_JobWake.notify_all();
+            for (std::thread& t : m_Workers)
+                t.join();
+            m_Workers.clear();
+            m_Stopping = false;
+        }
+
+    public:
+        struct NextFrame {
+            TaskScheduler* scheduler;
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(Task::Handle handle) { scheduler->m_Next.push_back(handle); }
+            void await_resume() const noexcept { }
+        };
+
+        // Goes on without suspending while the frame's budget lasts.
+        struct Budget {
+            TaskScheduler* scheduler;
+
+            bool await_ready() const noexcept { return scheduler->m_Clock() < scheduler->m_Deadline; }
+            void await_suspend(Task::Handle handle) { scheduler->m_Next.push_back(handle); }
+            void await_resume() const noexcept { }
+        };
+
+        // Runs f on a worker thread; the task resumes on the window thread with its result.
+        template <class F>
+        struct Offload {
+            typedef std::invoke_result_t<F&> Result;
+            typedef std::conditional_t<std::is_void_v<Result>, bool, Result> Stored;
+
+            TaskScheduler* scheduler;
+            F function;
+            std::optional<Stored> result {};
+            std::exception_ptr error {};
+            Task::Handle handle {};
+
+            static void run(void* context) {
+                Offload* self = static_cast<Offload*>(context);
+                try {
+                    if constexpr (std::is_void_v<Result>) {
+                        self->function();
+                        self->result.emplace(true);
+                    }
+                    else {
+                        self->result.emplace(self->function());
+                    }
+                }
+                catch (...) {
+                    self->error = std::current_exception();
+                }
+                self->scheduler->finished(self->handle);
+            }
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(Task::Handle h) {
+                handle = h;
+                scheduler->submit(Job { &Offload::run, this });
+            }
+            Result await_resume() {
+                if (error)
+                    std::rethrow_exception(error);
+                if constexpr (!std::is_void_v<Result>)
+                    return std::move(*result);
+            }
+        };
+
+        // Starts the task with the current frame's tasks if they're running, else with the next frame's.
+        void spawn(Task task) {
+            const Task::Handle handle = task.release();
+            if (!handle)
+                return;
+            (m_InFrame ? m_Running : m_Ready).push_back(handle);
+            ++m_Live;
+            ++m_Stats.spawned;
+        }
+
+        NextFrame nextFrame() { return NextFrame { this }; }
+        Budget budget() { return Budget { this }; }
+        template <class F>
+        Offload<std::decay_t<F>> offload(F&& f) { return Offload<std::decay_t<F>> { this, std::forward<F>(f) }; }
+
+        // Resumes runnable tasks, oldest first, until none is left or the budget is spent.
+        // At least one task is resumed per frame so that a too small budget still makes
+        // progress. Rethrows the first exception that escaped a task.
+        void runFrame() {
+            if (!m_Live)
+                return;
+            m_Ready.insert(m_Ready.end(), m_Next.begin(), m_Next.end());
+            m_Next.clear();
+            takeFinished(m_Ready);
+            if (m_Ready.empty())
+                return;
+
+            m_Running.swap(m_Ready);
+            const std::uint64_t start = m_Clock();
+            m_Deadline = start + m_BudgetNs;
+            m_InFrame = true;
+            std::size_t i = 0;
+            std::uint64_t now = start;
+            while (i < m_Running.size() && (i == 0 || now < m_Deadline)) {
+                resume(m_Running[i++]);
+                takeFinished(m_Running);
+                now = m_Clock();
+            }
+            m_InFrame = false;
+
+            ++m_Stats.frames;
+            m_Stats.frameNs.add(now - start);
+            if (now > m_Deadline) {
+                ++m_Stats.overrunFrames;
+                m_Stats.overrunNs.add(now - m_Deadline);
+            }
+            if (i < m_Running.size()) {
+                ++m_Stats.deferredFrames;
+                m_Ready.insert(m_Ready.end(), m_Running.begin() + i, m_Running.end());
+            }
+            m_Running.clear();
+
+            if (m_Error)
+                std::rethrow_exception(std::exchange(m_Error, nullptr));
+        }
+
+        // Time the window gives tasks per frame; 2 ms by default.
+        void setBudget(double seconds) { m_BudgetNs = static_cast<std::uint64_t>(std::max(0.0, seconds) * 1e9); }
+        double budgetSeconds() const { return m_BudgetNs * 1e-9; }
+
+        // Threads for offload(); 0 means one less than the hardware threads. Takes
+        // effect when none are running, i.e. before the first offload.
+        void setWorkerThreads(unsigned threads) { m_WorkerCount = threads; }
+
+        // Replaces clockNs() for the budget, e.g. with a simulated clock for testing.
+        void setClock(std::uint64_t (*clock)()) { m_Clock = clock ? clock : &clockNs; }
+
+        // Spawned tasks that haven't finished, including those waiting for a worker.
+        std::size_t pending() const { return m_Live; }
+        bool idle() const { return m_Live == 0; }
+
+        TaskStats const& stats() const { return m_Stats; }
+        void resetStats() { m_Stats = TaskStats(); }
+
+        void writeJson(std::ostream& out) const {
+            out << "{\"frames\":" << m_Stats.frames << ",\"resumes\":" << m_Stats.resumes
+                << ",\"spawned\":" << m_Stats.spawned << ",\"completed\":" << m_Stats.completed
+                << ",\"offloaded\":" << m_Stats.offloaded << ",\"overrun_frames\":" << m_Stats.overrunFrames
+                << ",\"deferred_frames\":" << m_Stats.deferredFrames << ",\"budget_ns\":" << m_BudgetNs
+                << ",\"frame\":";
+            m_Stats.frameNs.writeJson(out);
+            out << ",\"overrun\":";
+            m_Stats.overrunNs.writeJson(out);
+            out << "}\n";
+        }
+
+        TaskScheduler() = default;
+        TaskScheduler(TaskScheduler const&) = delete;
+        TaskScheduler& operator=(TaskScheduler const&) = delete;
+
+        // Waits for offloaded steps in flight, then destroys the unfinished tasks.
+        ~TaskScheduler() {
+            stopWorkers();
+            takeFinished(m_Ready);
+            for (std::vector<Task::Handle>* list : { &m_Ready, &m_Next, &m_Running })
+                for (Task::Handle h : *list)
+                    h.destroy();
+        }
+    };
+}
+
+#endif // OGLW_COROUTINES
@@ -0,0 +1,306 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <string>
+
+// Per-frame timing of the window's main loop phases. Define OGLW_NO_FRAME_TIMING to
+// compile all measurement out; the interface stays, but records nothing.
+namespace oglw {
+
+    // Nanoseconds on the steady clock.
+    inline std::uint64_t clockNs() {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    enum class FramePhase : unsigned {
+        Display = 0,    // displayFunc
+        ErrorCheck,     // glGetError
+        Present,        // pixel surface upload/copy and SwapBuffers
+        Capture,        // copying the frame for FrameCapture
+        Process,        // process()
+        Tasks,          // coroutine tasks resumed before displayFunc
+        Count
+    };
+
+    inline const char* framePhaseName(FramePhase phase) {
+        static const char* names[] = { "display", "error_check", "present", "capture", "process", "tasks" };
+        return names[static_cast<unsigned>(phase)];
+    }
+
+    struct FrameRecord {
+        static const unsigned phaseCount = static_cast<unsigned>(FramePhase::Count);
+
+        unsigned long long frame;
+        std::uint64_t phaseNs[phaseCount];
+        std::uint64_t totalNs;
+    };
+
+    // Log-linear histogram: exact below 16 ns, then 8 buckets per power of two
+    // (values are reported with at most 12.5% error). Fixed size, no allocation.
+    class LatencyHistogram {
+        static const unsigned subBits = 3;
+        static const unsigned linear = 2u << subBits;
+        static const unsigned bucketCount = linear + (64 - subBits - 1) * (1u << subBits);
+
+        std::uint64_t m_Buckets[bucketCount];
+        std::uint64_t m_Count = 0;
+        std::uint64_t m_Sum = 0;
+        std::uint64_t m_Max = 0;
+
+        static unsigned highestBit(std::uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+            return 63u - static_cast<unsigned>(__builtin_clzll(v));
+#else
+            unsigned bit = 0;
+            while (v >>= 1)
+                ++bit;
+            return bit;
+#endif
+        }
+
+        static unsigned bucketOf(std::uint64_t v) {
+            if (v < linear)
+                return static_cast<unsigned>(v);
+            const unsigned e = highestBit(v);
+            const unsigned sub = static_cast<unsigned>(v >> (e - subBits)) & ((1u << subBits) - 1);
+            return linear + (e - subBits - 1) * (1u << subBits) + sub;
+        }
+
+        // Largest value that falls into the bucket.
+        static std::uint64_t upperBound(unsigned bucket) {
+            if (bucket < linear)
+                return bucket;
+            const unsigned e = (bucket - linear) / (1u << subBits) + subBits + 1;
+            const std::uint64_t sub = (bucket - linear) % (1u << subBits);
+            const std::uint64_t lower = ((1ull << subBits) + sub) << (e - subBits);
+            return lower + (1ull << (e - subBits)) - 1;
+        }
+
+    public:
+        void add(std::uint64_t v) {
+            ++m_Buckets[bucketOf(v)];
+            ++m_Count;
+            m_Sum += v;
+            if (v > m_Max)
+                m_Max = v;
+        }
+
+        void reset() {
+            for (auto& b : m_Buckets)
+                b = 0;
+            m_Count = m_Sum = m_Max = 0;
+        }
+
+        std::uint64_t count() const { return m_Count; }
+        std::uint64_t max() const { return m_Max; }
+        double mean() const { return m_Count ? double(m_Sum) / m_Count : 0.0; }
+
+        // q in [0, 1]. Nearest rank: the smallest sample with at least q of the samples at
+        // or below it, so p99 of a few frames is the slowest of them.
+        std::uint64_t percentile(double q) const {
+            if (!m_Count)
+                return 0;
+            std::uint64_t rank = static_cast<std::uint64_t>(std::ceil(q * m_Count - 1e-9));
+            rank = rank < 1 ? 1 : rank > m_Count ? m_Count : rank;
+            std::uint64_t seen = 0;
+            for (unsigned b = 0; b < bucketCount; ++b) {
+                seen += m_Buckets[b];
+                if (seen >= rank)
+                    return upperBound(b) < m_Max ? upperBound(b) : m_Max;
+            }
+            return m_Max;
+        }
+
+        void writeJson(std::ostream& out) const {
+            out << "{\"count\":" << m_Count << ",\"mean_ns\":" << mean()
+                << ",\"p50_ns\":" << percentile(0.50) << ",\"p95_ns\":" << percentile(0.95)
+                << ",\"p99_ns\":" << percentile(0.99) << ",\"max_ns\":" << m_Max << "}";
+        }
+
+        LatencyHistogram() { reset(); }
+    };
+
+    // Collects phase timings of the frame in progress, then commits them to a ring of
+    // the most recent frames and to one histogram per phase (plus one for the whole frame).
+    // Only the window's thread writes. The ring's head index is atomic and each slot is
+    // sequence-stamped, so another thread may read records() without locking.
+    class FrameProfiler {
+    public:
+        static const std::size_t ringCapacity = 1024;    // power of two
+
+    private:
+        // The fields are atomics too, so a read racing the rewrite is well defined (and
+        // visible to ThreadSanitizer, which doesn't model the usual fence-based seqlock).
+        struct Slot {
+            std::atomic<unsigned long long> sequence;
+            std::atomic<std::uint64_t> phaseNs[FrameRecord::phaseCount];
+            std::atomic<std::uint64_t> totalNs;
+        };
+
+        std::unique_ptr<Slot[]> m_Ring;        // allocated on first frame
+        std::atomic<unsigned long long> m_Head;
+        FrameRecord m_Current;
+        LatencyHistogram m_Phases[FrameRecord::phaseCount];
+        LatencyHistogram m_Total;
+
+        void resetCurrent() {
+            for (auto& ns : m_Current.phaseNs)
+                ns = 0;
+            m_Current.totalNs = 0;
+        }
+
+    public:
+        // If set, the results are written here when the profiler (i.e. the window) is
+        // destroyed, as JSON if the name ends with ".json" and CSV otherwise.
+        std::string dumpPathOnDestroy;
+
+        void addPhase(FramePhase phase, std::uint64_t ns) {
+#ifndef OGLW_NO_FRAME_TIMING
+            m_Current.phaseNs[static_cast<unsigned>(phase)] += ns;
+            m_Current.totalNs += ns;
+#else
+            (void) phase; (void) ns;
+#endif
+        }
+
+        void endFrame() {
+#ifndef OGLW_NO_FRAME_TIMING
+            if (!m_Ring) {
+                m_Ring.reset(new Slot[ringCapacity]);
+                for (std::size_t i = 0; i < ringCapacity; ++i)
+                    m_Ring[i].sequence.store(0, std::memory_order_relaxed);
+            }
+
+            const unsigned long long head = m_Head.load(std::memory_order_relaxed);
+            m_Current.frame = head;
+            for (unsigned p = 0; p < FrameRecord::phaseCount; ++p)
+                m_Phases[p].add(m_Current.phaseNs[p]);
+            m_Total.add(m_Current.totalNs);
+
+            // Odd sequence while the slot is being rewritten.
+            Slot& slot = m_Ring[head & (ringCapacity - 1)];
+            // A reader that sees any of the new fields then sees the odd sequence too.
+            slot.sequence.store(2 * head + 1, std::memory_order_relaxed);
+            for (unsigned p = 0; p < FrameRecord::phaseCount; ++p)
+                slot.phaseNs[p].store(m_Current.phaseNs[p], std::memory_order_release);
+            slot.totalNs.store(m_Current.totalNs, std::memory_order_release);
+            slot.sequence.store(2 * head + 2, std::memory_order_release);
+            m_Head.store(head + 1, std::memory_order_release);
+
+            resetCurrent();
+#endif
+        }
+
+        unsigned long long frames() const { return m_Head.load(std::memory_order_acquire); }
+        LatencyHistogram const& phase(FramePhase p) const { return m_Phases[static_cast<unsigned>(p)]; }
+        LatencyHistogram const& total() const { return m_Total; }
+
+        // Calls f(FrameRecord const&) for each retained frame, oldest first, skipping
+        // any slot that the window thread overwrites during the read.
+        template <typename F>
+        void records(F f) const {
+            // The ring is allocated before the first head update, so check the head first.
+            const unsigned long long head = m_Head.load(std::memory_order_acquire);
+            if (!head)
+                return;
+            const unsigned long long first = head > ringCapacity ? head - ringCapacity : 0;
+            for (unsigned long long i = first; i < head; ++i) {
+                Slot const& slot = m_Ring[i & (ringCapacity - 1)];
+                const unsigned long long before = slot.sequence.load(std::memory_order_acquire);
+                FrameRecord copy;
+                copy.frame = i;
+                for (unsigned p = 0; p < FrameRecord::phaseCount; ++p)
+                    copy.phaseNs[p] = slot.phaseNs[p].load(std::memory_order_acquire);
+                copy.totalNs = slot.totalNs.load(std::memory_order_acquire);
+                if (before == 2 * i + 2 && slot.sequence.load(std::memory_order_relaxed) == before)
+                    f(copy);
+            }
+        }
+
+        void reset() {
+            for (auto& h : m_Phases)
+                h.reset();
+            m_Total.reset();
+            resetCurrent();
+        }
+
+        void writeCsv(std::ostream& out) const {
+            out << "frame";
+            for (unsigned p = 0; p < FrameRecord::phaseCount; ++p)
+                out << ',' << framePhaseName(static_cast<FramePhase>(p)) << "_ns";
+            out << ",total_ns\n";
+            records([&](FrameRecord const& r) {
+                out << r.frame;
+                for (unsigned p = 0; p < FrameRecord::phaseCount; ++p)
+                    out << ',' << r.phaseNs[p];
+                out << ',' << r.totalNs << '\n';
+            });
+        }
+
+        void writeJson(std::ostream& out) const {
+            out << "{\"frames\":" << frames() << ",\"phases\":{";
+            for (unsigned p = 0; p < FrameRecord::phaseCount; ++p) {
+                out << '"' << framePhaseName(static_cast<FramePhase>(p)) << "\":";
+                m_Phases[p].writeJson(out);
+                out << ',';
+            }
+            out << "\"total\":";
+            m_Total.writeJson(out);
+            out << "},\"records\":[";
+            bool first = true;
+            records([&](FrameRecord const& r) {
+                out << (first ? "" : ",") << '[' << r.frame;
+                for (unsigned p = 0; p < FrameRecord::phaseCount; ++p)
+                    out << ',' << r.phaseNs[p];
+                out << ',' << r.totalNs << ']';
+                first = false;
+            });
+            out << "]}\n";
+        }
+
+        bool dump(std::string const& path) const {
+            std::ofstream out(path.c_str());
+            const std::string json = ".json";
+            if (path.size() >= json.size() && path.compare(path.size() - json.size(), json.size(), json) == 0)
+                writeJson(out);
+            else
+                writeCsv(out);
+            return static_cast<bool>(out);
+        }
+
+        FrameProfiler() : m_Head(0) { resetCurrent(); }
+        FrameProfiler(FrameProfiler const&) = delete;
+        FrameProfiler& operator=(FrameProfiler const&) = delete;
+
+        ~FrameProfiler() {
+            if (!dumpPathOnDestroy.empty())
+                dump(dumpPathOnDestroy);
+        }
+    };
+
+    // Adds the time between construction and destruction to a phase of the current frame.
+    class PhaseTimer {
+#ifndef OGLW_NO_FRAME_TIMING
+        FrameProfiler& m_Profiler;
+        FramePhase m_Phase;
+        std::uint64_t m_Start;
+    public:
+        PhaseTimer(FrameProfiler& profiler, FramePhase phase)
+            : m_Profiler(profiler), m_Phase(phase), m_Start(clockNs()) { }
+        ~PhaseTimer() { m_Profiler.addPhase(m_Phase, clockNs() - m_Start); }
+#else
+    public:
+        PhaseTimer(FrameProfiler&, FramePhase) { }
+#endif
+        PhaseTimer(PhaseTimer const&) = delete;
+        PhaseTimer& operator=(PhaseTimer const&) = delete;
+    };
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+    #define OGLW_GL_CALLBACK __stdcall
+#else
+    #define OGLW_GL_CALLBACK
+#endif
+
+#include <GL/gl.h>
+
+namespace oglw {
+
+    // When the window checks for GL errors after displayFunc.
+    enum class GlErrorCheck {
+        EveryFrame,         // glGetError every frame (may stall the pipeline on some drivers)
+        EveryNFrames,       // glGetError every glErrorCheckInterval frames
+        DebugOnly,          // every frame, unless NDEBUG is defined
+        DebugCallback,      // KHR_debug callback queues errors, reported by the next process()
+        Never,
+    };
+
+    inline const char* glErrorCheckName(GlErrorCheck policy) {
+        switch (policy) {
+            case GlErrorCheck::EveryFrame: return "every_frame";
+            case GlErrorCheck::EveryNFrames: return "every_n_frames";
+            case GlErrorCheck::DebugOnly: return "debug_only";
+            case GlErrorCheck::DebugCallback: return "debug_callback";
+            case GlErrorCheck::Never: default: return "never";
+        }
+    }
+
+    // Applies a GlErrorCheck policy. Reports errors instead of throwing, so the window
+    // decides what to do with them.
+    class GlErrorChecker {
+    public:
+        typedef void* (*ProcLoader)(const char*);
+
+    private:
+        // KHR_debug / GL 4.3 entry points and enums; not in the GL 1.1 headers.
+        typedef void (OGLW_GL_CALLBACK *DebugProc)(GLenum source, GLenum type, GLuint id, GLenum severity,
+            GLsizei length, const char* message, const void* userParam);
+        typedef void (OGLW_GL_CALLBACK *DebugMessageCallbackProc)(DebugProc callback, const void* userParam);
+
+        static const GLenum debugOutput = 0x92E0;
+        static const GLenum debugTypeError = 0x824C;
+
+        GlErrorCheck m_Policy = GlErrorCheck::EveryFrame;
+        unsigned m_Interval = 60;
+        unsigned long long m_Frame = 0;
+
+        // Filled by the debug callback, possibly from a driver thread.
+        std::mutex m_QueueMutex;
+        std::vector<std::string> m_Queued;
+        std::atomic<bool> m_HasQueued { false };
+
+        static void OGLW_GL_CALLBACK onDebugMessage(GLenum, GLenum type, GLuint, GLenum,
+            GLsizei length, const char* message, const void* userParam) {
+            if (type != debugTypeError)
+                return;
+            GlErrorChecker* self = const_cast<GlErrorChecker*>(static_cast<GlErrorChecker const*>(userParam));
+            std::lock_guard<std::mutex> lock(self->m_QueueMutex);
+            self->m_Queued.push_back(length < 0 ? std::string(message) : std::string(message, length));
+            self->m_HasQueued.store(true, std::memory_order_release);
+        }
+
+        // The core entry point, or the KHR_debug or ARB_debug_output one.
+        static DebugMessageCallbackProc debugMessageCallback(ProcLoader getProc) {
+            const char* names[] = { "glDebugMessageCallback", "glDebugMessageCallbackKHR", "glDebugMessageCallbackARB" };
+            for (const char* name : names) {
+                if (void* proc = getProc ? getProc(name) : nullptr)
+                    return reinterpret_cast<DebugMessageCallbackProc>(proc);
+            }
+            return nullptr;
+        }
+
+    public:
+        GlErrorCheck policy() const { return m_Policy; }
+        unsigned interval() const { return m_Interval; }
+
+        // Needs a current context. DebugCallback falls back to EveryFrame if the driver
+        // doesn't expose glDebugMessageCallback; the effective policy is returned.
+        GlErrorCheck setPolicy(GlErrorCheck policy, unsigned interval, ProcLoader getProc) {
+            if (m_Policy == GlErrorCheck::DebugCallback && policy != GlErrorCheck::DebugCallback) {
+                if (DebugMessageCallbackProc install = debugMessageCallback(getProc))
+                    install(nullptr, nullptr);
+                glDisable(debugOutput);
+            }
+
+            m_Interval = interval ? interval : 1;
+            m_Policy = policy;
+
+            if (policy == GlErrorCheck::DebugCallback) {
+                if (DebugMessageCallbackProc install = debugMessageCallback(getProc)) {
+                    glEnable(debugOutput);
+                    install(&GlErrorChecker::onDebugMessage, this);
+                }
+                else {
+                    m_Policy = GlErrorCheck::EveryFrame;
+                }
+            }
+            return m_Policy;
+        }
+
+        // Call once per frame, after rendering. Returns the GL error if one was checked for and found.
+        GLenum check() {
+            const unsigned long long frame = m_Frame++;
+            switch (m_Policy) {
+                case GlErrorCheck::EveryFrame:
+                    return glGetError();
+                case GlErrorCheck::EveryNFrames:
+                    return frame % m_Interval == 0 ? glGetError() : GL_NO_ERROR;
+                case GlErrorCheck::DebugOnly:
+#ifdef NDEBUG
+                    return GL_NO_ERROR;
+#else
+                    return glGetError();
+#endif
+                case GlErrorCheck::DebugCallback:
+                case GlErrorCheck::Never:
+                default:
+                    return GL_NO_ERROR;
+            }
+        }
+
+        // Oldest error queued by the debug callback, if any.
+        bool takeQueued(std::string& message) {
+            if (!m_HasQueued.load(std::memory_order_acquire))
+                return false;
+            std::lock_guard<std::mutex> lock(m_QueueMutex);
+            if (m_Queued.empty())
+                return false;
+            message = m_Queued.front();
+            m_Queued.erase(m_Queued.begin());
+            m_HasQueued.store(!m_Queued.empty(), std::memory_order_release);
+            return true;
+        }
+
+        GlErrorChecker() = default;
+        GlErrorChecker(GlErrorChecker const&) = delete;
+        GlErrorChecker& operator=(GlErrorChecker const&) = delete;
+    };
+}
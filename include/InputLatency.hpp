@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "FrameTiming.hpp"
+
+namespace oglw {
+
+    // When an input event arrived and when it reached the handler, on the clockNs()
+    // timeline (or the window's event clock, see setEventClock()).
+    struct EventTime {
+        std::uint64_t arrivalNs;    // window system message time, or when a synthetic event was posted
+        std::uint64_t dispatchNs;   // when process() handed it to the handler
+
+        std::uint64_t queuedNs() const { return dispatchNs > arrivalNs ? dispatchNs - arrivalNs : 0; }
+    };
+
+    // Correlates dispatched input events with the present of the frame that followed,
+    // i.e. the first one that could show their effect. Keeps distributions of the time
+    // spent queued, from dispatch to present and from arrival to present, and of the
+    // number of frames presented from arrival up to and including that one.
+    class InputLatency {
+        static const unsigned presentHistory = 64;      // for counting frames an event waited through
+        static const std::size_t maxPending = 65536;    // events dispatched while nothing is presented
+
+        struct Pending {
+            EventTime time;
+            unsigned presentsBefore;    // presented between arrival and dispatch
+        };
+
+        std::vector<Pending> m_Pending;
+        std::uint64_t m_Presents[presentHistory];
+        unsigned long long m_PresentCount = 0;
+        unsigned long long m_Dropped = 0;
+
+        LatencyHistogram m_Queued;
+        LatencyHistogram m_DispatchToPresent;
+        LatencyHistogram m_ArrivalToPresent;
+        LatencyHistogram m_Frames;
+
+        static std::uint64_t since(std::uint64_t from, std::uint64_t to) { return to > from ? to - from : 0; }
+
+        static void writeFrames(std::ostream& out, LatencyHistogram const& h) {
+            out << "{\"count\":" << h.count() << ",\"mean\":" << h.mean() << ",\"p50\":" << h.percentile(0.50)
+                << ",\"p95\":" << h.percentile(0.95) << ",\"p99\":" << h.percentile(0.99) << ",\"max\":" << h.max() << "}";
+        }
+
+    public:
+        void dispatched(EventTime const& time) {
+            if (m_Pending.size() >= maxPending) {
+                ++m_Dropped;
+                return;
+            }
+            unsigned before = 0;
+            while (before < presentHistory && before < m_PresentCount
+                && m_Presents[(m_PresentCount - 1 - before) % presentHistory] > time.arrivalNs)
+                ++before;
+            m_Pending.push_back(Pending { time, before });
+        }
+
+        void presented(std::uint64_t presentNs) {
+            for (Pending const& p : m_Pending) {
+                m_Queued.add(p.time.queuedNs());
+                m_DispatchToPresent.add(since(p.time.dispatchNs, presentNs));
+                m_ArrivalToPresent.add(since(p.time.arrivalNs, presentNs));
+                m_Frames.add(p.presentsBefore + 1);
+            }
+            m_Pending.clear();
+            m_Presents[m_PresentCount++ % presentHistory] = presentNs;
+        }
+
+        LatencyHistogram const& queued() const { return m_Queued; }
+        LatencyHistogram const& dispatchToPresent() const { return m_DispatchToPresent; }
+        LatencyHistogram const& arrivalToPresent() const { return m_ArrivalToPresent; }
+        LatencyHistogram const& frames() const { return m_Frames; }
+        // Events not traced because too many were waiting for a present.
+        unsigned long long dropped() const { return m_Dropped; }
+
+        // Clears the statistics; events waiting for a present and the recent present
+        // times are kept.
+        void reset() {
+            m_Dropped = 0;
+            m_Queued.reset();
+            m_DispatchToPresent.reset();
+            m_ArrivalToPresent.reset();
+            m_Frames.reset();
+        }
+
+        void writeJson(std::ostream& out) const {
+            out << "{\"queued\":";
+            m_Queued.writeJson(out);
+            out << ",\"dispatch_to_present\":";
+            m_DispatchToPresent.writeJson(out);
+            out << ",\"arrival_to_present\":";
+            m_ArrivalToPresent.writeJson(out);
+            out << ",\"frames\":";
+            writeFrames(out, m_Frames);
+            out << ",\"dropped\":" << m_Dropped << "}\n";
+        }
+
+        bool dump(std::string const& path) const {
+            std::ofstream out(path.c_str());
+            writeJson(out);
+            return static_cast<bool>(out);
+        }
+    };
+}
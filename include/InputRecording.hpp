@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+// Binary input logs: an 8-byte magic followed by fixed-size RecordedEvent records in
+// dispatch order. Fields are stored in host byte order.
+namespace oglw {
+
+    struct RecordedEvent {
+        std::uint64_t timeNs;       // since recording started
+        std::uint32_t frame;        // number of process() calls before the one that dispatched it
+        std::uint8_t type;          // Event::Type
+        std::uint8_t button;        // MouseInfo::Button
+        std::uint8_t active;
+        std::uint8_t reserved;
+        std::uint32_t key;
+        std::int32_t x, y;
+        std::uint32_t reserved2;
+    };
+    static_assert(sizeof(RecordedEvent) == 32, "RecordedEvent is a file format");
+
+    static const char inputLogMagic[8] = { 'O', 'G', 'L', 'W', 'I', 'N', 'P', '1' };
+
+    // Appends records to a log through a large stdio buffer.
+    class InputRecorder {
+        std::FILE* m_File = nullptr;
+        std::uint64_t m_Count = 0;
+
+    public:
+        bool open(std::string const& path) {
+            close();
+            m_File = std::fopen(path.c_str(), "wb");
+            if (!m_File)
+                return false;
+            std::setvbuf(m_File, nullptr, _IOFBF, 1 << 20);
+            m_Count = 0;
+            return std::fwrite(inputLogMagic, sizeof(inputLogMagic), 1, m_File) == 1;
+        }
+
+        void add(RecordedEvent const& e) {
+            std::fwrite(&e, sizeof(e), 1, m_File);
+            ++m_Count;
+        }
+
+        void close() {
+            if (m_File)
+                std::fclose(m_File);
+            m_File = nullptr;
+        }
+
+        bool isOpen() const { return m_File != nullptr; }
+        std::uint64_t count() const { return m_Count; }
+
+        InputRecorder() = default;
+        InputRecorder(InputRecorder const&) = delete;
+        InputRecorder& operator=(InputRecorder const&) = delete;
+        ~InputRecorder() { close(); }
+    };
+
+    // Read-only memory mapping of a whole file; pages are loaded as they're touched.
+    class MappedFile {
+        const std::uint8_t* m_Data = nullptr;
+        std::size_t m_Size = 0;
+#ifdef _WIN32
+        HANDLE m_File = INVALID_HANDLE_VALUE;
+        HANDLE m_Mapping = NULL;
+#endif
+
+    public:
+        bool open(std::string const& path) {
+            close();
+#ifdef _WIN32
+            m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (m_File == INVALID_HANDLE_VALUE)
+                return false;
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(m_File, &size))
+                return false;
+            m_Size = static_cast<std::size_t>(size.QuadPart);
+            if (m_Size == 0)
+                return true;
+            m_Mapping = CreateFileMappingW(m_File, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (!m_Mapping)
+                return false;
+            m_Data = static_cast<const std::uint8_t*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+            const int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return false;
+            struct stat st;
+            if (fstat(fd, &st) != 0) {
+                ::close(fd);
+                return false;
+            }
+            m_Size = static_cast<std::size_t>(st.st_size);
+            if (m_Size > 0) {
+                void* p = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    m_Data = static_cast<const std::uint8_t*>(p);
+                    madvise(p, m_Size, MADV_SEQUENTIAL);
+                }
+            }
+            ::close(fd);
+            if (m_Size == 0)
+                return true;
+#endif
+            return m_Data != nullptr;
+        }
+
+        void close() {
+#ifdef _WIN32
+            if (m_Data)
+                UnmapViewOfFile(m_Data);
+            if (m_Mapping)
+                CloseHandle(m_Mapping);
+            if (m_File != INVALID_HANDLE_VALUE)
+                CloseHandle(m_File);
+            m_Mapping = NULL;
+            m_File = INVALID_HANDLE_VALUE;
+#else
+            if (m_Data)
+                munmap(const_cast<std::uint8_t*>(m_Data), m_Size);
+#endif
+            m_Data = nullptr;
+            m_Size = 0;
+        }
+
+        const std::uint8_t* data() const { return m_Data; }
+        std::size_t size() const { return m_Size; }
+
+        MappedFile() = default;
+        MappedFile(MappedFile const&) = delete;
+        MappedFile& operator=(MappedFile const&) = delete;
+        ~MappedFile() { close(); }
+    };
+
+    enum class ReplaySpeed {
+        Recorded,   // each event is due when as much time has passed as when it was recorded
+        Fastest,    // each event is due in the process() call with its recorded frame index
+    };
+
+    // Walks a mapped input log and hands out the records that are due.
+    class InputReplayer {
+        MappedFile m_File;
+        std::size_t m_Next = 0;
+        std::size_t m_Count = 0;
+
+    public:
+        // Fails if the file can't be mapped or isn't an input log.
+        bool open(std::string const& path) {
+            m_Next = m_Count = 0;
+            if (!m_File.open(path) || m_File.size() < sizeof(inputLogMagic)
+                || std::memcmp(m_File.data(), inputLogMagic, sizeof(inputLogMagic)) != 0) {
+                m_File.close();
+                return false;
+            }
+            m_Count = (m_File.size() - sizeof(inputLogMagic)) / sizeof(RecordedEvent);
+            return true;
+        }
+
+        void close() { m_File.close(); m_Next = m_Count = 0; }
+
+        std::size_t count() const { return m_Count; }
+        std::size_t position() const { return m_Next; }
+        bool finished() const { return m_Next >= m_Count; }
+
+        RecordedEvent at(std::size_t i) const {
+            RecordedEvent e;
+            std::memcpy(&e, m_File.data() + sizeof(inputLogMagic) + i * sizeof(RecordedEvent), sizeof(e));
+            return e;
+        }
+
+        // Calls f(RecordedEvent const&) for every record with frame <= frame (Fastest) or
+        // timeNs <= elapsedNs (Recorded) that hasn't been handed out yet.
+        template <typename F>
+        void takeDue(ReplaySpeed speed, std::uint32_t frame, std::uint64_t elapsedNs, F f) {
+            while (m_Next < m_Count) {
+                const RecordedEvent e = at(m_Next);
+                if (speed == ReplaySpeed::Fastest ? e.frame > frame : e.timeNs > elapsedNs)
+                    break;
+                ++m_Next;
+                f(e);
+            }
+        }
+    };
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace oglw {
+
+    // Keyboard and mouse state as of the end of a process() call. Key codes are
+    // virtual-key codes (0-255); larger codes wrap.
+    struct InputSnapshot {
+        std::uint64_t keys[4];          // currently held
+        std::uint64_t pressedKeys[4];   // went down during the last process(), even if already released
+        std::uint32_t buttons;          // bit n: MouseInfo::Button with value n is held
+        std::uint32_t pressedButtons;
+        int mouseX, mouseY;
+        int mouseDeltaX, mouseDeltaY;   // movement during the last process()
+
+        bool keyDown(unsigned key) const { return (keys[(key >> 6) & 3] >> (key & 63)) & 1; }
+        bool keyPressed(unsigned key) const { return (pressedKeys[(key >> 6) & 3] >> (key & 63)) & 1; }
+        bool buttonDown(unsigned button) const { return (buttons >> (button & 31)) & 1; }
+        bool buttonPressed(unsigned button) const { return (pressedButtons >> (button & 31)) & 1; }
+
+        InputSnapshot() { std::memset(this, 0, sizeof(*this)); }
+    };
+
+    // Builds the next snapshot from events; the window publishes it once per process().
+    class InputTracker {
+        InputSnapshot m_Current;
+        InputSnapshot m_Published;
+        int m_PublishedX = 0, m_PublishedY = 0;
+
+    public:
+        void keyDown(unsigned key) {
+            const std::uint64_t bit = std::uint64_t(1) << (key & 63);
+            m_Current.keys[(key >> 6) & 3] |= bit;
+            m_Current.pressedKeys[(key >> 6) & 3] |= bit;
+        }
+        void keyUp(unsigned key) {
+            m_Current.keys[(key >> 6) & 3] &= ~(std::uint64_t(1) << (key & 63));
+        }
+        void buttonDown(unsigned button) {
+            m_Current.buttons |= 1u << (button & 31);
+            m_Current.pressedButtons |= 1u << (button & 31);
+        }
+        void buttonUp(unsigned button) {
+            m_Current.buttons &= ~(1u << (button & 31));
+        }
+        void mouseAt(int x, int y) {
+            m_Current.mouseX = x;
+            m_Current.mouseY = y;
+        }
+        // Key and button releases are lost while the window is inactive.
+        void releaseAll() {
+            std::memset(m_Current.keys, 0, sizeof(m_Current.keys));
+            m_Current.buttons = 0;
+        }
+
+        void publish() {
+            m_Current.mouseDeltaX = m_Current.mouseX - m_PublishedX;
+            m_Current.mouseDeltaY = m_Current.mouseY - m_PublishedY;
+            m_PublishedX = m_Current.mouseX;
+            m_PublishedY = m_Current.mouseY;
+            m_Published = m_Current;
+            std::memset(m_Current.pressedKeys, 0, sizeof(m_Current.pressedKeys));
+            m_Current.pressedButtons = 0;
+        }
+
+        InputSnapshot const& snapshot() const { return m_Published; }
+    };
+}
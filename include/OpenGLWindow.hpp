@@ -1,20 +1,51 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "FrameArena.hpp"
+#include "FrameCapture.hpp"
+#include "FrameScheduler.hpp"
+#include "FrameTasks.hpp"
+#include "FrameTiming.hpp"
+#include "InputLatency.hpp"
+#include "InputRecording.hpp"
+#include "InputState.hpp"
+#include "PixelSurface.hpp"
+#include "Rasterizer.hpp"
+#include "SharedFrames.hpp"
+#include "SpriteBatch.hpp"
+#include "SpscQueue.hpp"
+#include "TilePool.hpp"
 
 #ifdef _WIN32
-    #define WIN32_LEAN_AND_MEAN
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
     #include <windows.h>
+    #include <mmsystem.h>
 
-    #ifndef OGLW_NO_LIBS
-        #pragma comment(lib, "opengl32.lib")
-        #pragma comment(lib, "glu32.lib")
-    #endif // !OGLW_NO_LIBS
+    #ifndef OGLW_NO_LIBS
+        #pragma comment(lib, "opengl32.lib")
+        #pragma comment(lib, "glu32.lib")
+        #pragma comment(lib, "winmm.lib")
+    #endif // !OGLW_NO_LIBS
 #endif
 
-#include <gl/GL.h>
+#include <GL/gl.h>
+
+#include "GlErrors.hpp"
 
 namespace oglw {
 
@@ -22,7 +53,7 @@ namespace oglw {
         std::string _what;
     public:
         WindowException(std::string const& what) : _what(what) { }
-        const char* what() const override { return _what.c_str(); }
+        const char* what() const noexcept override { return _what.c_str(); }
     };
 
     class WindowCreateException : public virtual WindowException {
@@ -36,30 +67,112 @@ namespace oglw {
     };
 
     struct KeyInfo {
+#ifdef _WIN32
         KeyInfo(WPARAM wParam)
             : key(static_cast<unsigned>(wParam))
+            , time()
+        {}
+#else
+        KeyInfo(unsigned key)
+            : key(key)
+            , time()
         {}
+#endif
         unsigned key;
+        EventTime time;
     };
 
     struct MouseInfo {
-        enum class Button {
+        enum class Button : std::uint8_t {    // keeps Event at 24 bytes
             None = 0, Left, Right, Middle,
         };
 
         int x, y;
         double normX, normY;
         Button button;
+        EventTime time;     // of the last move, for collapsed moves
     };
 
-    class OpenGLWindowBase
-    {
-    protected:
-        bool isActive;
-        unsigned sizeX, sizeY;
+    // Backend-independent record of a window event, e.g. for feeding synthetic input.
+    struct Event {
+        enum class Type : std::uint8_t {
+            KeyDown, KeyUp, MouseMove, MouseDown, MouseUp, Resize, Activate, Close,
+        };
 
-    public:
+        Type type;
+        MouseInfo::Button button;   // MouseDown, MouseUp
+        bool active;                // Activate
+        unsigned key;               // KeyDown, KeyUp
+        int x, y;                   // mouse events: position; Resize: new width and height
+        std::uint64_t timeNs;       // arrival on the clockNs() timeline; 0: when posted (headless) or dispatched
+
+        // The same event, arrived at the given time; for synthetic input with controlled timing.
+        Event at(std::uint64_t ns) const {
+            Event e = *this;
+            e.timeNs = ns;
+            return e;
+        }
+
+        static Event keyDown(unsigned key) { return Event { Type::KeyDown, MouseInfo::Button::None, false, key, 0, 0, 0 }; }
+        static Event keyUp(unsigned key) { return Event { Type::KeyUp, MouseInfo::Button::None, false, key, 0, 0, 0 }; }
+        static Event mouseMove(int x, int y) { return Event { Type::MouseMove, MouseInfo::Button::None, false, 0, x, y, 0 }; }
+        static Event mouseDown(int x, int y, MouseInfo::Button b) { return Event { Type::MouseDown, b, false, 0, x, y, 0 }; }
+        static Event mouseUp(int x, int y, MouseInfo::Button b) { return Event { Type::MouseUp, b, false, 0, x, y, 0 }; }
+        static Event resize(unsigned w, unsigned h) { return Event { Type::Resize, MouseInfo::Button::None, false, 0, int(w), int(h), 0 }; }
+        static Event activate(bool a) { return Event { Type::Activate, MouseInfo::Button::None, a, 0, 0, 0, 0 }; }
+        static Event close() { return Event { Type::Close, MouseInfo::Button::None, false, 0, 0, 0, 0 }; }
+    };
+
+    // Carries events from the event pump thread to the render thread in threaded mode.
+    typedef SpscQueue<Event, 16384> EventQueue;
+
+    // Part of the pixel surface handed to onDrawTile/tileFunc.
+    struct Tile {
+        unsigned x, y, width, height;
+        unsigned index;     // row-major among the frame's tiles
+        unsigned worker;    // 0..renderThreads()-1, e.g. for per-thread scratch data
+    };
+
+    // What presenting the pixel surface cost; see BasicWindowBase::presentStats().
+    struct PresentStats {
+        unsigned long long frames = 0;
+        unsigned long long fullFrames = 0;          // whole surface copied or uploaded
+        unsigned long long partialFrames = 0;       // only dirty rectangles
+        unsigned long long unchangedFrames = 0;     // nothing to copy
+        unsigned long long rects = 0;
+        unsigned long long bytes = 0;
+        unsigned long long lastFrameBytes = 0;
+
+        double bytesPerFrame() const { return frames ? double(bytes) / frames : 0; }
+    };
+
+    // Base for statically dispatched handlers (see BasicWindowBase). Hide the members
+    // for the events you're interested in; the rest are empty and compile away.
+    struct EventHandler {
+        // Format of the window's pixel surface; handlers can pick another one
+        // (RGB565, R32F, ...) with a typedef of their own.
+        typedef RGBA8 PixelFormat;
+
+        void onDisplay() { }
+        void onUpdate(double) { }
+        void onResize(unsigned, unsigned) { }
+        void onKeyDown(KeyInfo const&) { }
+        void onKeyUp(KeyInfo const&) { }
+        void onActivate(bool) { }
+        void onMouseMove(MouseInfo const&) { }
+        void onMouseUp(MouseInfo const&) { }
+        void onMouseDown(MouseInfo const&) { }
+        // Called for every tile of the pixel surface after onDisplay, from several threads at once.
+        // The surface is a BasicPixelSurface<PixelFormat>.
+        void onDrawTile(PixelSurface&, Tile const&) { }
+        // Handlers that define onDrawTile can turn tiling off at runtime with this.
+        bool drawsTiles() const { return true; }
+    };
+
+    // The default handler: callbacks assignable at runtime.
+    struct CallbackHandler : EventHandler {
         std::function<void(void)> displayFunc;
+        std::function<void(double)> updateFunc;        // fixed time step in seconds, see run()
 
         std::function<void(unsigned, unsigned)> resizeCallback;
         std::function<void(KeyInfo) > keydownCallback;
@@ -68,52 +181,979 @@ namespace oglw {
         std::function<void(MouseInfo)> mousemoveCallback;
         std::function<void(MouseInfo)> mouseupCallback;
         std::function<void(MouseInfo)> mousedownCallback;
+        std::function<void(PixelSurface&, Tile const&)> tileFunc;     // see EventHandler::onDrawTile
+
+        void onDisplay() { if (displayFunc) displayFunc(); }
+        void onUpdate(double dt) { if (updateFunc) updateFunc(dt); }
+        void onResize(unsigned width, unsigned height) { if (resizeCallback) resizeCallback(width, height); }
+        void onKeyDown(KeyInfo const& info) { if (keydownCallback) keydownCallback(info); }
+        void onKeyUp(KeyInfo const& info) { if (keyupCallback) keyupCallback(info); }
+        void onActivate(bool active) { if (activateCallback) activateCallback(active); }
+        void onMouseMove(MouseInfo const& info) { if (mousemoveCallback) mousemoveCallback(info); }
+        void onMouseUp(MouseInfo const& info) { if (mouseupCallback) mouseupCallback(info); }
+        void onMouseDown(MouseInfo const& info) { if (mousedownCallback) mousedownCallback(info); }
+        void onDrawTile(PixelSurface& surface, Tile const& tile) { tileFunc(surface, tile); }
+        bool drawsTiles() const { return static_cast<bool>(tileFunc); }
+    };
+
+    // Window state and event dispatch shared by the backends. Events go straight to
+    // the Handler's on* members, which are resolved (and usually inlined) at compile time.
+    template <class Handler>
+    class BasicWindowBase : public Handler
+    {
+    protected:
+        // Whether Handler hides EventHandler's no-op for the event; if not, the
+        // bookkeeping for that event is skipped as well.
+        static const bool handlesMouseMove = !std::is_same<decltype(&Handler::onMouseMove), decltype(&EventHandler::onMouseMove)>::value;
+        static const bool handlesResize = !std::is_same<decltype(&Handler::onResize), decltype(&EventHandler::onResize)>::value;
+        static const bool handlesDrawTile = !std::is_same<decltype(&Handler::onDrawTile), decltype(&EventHandler::onDrawTile)>::value;
+
+    public:
+        typedef BasicPixelSurface<typename Handler::PixelFormat> Surface;
+
+    protected:
+        bool isActive;
+        unsigned sizeX, sizeY;
+
+        Surface pixelSurface;
+        bool pixelSurfaceInUse = false;
+
+        FrameProfiler frameProfiler;
+        double interpolation = 0;
+        InputTracker inputTracker;
+
+        // Index of the current process() call, for recording and replaying input.
+        std::uint32_t eventFrame = 0;
+        std::unique_ptr<InputRecorder> inputRecorder;
+        std::uint32_t recordStartFrame = 0;
+        std::uint64_t recordStartNs = 0;
+        std::unique_ptr<InputReplayer> inputReplayer;
+        ReplaySpeed replaySpeed = ReplaySpeed::Fastest;
+        std::uint32_t replayStartFrame = 0;
+        std::uint64_t replayStartNs = 0;
+
+        std::unique_ptr<FrameCapture> frameCapture;
+        // Set by backends that read frames back a few frames late; hands the frames still
+        // in flight to frameCapture and frees the readback buffers before it is replaced.
+        void (*finishCaptureReadback)(BasicWindowBase&) = nullptr;
+        std::unique_ptr<SharedFrameWriter> sharedFrames;
+
+        PresentStats presentStatistics;
+        double dirtyThreshold = 0.5;
+
+        std::uint64_t (*eventClock)() = &clockNs;
+        bool latencyTracing = false;
+        bool stampingEvents = false;                    // tracing or a test clock
+        bool inEventBatch = false;
+        std::uint64_t eventBatchNs = 0;                 // read by the first stamped event of the batch
+        InputLatency latencyTracer;
+
+        FrameArena scratchArena;    // no memory until the first allocation
+
+#ifdef OGLW_COROUTINES
+        TaskScheduler taskScheduler;
+#endif
+
+        // Called by the backends' display() before onDisplay.
+        void runTasks() {
+#ifdef OGLW_COROUTINES
+            if (taskScheduler.idle())
+                return;
+            PhaseTimer timer(frameProfiler, FramePhase::Tasks);
+            taskScheduler.runFrame();
+#endif
+        }
+
+        // Events are only stamped while latency is traced or a test clock is installed, so
+        // plain dispatch doesn't read the clock.
+        bool stampsEvents() const { return stampingEvents; }
+
+        std::uint64_t eventNow() const { return eventClock == &clockNs ? clockNs() : eventClock(); }
+
+        // Every event of a process() batch is dispatched at the same time, read once.
+        // arrivalNs 0 means the event arrives then too.
+        void stamp(EventTime& time, std::uint64_t arrivalNs) {
+            if (!inEventBatch)
+                time.dispatchNs = eventNow();
+            else
+                time.dispatchNs = eventBatchNs ? eventBatchNs : (eventBatchNs = eventNow());
+            time.arrivalNs = arrivalNs ? arrivalNs : time.dispatchNs;
+            if (latencyTracing)
+                latencyTracer.dispatched(time);
+        }
+
+        // Fills in info.time if events are stamped.
+        template <class Info>
+        Info stamped(Info info, std::uint64_t arrivalNs) {
+            if (stampsEvents())
+                stamp(info.time, arrivalNs);
+            return info;
+        }
+
+        // Called by the backends' display() once the frame is on its way to the screen.
+        void framePresented() {
+            if (latencyTracing)
+                latencyTracer.presented(eventNow());
+        }
+
+        // Called at the very end of the backends' display().
+        void frameDone() {
+            scratchArena.reset();
+        }
+
+        // Calls copy(DirtyRect) for the parts of the pixel surface that changed since the
+        // last present, or once for all of it if the target lost its contents (full) or the
+        // changes cover more than dirtyThreshold of the surface.
+        template <typename Copy>
+        void presentDirty(bool full, Copy copy) {
+            DirtyRegion const& dirty = pixelSurface.dirtyRegion();
+            const unsigned width = pixelSurface.width(), height = pixelSurface.height();
+            const std::uint64_t total = std::uint64_t(width) * height;
+            std::uint64_t copied = 0;
+
+            ++presentStatistics.frames;
+            if (full || dirty.full() || dirty.area() > dirtyThreshold * total) {
+                copy(DirtyRect { 0, 0, int(width), int(height) });
+                copied = total;
+                ++presentStatistics.fullFrames;
+                ++presentStatistics.rects;
+            }
+            else if (dirty.empty()) {
+                ++presentStatistics.unchangedFrames;
+            }
+            else {
+                for (unsigned i = 0; i < dirty.count(); ++i) {
+                    copy(dirty.rects()[i]);
+                    copied += dirty.rects()[i].area();
+                }
+                ++presentStatistics.partialFrames;
+                presentStatistics.rects += dirty.count();
+            }
+            presentStatistics.lastFrameBytes = copied * sizeof(typename Surface::Pixel);
+            presentStatistics.bytes += presentStatistics.lastFrameBytes;
+            pixelSurface.clearDirty();
+        }
+
+        std::unique_ptr<SpriteBatch> spriteBatch;   // created by the first sprites()
+
+        std::unique_ptr<TilePool> tilePool;     // created by the first tiled frame
+        unsigned renderThreadCount = 0;
+        unsigned tileWidth = 64, tileHeight = 64;
+
+        // Runs onDrawTile over the pixel surface on the tile pool; returns after the last tile.
+        void drawTiles() {
+            drawTiles(std::integral_constant<bool, handlesDrawTile>());
+        }
+
+        // Not instantiated for handlers without onDrawTile, whose surface may not be a PixelSurface.
+        void drawTiles(std::false_type) { }
+
+        void drawTiles(std::true_type) {
+            if (!this->drawsTiles())
+                return;
+            Surface& surface = pixels();
+            if (!tilePool)
+                tilePool.reset(new TilePool(renderThreadCount));
+
+            const unsigned columns = (sizeX + tileWidth - 1) / tileWidth;
+            const unsigned rows = (sizeY + tileHeight - 1) / tileHeight;
+            const bool tracking = surface.dirtyTracking();
+            surface.setDirtyTracking(false);
+            tilePool->parallelFor(columns * rows, [this, &surface, columns](std::uint32_t index, unsigned worker) {
+                Tile tile;
+                tile.x = index % columns * tileWidth;
+                tile.y = index / columns * tileHeight;
+                tile.width = std::min(tileWidth, sizeX - tile.x);
+                tile.height = std::min(tileHeight, sizeY - tile.y);
+                tile.index = index;
+                tile.worker = worker;
+                this->onDrawTile(surface, tile);
+            });
+            surface.setDirtyTracking(tracking);
+            surface.markAllDirty();
+        }
+
+        // Hands a finished frame to the capture; pitch is in pixels.
+        void captureFrame(std::uint32_t const* pixels, std::size_t pitch, bool bottomUp) {
+            if (frameCapture->width() != sizeX || frameCapture->height() != sizeY)
+                frameCapture->dropFrame();
+            else
+                frameCapture->submit(pixels, pitch, bottomUp);
+        }
+
+        // Publishes a finished frame to the shared memory consumer; pitch is in pixels.
+        void shareFrame(std::uint32_t const* pixels, std::size_t pitch, bool bottomUp) {
+            if (sharedFrames->width() != sizeX || sharedFrames->height() != sizeY)
+                sharedFrames->dropFrame();
+            else
+                sharedFrames->write(pixels, pitch, bottomUp);
+        }
+
+        void record(Event const& e) {
+            if (!inputRecorder)
+                return;
+            RecordedEvent r;
+            std::memset(&r, 0, sizeof(r));
+            r.timeNs = clockNs() - recordStartNs;
+            r.frame = eventFrame - recordStartFrame;
+            r.type = static_cast<std::uint8_t>(e.type);
+            r.button = static_cast<std::uint8_t>(e.button);
+            r.active = e.active;
+            r.key = e.key;
+            r.x = e.x;
+            r.y = e.y;
+            inputRecorder->add(r);
+        }
+
+        // Mouse moves and resizes are collapsed until another kind of event arrives
+        // or the frame's events have all been processed.
+        bool pendingMouseMove = false;
+        bool pendingResize = false;
+        MouseInfo lastMouseMove;
+        std::vector<MouseInfo> mouseMoveHistory;
+
+        MouseInfo mouseInfoAt(int x, int y, MouseInfo::Button button = MouseInfo::Button::None) const {
+            double normX = static_cast<double>(x) / sizeX;
+            double normY = static_cast<double>(y) / sizeY;
+            return MouseInfo { x, y, normX, normY, button, EventTime() };
+        }
+
+        void flushCoalescedEvents() {
+            if (handlesResize && pendingResize) {
+                pendingResize = false;
+                this->onResize(sizeX, sizeY);
+            }
+            if (handlesMouseMove && pendingMouseMove) {
+                pendingMouseMove = false;
+                this->onMouseMove(lastMouseMove);
+                mouseMoveHistory.clear();
+            }
+        }
+
+        void dispatchMouseMove(MouseInfo const& info) {
+            record(Event::mouseMove(info.x, info.y));
+            inputTracker.mouseAt(info.x, info.y);
+            if (!handlesMouseMove)
+                return;
+            if (pendingResize)
+                flushCoalescedEvents();
+            pendingMouseMove = true;
+            lastMouseMove = info;
+            if (keepMouseMoveHistory)
+                mouseMoveHistory.push_back(info);
+        }
+
+        void dispatchResize(unsigned width, unsigned height) {
+            record(Event::resize(width, height));
+            if (pendingMouseMove)
+                flushCoalescedEvents();
+            pendingResize = handlesResize;
+            sizeX = width;
+            sizeY = height;
+        }
+
+        void dispatchKeyDown(KeyInfo const& info) {
+            record(Event::keyDown(info.key));
+            inputTracker.keyDown(info.key);
+            flushCoalescedEvents();
+            this->onKeyDown(info);
+        }
+
+        void dispatchKeyUp(KeyInfo const& info) {
+            record(Event::keyUp(info.key));
+            inputTracker.keyUp(info.key);
+            flushCoalescedEvents();
+            this->onKeyUp(info);
+        }
+
+        void dispatchMouseDown(MouseInfo const& info) {
+            record(Event::mouseDown(info.x, info.y, info.button));
+            inputTracker.mouseAt(info.x, info.y);
+            inputTracker.buttonDown(static_cast<unsigned>(info.button));
+            flushCoalescedEvents();
+            this->onMouseDown(info);
+        }
+
+        void dispatchMouseUp(MouseInfo const& info) {
+            record(Event::mouseUp(info.x, info.y, info.button));
+            inputTracker.mouseAt(info.x, info.y);
+            inputTracker.buttonUp(static_cast<unsigned>(info.button));
+            flushCoalescedEvents();
+            this->onMouseUp(info);
+        }
+
+        void dispatchActivate(bool active) {
+            record(Event::activate(active));
+            flushCoalescedEvents();
+            isActive = active;
+            if (!active)
+                inputTracker.releaseAll();
+            this->onActivate(active);
+        }
+
+        // Paced main loop for the backends' run(); see runFrameLoop.
+        template <typename Display, typename Process>
+        RunStats runPaced(FramePacing const& pacing, Display display, Process process) {
+            return runFrameLoop(pacing, process,
+                [this](double dt) { this->onUpdate(dt); },
+                [this, &display](double alpha) { interpolation = alpha; display(); });
+        }
+
+        // Mouse moves are only copied into lastMouseMove, so going through stamped() would
+        // double their cost; build them in place.
+        MouseInfo mouseMoveOf(Event const& e) {
+            MouseInfo info = mouseInfoAt(e.x, e.y);
+            if (stampsEvents())
+                stamp(info.time, e.timeNs);
+            return info;
+        }
+
+        // Close is left to the backend.
+        void dispatchEvent(Event const& e) {
+            switch (e.type) {
+                case Event::Type::KeyDown: dispatchKeyDown(stamped(KeyInfo { e.key }, e.timeNs)); break;
+                case Event::Type::KeyUp: dispatchKeyUp(stamped(KeyInfo { e.key }, e.timeNs)); break;
+                case Event::Type::MouseMove: dispatchMouseMove(mouseMoveOf(e)); break;
+                case Event::Type::MouseDown: dispatchMouseDown(stamped(mouseInfoAt(e.x, e.y, e.button), e.timeNs)); break;
+                case Event::Type::MouseUp: dispatchMouseUp(stamped(mouseInfoAt(e.x, e.y, e.button), e.timeNs)); break;
+                case Event::Type::Resize: dispatchResize(e.x, e.y); break;
+                case Event::Type::Activate: dispatchActivate(e.active); break;
+                case Event::Type::Close: break;
+            }
+        }
+
+        // Called by the backends' process() before and after the window system's events.
+        void beginEvents() {
+            inEventBatch = true;
+            eventBatchNs = 0;
+            if (!inputReplayer)
+                return;
+            inputReplayer->takeDue(replaySpeed, eventFrame - replayStartFrame, clockNs() - replayStartNs,
+                [this](RecordedEvent const& r) {
+                    dispatchEvent(Event { static_cast<Event::Type>(r.type), static_cast<MouseInfo::Button>(r.button),
+                        r.active != 0, r.key, r.x, r.y, 0 });
+                });
+            if (inputReplayer->finished())
+                inputReplayer.reset();
+        }
+
+        void endEvents() {
+            flushCoalescedEvents();
+            inEventBatch = false;
+            inputTracker.publish();
+            ++eventFrame;
+        }
+
+    public:
+        // When set, every move collapsed into the next onMouseMove/mousemoveCallback is
+        // kept and available through mouseMoves() while that callback runs.
+        bool keepMouseMoveHistory = false;
+        std::vector<MouseInfo> const& mouseMoves() const { return mouseMoveHistory; }
+
+        // During display() inside run(): fraction of an update step the frame is ahead of the simulation.
+        double interpolationAlpha() const { return interpolation; }
+
+        // Starts writing every dispatched input event (not Close) to a binary log at path,
+        // replacing any recording in progress.
+        void recordInput(std::string const& path) {
+            std::unique_ptr<InputRecorder> recorder(new InputRecorder);
+            if (!recorder->open(path))
+                throw WindowException("Can't open input log for writing: " + path);
+            inputRecorder = std::move(recorder);
+            recordStartFrame = eventFrame;
+            recordStartNs = clockNs();
+        }
+
+        // Returns the number of events recorded.
+        std::uint64_t stopRecording() {
+            const std::uint64_t count = inputRecorder ? inputRecorder->count() : 0;
+            inputRecorder.reset();
+            return count;
+        }
+
+        // Feeds a recorded log back through event dispatch, starting with the next process().
+        // The log is memory mapped, not loaded.
+        void replayInput(std::string const& path, ReplaySpeed speed = ReplaySpeed::Fastest) {
+            std::unique_ptr<InputReplayer> replayer(new InputReplayer);
+            if (!replayer->open(path))
+                throw WindowException("Can't read input log: " + path);
+            inputReplayer = std::move(replayer);
+            replaySpeed = speed;
+            replayStartFrame = eventFrame;
+            replayStartNs = clockNs();
+        }
+
+        bool replaying() const { return inputReplayer != nullptr; }
+
+        // Streams every frame display() presents to a file from a background thread, at
+        // the current window size; frames of another size are dropped.
+        void startCapture(CaptureParams const& params = CaptureParams()) {
+            std::unique_ptr<FrameCapture> capture(new FrameCapture);
+            if (!capture->start(params, sizeX, sizeY))
+                throw WindowException("Can't open capture output: " + params.path);
+            if (frameCapture && finishCaptureReadback)
+                finishCaptureReadback(*this);
+            frameCapture = std::move(capture);
+        }
+
+        // Waits for the writer to finish the queued frames.
+        CaptureStats stopCapture() {
+            CaptureStats stats;
+            if (frameCapture && finishCaptureReadback)
+                finishCaptureReadback(*this);
+            if (frameCapture)
+                stats = frameCapture->stop();
+            frameCapture.reset();
+            return stats;
+        }
+
+        CaptureStats captureStats() const { return frameCapture ? frameCapture->stats() : CaptureStats(); }
+        bool capturing() const { return frameCapture != nullptr; }
+
+        // Publishes every frame display() presents into a shared memory triple buffer
+        // named name (see SharedFrames.hpp), at the current window size; frames of another
+        // size are dropped. A SharedFrameReader in another process maps the newest one.
+        void startSharing(std::string const& name) {
+            std::unique_ptr<SharedFrameWriter> writer(new SharedFrameWriter);
+            if (!writer->create(name, sizeX, sizeY))
+                throw WindowException("Can't create shared memory for frames: " + name);
+            sharedFrames = std::move(writer);
+        }
+
+        // Removes the segment's name; a consumer that has it mapped keeps its last frame.
+        SharedFrameStats stopSharing() {
+            SharedFrameStats stats;
+            if (sharedFrames)
+                stats = sharedFrames->stats();
+            sharedFrames.reset();
+            return stats;
+        }
+
+        SharedFrameStats sharingStats() const { return sharedFrames ? sharedFrames->stats() : SharedFrameStats(); }
+        bool sharing() const { return sharedFrames != nullptr; }
+
+        // Traces how long key and mouse events take from arrival to the present of the
+        // frame after their dispatch; see latency(). Only then, or with setEventClock(), are
+        // the stamps on KeyInfo/MouseInfo set; otherwise they stay 0.
+        void setLatencyTracing(bool enabled) {
+            latencyTracing = enabled;
+            latencyTracer.reset();
+            stampingEvents = latencyTracing || eventClock != &clockNs;
+        }
+        InputLatency const& latency() const { return latencyTracer; }
+        void resetLatency() { latencyTracer.reset(); }
+
+        // Replaces clockNs() for dispatch and present stamps (and headless post times),
+        // e.g. with a simulated clock for testing against synthetic event times. With
+        // threadedEvents, set it and latency tracing before the event pump starts posting.
+        void setEventClock(std::uint64_t (*clock)()) {
+            eventClock = clock ? clock : &clockNs;
+            stampingEvents = latencyTracing || eventClock != &clockNs;
+        }
+
+        // Keyboard and mouse state as of the last process(); stays the same until the next one.
+        InputSnapshot const& input() const { return inputTracker.snapshot(); }
+
+        // Threads drawing tiles, including the one calling display(); 0 means one per
+        // hardware thread. Takes effect with the next tiled frame.
+        void setRenderThreads(unsigned threads) {
+            renderThreadCount = threads;
+            tilePool.reset();
+        }
+        unsigned renderThreads() const {
+            return tilePool ? tilePool->threads() : renderThreadCount ? renderThreadCount : std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        // Bytes copied or uploaded when presenting the pixel surface, and how often only
+        // dirty rectangles were.
+        PresentStats const& presentStats() const { return presentStatistics; }
+        void resetPresentStats() { presentStatistics = PresentStats(); }
+
+        // Fraction of the surface above which the whole surface is presented instead of
+        // the dirty rectangles (0 always presents everything).
+        void setDirtyThreshold(double fraction) { dirtyThreshold = fraction; }
+
+        // 64x64 by default (16 KiB of pixels, comfortably inside L1/L2).
+        void setTileSize(unsigned width, unsigned height) {
+            tileWidth = std::max(1u, width);
+            tileHeight = std::max(1u, height);
+        }
 
         bool active() const { return isActive; }
         unsigned getSizeX() const { return sizeX; }
         unsigned getSizeY() const { return sizeY; }
 
-        OpenGLWindowBase(unsigned sizeX, unsigned sizeY)
+        // Quads drawn at the end of display(), after displayFunc and the tiles, in as few
+        // batches as their layers and textures allow; see SpriteBatch. Textures added to
+        // it stay, the quads are dropped once drawn. GL draws them over the presented pixel
+        // surface; the headless backend rasterizes them into the surface itself.
+        SpriteBatch& sprites() {
+            if (!spriteBatch)
+                spriteBatch.reset(new SpriteBatch);
+            return *spriteBatch;
+        }
+
+        // Scratch memory for the frame, e.g. from displayFunc or updateFunc. Whatever is
+        // allocated from it stays valid until the end of the next display(), which resets
+        // it; after a few frames it stops allocating from the heap (see FrameArena).
+        FrameArena& frameArena() { return scratchArena; }
+
+#ifdef OGLW_COROUTINES
+        // Coroutine tasks owned by the window (C++20). Spawned tasks are resumed at the
+        // start of display(), i.e. between process() and displayFunc, until the frame's
+        // budget is spent; inside them, co_await nextFrame() yields until the next frame,
+        // co_await budget() only if the budget is spent, and co_await offload(f) runs f on
+        // a worker thread and resumes on the window thread with its result.
+        void spawn(Task task) { taskScheduler.spawn(std::move(task)); }
+        TaskScheduler::NextFrame nextFrame() { return taskScheduler.nextFrame(); }
+        TaskScheduler::Budget budget() { return taskScheduler.budget(); }
+        template <class F>
+        auto offload(F&& f) -> decltype(taskScheduler.offload(std::forward<F>(f))) { return taskScheduler.offload(std::forward<F>(f)); }
+
+        // Budget, worker threads and overrun statistics; the time spent also shows up
+        // as the tasks phase of frameTiming().
+        TaskScheduler& tasks() { return taskScheduler; }
+        TaskScheduler const& tasks() const { return taskScheduler; }
+#endif
+
+        // Time spent in each phase of display() and process(), per frame.
+        FrameProfiler& frameTiming() { return frameProfiler; }
+        FrameProfiler const& frameTiming() const { return frameProfiler; }
+
+        // CPU-side framebuffer. Once this has been called, display() presents the surface
+        // over the whole window after displayFunc, in a single upload (or copy).
+        Surface& pixels() {
+            pixelSurface.resize(sizeX, sizeY);
+            pixelSurfaceInUse = true;
+            return pixelSurface;
+        }
+
+        BasicWindowBase(unsigned sizeX, unsigned sizeY)
             : sizeX(sizeX)
             , sizeY(sizeY)
         { }
     };
 
+    typedef BasicWindowBase<CallbackHandler> OpenGLWindowBase;
+
     struct OpenGLWindowParams {
-        std::string const& title = "OpenGL window";
+        std::string title = "OpenGL window";
         unsigned width = 800;
         unsigned height = 600;
         unsigned char bits = 32;
+        // Depth and stencil buffer sizes asked of GL. The headless window's rasterizer()
+        // rounds depth up to 16, 24 or 32 (float) bits and has 8-bit stencil unless 0.
+        unsigned char depthBits = 16;
+        unsigned char stencilBits = 8;
         bool fullscreen = false;
+        GlErrorCheck glErrorCheck = GlErrorCheck::EveryFrame;
+        unsigned glErrorCheckInterval = 60;      // for GlErrorCheck::EveryNFrames
+        // Pump window messages on a separate thread; process() then consumes them as
+        // Event records from a lock-free queue, so a slow frame doesn't stall the pump.
+        bool threadedEvents = false;
     };
+
+    // Window without any window system behind it. Renders into an in-memory
+    // RGBA8 framebuffer, so render loops can run on machines with no display or GPU.
+    template <class Handler>
+    class BasicHeadlessWindow : public BasicWindowBase<Handler> {
+    protected:
+        typedef BasicWindowBase<Handler> Base;
+        using Base::isActive;
+        using Base::sizeX;
+        using Base::sizeY;
+        using Base::pixelSurface;
+        using Base::pixelSurfaceInUse;
+
+        std::vector<std::uint32_t> m_Framebuffer;    // RGBA8 (byte order R, G, B, A), rows top to bottom
+        std::vector<Event> m_PostedEvents;
+        std::vector<Event> m_ProcessedEvents;        // Swapped with m_PostedEvents, keeps both allocations
+        std::unique_ptr<EventQueue> m_EventQueue;    // threadedEvents only
+        bool m_FramebufferFromSurface = false;       // holds the last presented surface
+        SoftwareSpriteRenderer<typename Handler::PixelFormat> m_SpriteRenderer;
+        std::unique_ptr<SoftwareRasterizer<typename Handler::PixelFormat>> m_Rasterizer;    // created by the first rasterizer()
+        DepthFormat m_DepthFormat;
+        bool m_Stencil;
+        unsigned long long m_FrameCount = 0;
+        bool m_QuitRequested = false;
+
+        void consumeEvent(Event const& e) {
+            if (e.type == Event::Type::Close)
+                m_QuitRequested = true;
+            else
+                this->dispatchEvent(e);
+        }
+
+        // Dispatches every event posted since the last process(), like the message queue
+        // of a real window. Events posted from callbacks wait for the next call.
+        bool processEvents() {
+            this->beginEvents();
+            if (m_EventQueue)
+                m_EventQueue->consume([this](Event const& e) { consumeEvent(e); });
+            // Without threadedEvents, everything posted; with it, resize() from this thread.
+            m_ProcessedEvents.swap(m_PostedEvents);
+            for (Event const& e : m_ProcessedEvents)
+                consumeEvent(e);
+            m_ProcessedEvents.clear();
+            this->endEvents();
+
+            if (m_Framebuffer.size() != static_cast<std::size_t>(sizeX) * sizeY) {
+                m_Framebuffer.assign(static_cast<std::size_t>(sizeX) * sizeY, 0u);
+                m_FramebufferFromSurface = false;
+            }
+
+            return !m_QuitRequested;
+        }
+
+    public:
+        void close() {
+            m_QuitRequested = true;
+        }
+
+        void display() {
+            this->runTasks();
+            {
+                PhaseTimer timer(this->frameProfiler, FramePhase::Display);
+                this->onDisplay();
+                this->drawTiles();
+                if (this->spriteBatch && !this->spriteBatch->empty()) {
+                    m_SpriteRenderer.render(*this->spriteBatch, this->pixels());
+                    this->spriteBatch->finishFrame();
+                }
+            }
+
+            if (pixelSurfaceInUse) {
+                PhaseTimer timer(this->frameProfiler, FramePhase::Present);
+                pixelSurface.resize(sizeX, sizeY);
+                const std::size_t pixels = static_cast<std::size_t>(sizeX) * sizeY;
+                const bool stale = m_Framebuffer.size() != pixels || !m_FramebufferFromSurface;
+                m_Framebuffer.resize(pixels);
+                m_FramebufferFromSurface = true;
+                this->presentDirty(stale, [this](DirtyRect const& r) {
+                    pixelSurface.copyRectTo(m_Framebuffer.data(), r);
+                });
+            }
+
+            this->framePresented();
+
+            if (this->frameCapture) {
+                PhaseTimer timer(this->frameProfiler, FramePhase::Capture);
+                this->captureFrame(m_Framebuffer.data(), sizeX, false);
+            }
+
+            if (this->sharedFrames) {
+                PhaseTimer timer(this->frameProfiler, FramePhase::Capture);
+                this->shareFrame(m_Framebuffer.data(), sizeX, false);
+            }
+
+            ++m_FrameCount;
+            this->frameDone();
+        }
+
+        bool process() {
+            bool running;
+            {
+                PhaseTimer timer(this->frameProfiler, FramePhase::Process);
+                running = processEvents();
+            }
+            this->frameProfiler.endFrame();
+            return running;
+        }
+
+        // Paced alternative to `while (win.display(), win.process());` that sleeps between
+        // frames and calls onUpdate/updateFunc at a fixed rate.
+        RunStats run(FramePacing const& pacing = FramePacing()) {
+            return this->runPaced(pacing, [this]() { display(); }, [this]() { return process(); });
+        }
+
+        // Queues a synthetic event for the next process(). With threadedEvents, call this
+        // from a single thread other than the one running process() (the "event pump");
+        // it waits while the queue is full. Events without a time (see Event::at) arrive now.
+        void postEvent(Event e) {
+            if (!e.timeNs && this->stampsEvents())
+                e.timeNs = this->eventNow();
+            if (m_EventQueue) {
+                while (!m_EventQueue->tryPush(e))
+                    std::this_thread::yield();
+            }
+            else {
+                m_PostedEvents.push_back(e);
+            }
+        }
+
+        // Equivalent of the user resizing a real window. Call it from the thread running
+        // process(); with threadedEvents it bypasses the queue, which has the pump as its
+        // only producer.
+        void resize(unsigned width, unsigned height) {
+            Event e = Event::resize(width, height);
+            if (this->stampsEvents())
+                e.timeNs = this->eventNow();
+            m_PostedEvents.push_back(e);
+        }
+
+        std::uint32_t* framebuffer() { return m_Framebuffer.data(); }
+        std::uint32_t const* framebuffer() const { return m_Framebuffer.data(); }
+        unsigned long long frameCount() const { return m_FrameCount; }
+
+        // Stands in for GL's depth and stencil tested triangles: draws into pixels(), with
+        // depth and stencil buffers of the depthBits and stencilBits the window was created
+        // with, sized to the window. Clear them with rasterizer().clear(pixels()) per frame.
+        SoftwareRasterizer<typename Handler::PixelFormat>& rasterizer() {
+            if (!m_Rasterizer)
+                m_Rasterizer.reset(new SoftwareRasterizer<typename Handler::PixelFormat>(m_DepthFormat, m_Stencil));
+            return *m_Rasterizer;
+        }
+
+        // There is no GL to check here; accepted so code written for a real window builds.
+        GlErrorCheck setGlErrorCheck(GlErrorCheck, unsigned = 60) { return GlErrorCheck::Never; }
+
+        BasicHeadlessWindow(OpenGLWindowParams const& parameters = OpenGLWindowParams())
+            : Base(parameters.width, parameters.height)
+            , m_Framebuffer(static_cast<std::size_t>(parameters.width) * parameters.height, 0u)
+            , m_DepthFormat(depthFormatFor(parameters.depthBits))
+            , m_Stencil(parameters.stencilBits > 0)
+        {
+            isActive = true;
+            if (parameters.threadedEvents)
+                m_EventQueue.reset(new EventQueue);
+        }
+    };
+
+    typedef BasicHeadlessWindow<CallbackHandler> HeadlessWindow;
 }
 
 #ifdef _WIN32
 
 namespace oglw {
 
-    class WinAPIOGLWindow : public OpenGLWindowBase {
+    // Window classes shared by every window with the same WndProc. A class is registered
+    // when its first window is created and unregistered after its last one is gone.
+    class WindowClasses {
+        struct Entry {
+            WNDPROC proc;
+            std::wstring name;
+            unsigned refs;
+        };
+
+        static std::mutex& mutex() { static std::mutex m; return m; }
+        static std::vector<Entry>& entries() { static std::vector<Entry> e; return e; }
+
+    public:
+        // Returns the class name, or an empty string if registration failed.
+        static std::wstring acquire(HINSTANCE instance, WNDPROC proc) {
+            std::lock_guard<std::mutex> lock(mutex());
+            for (Entry& e : entries()) {
+                if (e.proc == proc) {
+                    ++e.refs;
+                    return e.name;
+                }
+            }
+
+            static unsigned serial = 0;
+            std::wstring name = L"OpenGL";
+            if (serial)
+                name += std::to_wstring(serial);
+            ++serial;
+
+            WNDCLASS wc;
+            wc.style = CS_HREDRAW | CS_VREDRAW | CS_OWNDC;    // Redraw On Size, And Own DC For Window.
+            wc.lpfnWndProc = proc;
+            wc.cbClsExtra = 0;
+            wc.cbWndExtra = 0;
+            wc.hInstance = instance;
+            wc.hIcon = LoadIconW(NULL, IDI_WINLOGO);
+            wc.hCursor = LoadCursorW(NULL, IDC_ARROW);
+            wc.hbrBackground = NULL;                          // No Background Required For GL
+            wc.lpszMenuName = NULL;
+            wc.lpszClassName = name.c_str();
+            if (!RegisterClassW(&wc))
+                return std::wstring();
+
+            entries().push_back(Entry { proc, name, 1 });
+            return name;
+        }
+
+        static void release(HINSTANCE instance, WNDPROC proc) {
+            std::lock_guard<std::mutex> lock(mutex());
+            std::vector<Entry>& e = entries();
+            for (std::size_t i = 0; i < e.size(); ++i) {
+                if (e[i].proc == proc && --e[i].refs == 0) {
+                    UnregisterClassW(e[i].name.c_str(), instance);
+                    e.erase(e.begin() + i);
+                    return;
+                }
+            }
+        }
+
+        // ChoosePixelFormat is slow and gives the same answer for the same request on
+        // the same display, so windows and surfaces look each distinct request up once.
+        static int pixelFormat(HDC hDC, PIXELFORMATDESCRIPTOR const& pfd) {
+            struct Format {
+                DWORD flags;
+                BYTE type, colorBits, alphaBits, depthBits, stencilBits;
+                int format;
+            };
+            static std::vector<Format> cached;
+            std::lock_guard<std::mutex> lock(mutex());
+            for (Format const& f : cached)
+                if (f.flags == pfd.dwFlags && f.type == pfd.iPixelType && f.colorBits == pfd.cColorBits &&
+                    f.alphaBits == pfd.cAlphaBits && f.depthBits == pfd.cDepthBits && f.stencilBits == pfd.cStencilBits)
+                    return f.format;
+            const int format = ChoosePixelFormat(hDC, &pfd);
+            if (format)
+                cached.push_back({ pfd.dwFlags, pfd.iPixelType, pfd.cColorBits, pfd.cAlphaBits,
+                                   pfd.cDepthBits, pfd.cStencilBits, format });
+            return format;
+        }
+    };
+
+    template <class Handler>
+    class BasicWinAPIOGLWindow : public BasicWindowBase<Handler> {
     protected:
-        HDC m_hDC;            // Private GDI Device Context
-        HGLRC m_hRC;            // Permanent Rendering Context
-        HWND  m_hWnd;            // Holds Our Window Handle
-        HINSTANCE m_hInstance;        // Holds The Instance Of The Application
+        typedef BasicWindowBase<Handler> Base;
+        using Base::sizeX;
+        using Base::sizeY;
+        using Base::pixelSurface;
+        using Base::pixelSurfaceInUse;
+
+        HDC m_hDC = nullptr;            // Private GDI Device Context
+        HGLRC m_hRC = nullptr;            // Permanent Rendering Context
+        HWND  m_hWnd = nullptr;            // Holds Our Window Handle
+        HINSTANCE m_hInstance = nullptr;        // Holds The Instance Of The Application
+        std::wstring m_ClassName;               // Empty until the window class is acquired
+        GLuint m_PixelTexture = 0;    // Backs the pixel surface; power-of-two sized for GL 1.1
+        unsigned m_PixelTextureSizeX = 0, m_PixelTextureSizeY = 0;
+        unsigned m_PixelTextureWidth = 0, m_PixelTextureHeight = 0;     // part in use, as of the last upload
         bool m_Fullscreen;
-        bool throwOnGlErrors = true;
+        GlErrorChecker m_GlErrors;
+
+        // Frame capture readback: glReadPixels into a ring of pixel pack buffers, mapped a
+        // few frames later so the copy doesn't stall on the GPU. Without PBO support
+        // (m_PboCount == 0) frames are read back synchronously into m_CaptureScratch.
+        typedef std::ptrdiff_t GLsizeiptrType;
+        typedef void (OGLW_GL_CALLBACK *GenBuffersProc)(GLsizei, GLuint*);
+        typedef void (OGLW_GL_CALLBACK *DeleteBuffersProc)(GLsizei, const GLuint*);
+        typedef void (OGLW_GL_CALLBACK *BindBufferProc)(GLenum, GLuint);
+        typedef void (OGLW_GL_CALLBACK *BufferDataProc)(GLenum, GLsizeiptrType, const void*, GLenum);
+        typedef void (OGLW_GL_CALLBACK *BufferSubDataProc)(GLenum, std::ptrdiff_t, GLsizeiptrType, const void*);
+        typedef void* (OGLW_GL_CALLBACK *MapBufferProc)(GLenum, GLenum);
+        typedef GLboolean (OGLW_GL_CALLBACK *UnmapBufferProc)(GLenum);
+        static const GLenum glPixelPackBuffer = 0x88EB;
+        static const GLenum glStreamRead = 0x88E1;
+        static const GLenum glReadOnly = 0x88B8;
+        static const unsigned maxPbos = 3;
+
+        // GL 1.5 buffer object entry points, looked up by the first user.
+        bool m_BufferProcsLoaded = false;
+        GenBuffersProc m_GenBuffers = nullptr;
+        DeleteBuffersProc m_DeleteBuffers = nullptr;
+        BindBufferProc m_BindBuffer = nullptr;
+        BufferDataProc m_BufferData = nullptr;
+        BufferSubDataProc m_BufferSubData = nullptr;
+        MapBufferProc m_MapBuffer = nullptr;
+        UnmapBufferProc m_UnmapBuffer = nullptr;
+        GLuint m_Pbos[maxPbos];
+        unsigned m_PboCount = 0;
+        bool m_PbosReady = false;
+        unsigned long long m_PboIssued = 0, m_PboRetired = 0;
+        std::vector<std::uint32_t> m_CaptureScratch;
+
+        // Sprite batches: the vertex stream goes into one array buffer, orphaned each frame
+        // so the upload never waits for the last frame's draws (client arrays without
+        // buffer objects). Textures are power-of-two sized, like m_PixelTexture.
+        struct SpriteGlTexture {
+            GLuint name;
+            unsigned version;
+            GLfloat uScale, vScale;     // of the texture's coordinates to the part in use
+        };
+        static const GLenum glArrayBuffer = 0x8892;
+        static const GLenum glStreamDraw = 0x88E0;
+        GLuint m_SpriteBuffer = 0;
+        std::vector<SpriteGlTexture> m_SpriteTextures;
+
+        // threadedEvents only: the window is created and pumped on m_PumpThread,
+        // which hands events to process() through m_EventQueue.
+        std::unique_ptr<EventQueue> m_EventQueue;
+        std::thread m_PumpThread;
+        DWORD m_PumpThreadId = 0;
+        bool m_QuitRequested = false;
+
+        // Translates the messages the window reacts to into Event records.
+        static bool eventFromMessage(UINT uMsg, WPARAM wParam, LPARAM lParam, Event& e) {
+            const int x = LOWORD(lParam), y = HIWORD(lParam);
+            switch (uMsg) {
+                case WM_ACTIVATE: e = Event::activate(!HIWORD(wParam)); return true;
+                case WM_CLOSE: e = Event::close(); return true;
+                case WM_KEYDOWN: e = Event::keyDown(static_cast<unsigned>(wParam)); return true;
+                case WM_KEYUP: e = Event::keyUp(static_cast<unsigned>(wParam)); return true;
+                case WM_LBUTTONDOWN: e = Event::mouseDown(x, y, MouseInfo::Button::Left); return true;
+                case WM_RBUTTONDOWN: e = Event::mouseDown(x, y, MouseInfo::Button::Right); return true;
+                case WM_MBUTTONDOWN: e = Event::mouseDown(x, y, MouseInfo::Button::Middle); return true;
+                case WM_LBUTTONUP: e = Event::mouseUp(x, y, MouseInfo::Button::Left); return true;
+                case WM_RBUTTONUP: e = Event::mouseUp(x, y, MouseInfo::Button::Right); return true;
+                case WM_MBUTTONUP: e = Event::mouseUp(x, y, MouseInfo::Button::Middle); return true;
+                case WM_MOUSEMOVE: e = Event::mouseMove(x, y); return true;
+                case WM_SIZE: e = Event::resize(LOWORD(lParam), HIWORD(lParam)); return true;
+                default: return false;
+            }
+        }
+
+        // Runs on m_PumpThread for the lifetime of the window.
+        void pumpMessages(OpenGLWindowParams const& parameters, std::function<HGLRC(HDC)> const& contextCreator,
+            std::promise<bool>& created) {
+            m_PumpThreadId = GetCurrentThreadId();
+            const bool ok = create(parameters, contextCreator);
+            if (ok) {
+                wglMakeCurrent(NULL, NULL);            // The Render Thread Takes The Context Over
+            }
+            created.set_value(ok);
+            if (!ok) {
+                return;
+            }
+
+            MSG msg;
+            while (GetMessageW(&msg, NULL, 0, 0) > 0) {
+                TranslateMessage(&msg);
+                DispatchMessageW(&msg);
+            }
+
+            // The DC and the window belong to this thread.
+            if (m_hDC) {
+                ReleaseDC(m_hWnd, m_hDC);
+                m_hDC = nullptr;
+            }
+            if (m_hWnd) {
+                DestroyWindow(m_hWnd);
+                m_hWnd = nullptr;
+            }
+        }
+
+        static void* getGlProcAddress(const char* name) {
+            return reinterpret_cast<void*>(wglGetProcAddress(name));
+        }
 
         static LRESULT CALLBACK WndProc(HWND    hWnd,            // Handle For This Window
             UINT    uMsg,            // Message For This Window
             WPARAM    wParam,            // Additional Message Information
             LPARAM    lParam)            // Additional Message Information
         {
-            auto window = static_cast<WinAPIOGLWindow*>(reinterpret_cast<void*>(GetWindowLongPtrW(hWnd, GWLP_USERDATA)));
+            auto window = static_cast<BasicWinAPIOGLWindow*>(reinterpret_cast<void*>(GetWindowLongPtrW(hWnd, GWLP_USERDATA)));
+
+            Event event;
+            if (window && window->m_EventQueue && eventFromMessage(uMsg, wParam, lParam, event)) {
+                // Threaded Mode: Hand It Over To The Render Thread
+                event.timeNs = window->messageArrival();
+                while (!window->m_EventQueue->tryPush(event))
+                    std::this_thread::yield();
+                return 0;
+            }
 
             switch (uMsg)                                    // Check For Windows Messages
             {
             case WM_CREATE:
                 {
                     CREATESTRUCT *lpcs = reinterpret_cast<CREATESTRUCT*>(lParam);
-                    WinAPIOGLWindow* win = reinterpret_cast<WinAPIOGLWindow*>(lpcs->lpCreateParams);
+                    BasicWinAPIOGLWindow* win = reinterpret_cast<BasicWinAPIOGLWindow*>(lpcs->lpCreateParams);
 
                     SetWindowLongPtrW(hWnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(win));
                 }
@@ -121,14 +1161,8 @@ namespace oglw {
 
             case WM_ACTIVATE:                            // Watch For Window Activate Message
                 {
-                    if (!HIWORD(wParam))                    // Check Minimization State
-                        window->isActive = true;                        // Program Is Active
-                    else
-                        window->isActive = false;                        // Program Is No Longer Active
-
-                    if (window->activateCallback)
-                        window->activateCallback(window->isActive);
-
+                    // Active unless minimized
+                    window->dispatchActivate(!HIWORD(wParam));
                     return 0;                                // Return To The Message Loop
                 }
 
@@ -151,68 +1185,45 @@ namespace oglw {
 
             case WM_KEYDOWN:                            // Is A Key Being Held Down?
                 {
-                    if (window->keyupCallback)
-                        window->keyupCallback(KeyInfo { wParam });
+                    window->dispatchKeyDown(window->stamped(KeyInfo { wParam }, window->messageArrival()));
                     return 0;
                 }
             case WM_KEYUP:                                // Has A Key Been Released?
                 {
-                    if (window->keydownCallback)
-                        window->keydownCallback(KeyInfo { wParam });
+                    window->dispatchKeyUp(window->stamped(KeyInfo { wParam }, window->messageArrival()));
                     return 0;                                // Jump Back
                 }
 
                
             case WM_LBUTTONDOWN:
-                if (window->mousedownCallback){
-                    window->mousedownCallback(mouseInfoFromMsgParam(wParam, lParam, window, MouseInfo::Button::Left));
-                }
+                window->dispatchMouseDown(mouseInfoFromMsgParam(wParam, lParam, window, MouseInfo::Button::Left));
                 return 0;
             case WM_RBUTTONDOWN:
-                if (window->mousedownCallback){
-                    window->mousedownCallback(mouseInfoFromMsgParam(wParam, lParam, window, MouseInfo::Button::Right));
-                }
+                window->dispatchMouseDown(mouseInfoFromMsgParam(wParam, lParam, window, MouseInfo::Button::Right));
                 return 0;
             case WM_MBUTTONDOWN:
-                if (window->mousedownCallback){
-                    window->mousedownCallback(mouseInfoFromMsgParam(wParam, lParam, window, MouseInfo::Button::Middle));
-                }
+                window->dispatchMouseDown(mouseInfoFromMsgParam(wParam, lParam, window, MouseInfo::Button::Middle));
                 return 0;
 
             case WM_LBUTTONUP:
-                if (window->mouseupCallback){
-                    window->mouseupCallback(mouseInfoFromMsgParam(wParam, lParam, window, MouseInfo::Button::Left));
-                }
+                window->dispatchMouseUp(mouseInfoFromMsgParam(wParam, lParam, window, MouseInfo::Button::Left));
                 return 0;
             case WM_RBUTTONUP:
-                if (window->mouseupCallback){
-                    window->mouseupCallback(mouseInfoFromMsgParam(wParam, lParam, window, MouseInfo::Button::Right));
-                }
+                window->dispatchMouseUp(mouseInfoFromMsgParam(wParam, lParam, window, MouseInfo::Button::Right));
                 return 0;
             case WM_MBUTTONUP:
-                if (window->mouseupCallback){
-                    window->mouseupCallback(mouseInfoFromMsgParam(wParam, lParam, window, MouseInfo::Button::Middle));
-                }
+                window->dispatchMouseUp(mouseInfoFromMsgParam(wParam, lParam, window, MouseInfo::Button::Middle));
                 return 0;
 
             case WM_MOUSEMOVE:
                 {
-                    if (window->mousemoveCallback){
-                        window->mousemoveCallback(mouseInfoFromMsgParam(wParam, lParam, window));
-                    }
+                    window->dispatchMouseMove(mouseInfoFromMsgParam(wParam, lParam, window));
                     return 0;
                 }
 
             case WM_SIZE:                                // Resize The OpenGL Window
                 {
-                    unsigned Width = LOWORD(lParam);
-                    unsigned Height = HIWORD(lParam);
-
-                    window->sizeX = Width;
-                    window->sizeY = Height;
-
-                    if (window->resizeCallback)
-                        window->resizeCallback(Width, Height);
+                    window->dispatchResize(LOWORD(lParam), HIWORD(lParam));
                     return 0;                                // Jump Back
                 }
             }
@@ -221,8 +1232,147 @@ namespace oglw {
             return DefWindowProcW(hWnd, uMsg, wParam, lParam);
         }
 
+        // Sets up the PBO ring for the capture size, if the driver has buffer objects.
+        // Needs the context current; true if buffer objects can be created and filled.
+        bool loadBufferProcs() {
+            if (!m_BufferProcsLoaded) {
+                m_BufferProcsLoaded = true;
+                m_GenBuffers = reinterpret_cast<GenBuffersProc>(getGlProcAddress("glGenBuffers"));
+                m_DeleteBuffers = reinterpret_cast<DeleteBuffersProc>(getGlProcAddress("glDeleteBuffers"));
+                m_BindBuffer = reinterpret_cast<BindBufferProc>(getGlProcAddress("glBindBuffer"));
+                m_BufferData = reinterpret_cast<BufferDataProc>(getGlProcAddress("glBufferData"));
+                m_BufferSubData = reinterpret_cast<BufferSubDataProc>(getGlProcAddress("glBufferSubData"));
+                m_MapBuffer = reinterpret_cast<MapBufferProc>(getGlProcAddress("glMapBuffer"));
+                m_UnmapBuffer = reinterpret_cast<UnmapBufferProc>(getGlProcAddress("glUnmapBuffer"));
+            }
+            return m_GenBuffers && m_DeleteBuffers && m_BindBuffer && m_BufferData && m_BufferSubData;
+        }
+
+        void createCapturePbos() {
+            m_PbosReady = true;
+            if (!loadBufferProcs() || !m_MapBuffer || !m_UnmapBuffer)
+                return;
+
+            const GLsizeiptrType bytes = static_cast<GLsizeiptrType>(this->frameCapture->width()) * this->frameCapture->height() * 4;
+            m_GenBuffers(maxPbos, m_Pbos);
+            for (unsigned i = 0; i < maxPbos; ++i) {
+                m_BindBuffer(glPixelPackBuffer, m_Pbos[i]);
+                m_BufferData(glPixelPackBuffer, bytes, nullptr, glStreamRead);
+            }
+            m_BindBuffer(glPixelPackBuffer, 0);
+            m_PboCount = maxPbos;
+            m_PboIssued = m_PboRetired = 0;
+        }
+
+        // Maps the oldest PBO in flight and gives its contents to the capture.
+        void retireCapturePbo() {
+            m_BindBuffer(glPixelPackBuffer, m_Pbos[m_PboRetired % m_PboCount]);
+            if (void* mapped = m_MapBuffer(glPixelPackBuffer, glReadOnly)) {
+                this->frameCapture->submit(static_cast<std::uint32_t const*>(mapped), sizeX, true);
+                m_UnmapBuffer(glPixelPackBuffer);
+            }
+            else {
+                this->frameCapture->dropFrame();
+            }
+            m_BindBuffer(glPixelPackBuffer, 0);
+            ++m_PboRetired;
+        }
+
+        void releaseCapturePbos() {
+            if (m_PboCount)
+                m_DeleteBuffers(m_PboCount, m_Pbos);
+            m_PboCount = 0;
+            m_PbosReady = false;
+        }
+
+        // Collects the frames still in flight into the current capture, so they aren't lost
+        // or retired into the next one, and drops the ring sized for it.
+        void drainCapturePbos() {
+            if (this->frameCapture && m_PboCount) {
+                while (m_PboRetired < m_PboIssued)
+                    retireCapturePbo();
+            }
+            releaseCapturePbos();
+        }
+
+        static void drainCapture(Base& base) {
+            static_cast<BasicWinAPIOGLWindow&>(base).drainCapturePbos();
+        }
+
+        // Reads back the frame about to be swapped.
+        void captureBackBuffer() {
+            if (this->frameCapture->width() != sizeX || this->frameCapture->height() != sizeY) {
+                this->frameCapture->dropFrame();
+                return;
+            }
+            if (!m_PbosReady)
+                createCapturePbos();
+
+            glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+            glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+            glReadBuffer(GL_BACK);
+            if (m_PboCount) {
+                m_BindBuffer(glPixelPackBuffer, m_Pbos[m_PboIssued % m_PboCount]);
+                glReadPixels(0, 0, sizeX, sizeY, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+                m_BindBuffer(glPixelPackBuffer, 0);
+                ++m_PboIssued;
+                if (m_PboIssued - m_PboRetired == m_PboCount)
+                    retireCapturePbo();
+            }
+            else {
+                m_CaptureScratch.resize(static_cast<std::size_t>(sizeX) * sizeY);
+                glReadPixels(0, 0, sizeX, sizeY, GL_RGBA, GL_UNSIGNED_BYTE, m_CaptureScratch.data());
+                this->frameCapture->submit(m_CaptureScratch.data(), sizeX, true);
+            }
+            glPopClientAttrib();
+        }
+
+        // Reads the back buffer straight into the shared memory slot, no staging copy.
+        void shareBackBuffer() {
+            if (this->sharedFrames->width() != sizeX || this->sharedFrames->height() != sizeY) {
+                this->sharedFrames->dropFrame();
+                return;
+            }
+            glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+            glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+            glReadBuffer(GL_BACK);
+            glReadPixels(0, 0, sizeX, sizeY, GL_RGBA, GL_UNSIGNED_BYTE, this->sharedFrames->back());
+            glPopClientAttrib();
+            this->sharedFrames->publish(true);
+        }
+
+        // GL objects owned by the window; needs the context current.
+        void deleteGlObjects() {
+            if (m_PixelTexture) {
+                glDeleteTextures(1, &m_PixelTexture);
+                m_PixelTexture = 0;
+                m_PixelTextureSizeX = m_PixelTextureSizeY = 0;
+            }
+            drainCapturePbos();
+            for (SpriteGlTexture const& t : m_SpriteTextures)
+                glDeleteTextures(1, &t.name);
+            m_SpriteTextures.clear();
+            if (m_SpriteBuffer)
+                m_DeleteBuffers(1, &m_SpriteBuffer);
+            m_SpriteBuffer = 0;
+        }
+
         void kill(void)                    // Properly kill The Window
         {
+            if (m_EventQueue && m_PumpThread.joinable() && GetCurrentThreadId() != m_PumpThreadId) {
+                // The context is current on this thread; the pump thread cleans up the rest.
+                if (m_hRC) {
+                    deleteGlObjects();
+                    wglMakeCurrent(NULL, NULL);
+                    wglDeleteContext(m_hRC);
+                    m_hRC = nullptr;
+                }
+                PostThreadMessageW(m_PumpThreadId, WM_QUIT, 0, 0);
+                m_PumpThread.join();
+            }
+
             try {
                 if (m_Fullscreen) {
                     // Are We In Fullscreen Mode?
@@ -232,6 +1382,8 @@ namespace oglw {
 
                 if (m_hRC) {
                     // Do We Have A Rendering Context?
+                    deleteGlObjects();
+
                     if (!wglMakeCurrent(NULL, NULL)) {
                         m_hRC = nullptr;
                         throw WindowDestroyException("Release Of DC And RC Failed.");
@@ -255,9 +1407,9 @@ namespace oglw {
                     throw WindowDestroyException("Could Not Release hWnd.");
                 }
 
-                if (!UnregisterClassW(L"OpenGL", m_hInstance)) {
-                    m_hInstance = nullptr;
-                    throw WindowDestroyException("Could Not Unregister Class.");
+                if (!m_ClassName.empty()) {
+                    m_ClassName.clear();
+                    WindowClasses::release(m_hInstance, (WNDPROC) WndProc);
                 }
             }
             catch (WindowException &) {
@@ -265,7 +1417,7 @@ namespace oglw {
             }
         }
 
-        static MouseInfo mouseInfoFromMsgParam(WPARAM wParam, LPARAM lParam, WinAPIOGLWindow* window, 
+        static MouseInfo mouseInfoFromMsgParam(WPARAM wParam, LPARAM lParam, BasicWinAPIOGLWindow* window, 
             MouseInfo::Button button = MouseInfo::Button::None) {
             int x = LOWORD(lParam);
             int y = HIWORD(lParam);
@@ -280,27 +1432,263 @@ namespace oglw {
                 case 0: default:
                     b = MouseInfo::Button::None; break;
             }*/
-            return MouseInfo { x, y, normX, normY, button };
+            return window->stamped(MouseInfo { x, y, normX, normY, button, EventTime() }, window->messageArrival());
+        }
+
+        // GetMessageTime() is in milliseconds of GetTickCount(); moved onto the clockNs() timeline.
+        // When the message being handled arrived, if events are stamped.
+        std::uint64_t messageArrival() const {
+            if (!this->stampsEvents())
+                return 0;
+            const DWORD age = GetTickCount() - static_cast<DWORD>(GetMessageTime());
+            return clockNs() - static_cast<std::uint64_t>(age) * 1000000u;
+        }
+
+        static unsigned nextPowerOfTwo(unsigned v) {
+            unsigned p = 1;
+            while (p < v)
+                p <<= 1;
+            return p;
+        }
+
+        // Uploads the changed parts of the pixel surface with glTexSubImage2D and draws it as a
+        // screen-covering quad. All GL state touched here is saved and restored.
+        void presentPixelSurface() {
+            typedef typename Base::Surface::PixelFormat Format;
+            pixelSurface.resize(sizeX, sizeY);
+            const unsigned width = pixelSurface.width();
+            const unsigned height = pixelSurface.height();
+            if (width == 0 || height == 0)
+                return;
+
+            glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT | GL_VIEWPORT_BIT | GL_CURRENT_BIT | GL_TRANSFORM_BIT);
+            glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+
+            if (!m_PixelTexture)
+                glGenTextures(1, &m_PixelTexture);
+            glBindTexture(GL_TEXTURE_2D, m_PixelTexture);
+
+            bool stale = m_PixelTextureWidth != width || m_PixelTextureHeight != height;
+            if (width > m_PixelTextureSizeX || height > m_PixelTextureSizeY) {
+                stale = true;
+                m_PixelTextureSizeX = nextPowerOfTwo(width);
+                m_PixelTextureSizeY = nextPowerOfTwo(height);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_PixelTextureSizeX, m_PixelTextureSizeY, 0,
+                    Format::glFormat, Format::glType, nullptr);
+            }
+
+            m_PixelTextureWidth = width;
+            m_PixelTextureHeight = height;
+
+            // Only the rectangles that changed since the last frame, in the surface's own
+            // format; the driver converts while uploading.
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, pixelSurface.pitch());
+            this->presentDirty(stale, [this](DirtyRect const& r) {
+                glTexSubImage2D(GL_TEXTURE_2D, 0, r.x0, r.y0, r.x1 - r.x0, r.y1 - r.y0, Format::glFormat, Format::glType,
+                    pixelSurface.row(r.y0) + r.x0);
+            });
+
+            glDisable(GL_DEPTH_TEST);
+            glDisable(GL_LIGHTING);
+            glDisable(GL_BLEND);
+            glEnable(GL_TEXTURE_2D);
+            glViewport(0, 0, sizeX, sizeY);
+
+            glMatrixMode(GL_PROJECTION);
+            glPushMatrix();
+            glLoadIdentity();
+            glMatrixMode(GL_MODELVIEW);
+            glPushMatrix();
+            glLoadIdentity();
+
+            // Surface rows go top to bottom, GL's y axis goes up.
+            const GLfloat u = static_cast<GLfloat>(width) / m_PixelTextureSizeX;
+            const GLfloat v = static_cast<GLfloat>(height) / m_PixelTextureSizeY;
+            glColor4f(1.f, 1.f, 1.f, 1.f);
+            glBegin(GL_QUADS);
+            glTexCoord2f(0.f, v); glVertex2f(-1.f, -1.f);
+            glTexCoord2f(u, v);   glVertex2f(1.f, -1.f);
+            glTexCoord2f(u, 0.f); glVertex2f(1.f, 1.f);
+            glTexCoord2f(0.f, 0.f); glVertex2f(-1.f, 1.f);
+            glEnd();
+
+            glPopMatrix();
+            glMatrixMode(GL_PROJECTION);
+            glPopMatrix();
+            glMatrixMode(GL_MODELVIEW);
+
+            glPopClientAttrib();
+            glPopAttrib();
+        }
+
+        // Uploads textures the batch has added or updated since the last frame.
+        void syncSpriteTextures(SpriteBatch const& batch) {
+            if (m_SpriteTextures.size() < batch.textureCount())
+                m_SpriteTextures.resize(batch.textureCount(), SpriteGlTexture { 0, 0, 1.f, 1.f });
+            for (std::size_t i = 0; i < batch.textureCount(); ++i) {
+                SpriteGlTexture& t = m_SpriteTextures[i];
+                PixelSurface const& image = batch.texture(static_cast<SpriteTexture>(i + 1)).image;
+                const unsigned version = batch.texture(static_cast<SpriteTexture>(i + 1)).version;
+                if (t.name && t.version == version)
+                    continue;
+                if (!t.name)
+                    glGenTextures(1, &t.name);
+                const unsigned sizeX = nextPowerOfTwo(image.width()), sizeY = nextPowerOfTwo(image.height());
+                glBindTexture(GL_TEXTURE_2D, t.name);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, sizeX, sizeY, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+                glPixelStorei(GL_UNPACK_ROW_LENGTH, image.pitch());
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.width(), image.height(), GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+                t.version = version;
+                t.uScale = static_cast<GLfloat>(image.width()) / sizeX;
+                t.vScale = static_cast<GLfloat>(image.height()) / sizeY;
+            }
+        }
+
+        // One glDrawElements per run of the batch, in window pixel coordinates with y down,
+        // alpha-blended. All GL state touched here is saved and restored.
+        void drawSprites() {
+            SpriteBatch& batch = *this->spriteBatch;
+            batch.prepare();
+
+            glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT | GL_VIEWPORT_BIT | GL_COLOR_BUFFER_BIT | GL_TRANSFORM_BIT);
+            glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT | GL_CLIENT_VERTEX_ARRAY_BIT);
+            syncSpriteTextures(batch);
+
+            glDisable(GL_DEPTH_TEST);
+            glDisable(GL_LIGHTING);
+            glDisable(GL_CULL_FACE);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glViewport(0, 0, sizeX, sizeY);
+
+            glMatrixMode(GL_PROJECTION);
+            glPushMatrix();
+            glLoadIdentity();
+            glOrtho(0, sizeX, sizeY, 0, -1, 1);
+            glMatrixMode(GL_MODELVIEW);
+            glPushMatrix();
+            glLoadIdentity();
+            glMatrixMode(GL_TEXTURE);
+            glPushMatrix();
+
+            std::vector<SpriteVertex> const& vertices = batch.vertices();
+            const GLsizeiptrType bytes = static_cast<GLsizeiptrType>(vertices.size() * sizeof(SpriteVertex));
+            const char* base = reinterpret_cast<const char*>(vertices.data());
+            if (loadBufferProcs()) {
+                if (!m_SpriteBuffer)
+                    m_GenBuffers(1, &m_SpriteBuffer);
+                m_BindBuffer(glArrayBuffer, m_SpriteBuffer);
+                m_BufferData(glArrayBuffer, bytes, nullptr, glStreamDraw);
+                m_BufferSubData(glArrayBuffer, 0, bytes, vertices.data());
+                base = nullptr;
+            }
+            glEnableClientState(GL_VERTEX_ARRAY);
+            glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+            glEnableClientState(GL_COLOR_ARRAY);
+            glVertexPointer(2, GL_FLOAT, sizeof(SpriteVertex), base + offsetof(SpriteVertex, x));
+            glTexCoordPointer(2, GL_FLOAT, sizeof(SpriteVertex), base + offsetof(SpriteVertex, u));
+            glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(SpriteVertex), base + offsetof(SpriteVertex, color));
+
+            for (SpriteRun const& run : batch.runs()) {
+                if (run.texture) {
+                    SpriteGlTexture const& t = m_SpriteTextures[run.texture - 1];
+                    glEnable(GL_TEXTURE_2D);
+                    glBindTexture(GL_TEXTURE_2D, t.name);
+                    glLoadIdentity();
+                    glScalef(t.uScale, t.vScale, 1.f);
+                }
+                else {
+                    glDisable(GL_TEXTURE_2D);
+                }
+                glDrawElements(GL_QUADS, run.count * 4, GL_UNSIGNED_INT, batch.indices().data() + std::size_t(run.first) * 4);
+            }
+
+            if (m_SpriteBuffer)
+                m_BindBuffer(glArrayBuffer, 0);
+            glPopMatrix();
+            glMatrixMode(GL_MODELVIEW);
+            glPopMatrix();
+            glMatrixMode(GL_PROJECTION);
+            glPopMatrix();
+            glMatrixMode(GL_MODELVIEW);
+
+            glPopClientAttrib();
+            glPopAttrib();
+            batch.finishFrame();
         }
 
     public:
         void close() {
-            PostQuitMessage(0);
+            if (m_EventQueue)
+                m_QuitRequested = true;
+            else
+                PostQuitMessage(0);
         }
 
         void display() {
-            if (displayFunc) {
-                displayFunc();
+            this->runTasks();
+            {
+                PhaseTimer timer(this->frameProfiler, FramePhase::Display);
+                this->onDisplay();
+                this->drawTiles();
             }
 
-            if (throwOnGlErrors) {
-                auto err = glGetError();
+            if (m_GlErrors.policy() != GlErrorCheck::Never) {
+                PhaseTimer timer(this->frameProfiler, FramePhase::ErrorCheck);
+                auto err = m_GlErrors.check();
                 if (err) {
                     throw WindowOpenGLException("OpenGL Error occured: " + std::to_string(err));
                 }
             }
 
-            SwapBuffers(m_hDC);
+            if (pixelSurfaceInUse) {
+                PhaseTimer timer(this->frameProfiler, FramePhase::Present);
+                presentPixelSurface();
+            }
+
+            if (this->spriteBatch && !this->spriteBatch->empty()) {
+                PhaseTimer timer(this->frameProfiler, FramePhase::Display);
+                drawSprites();
+            }
+
+            if (this->frameCapture) {
+                PhaseTimer timer(this->frameProfiler, FramePhase::Capture);
+                captureBackBuffer();
+            }
+            else if (m_PbosReady) {
+                releaseCapturePbos();
+            }
+
+            if (this->sharedFrames) {
+                PhaseTimer timer(this->frameProfiler, FramePhase::Capture);
+                shareBackBuffer();
+            }
+
+            {
+                PhaseTimer timer(this->frameProfiler, FramePhase::Present);
+                SwapBuffers(m_hDC);
+            }
+            this->framePresented();
+            this->frameDone();
+        }
+
+        // Shares display lists, textures and buffers with another context, e.g. a
+        // SurfaceRegistry's sharedContext(). Call before creating any GL objects.
+        bool shareResources(HGLRC with) {
+            return wglShareLists(with, m_hRC) != FALSE;
+        }
+
+        HGLRC context() const { return m_hRC; }
+
+        // Returns the policy actually in effect (DebugCallback needs driver support).
+        GlErrorCheck setGlErrorCheck(GlErrorCheck policy, unsigned interval = 60) {
+            return m_GlErrors.setPolicy(policy, interval, &getGlProcAddress);
         }
 
         bool enableFullScreen(unsigned width, unsigned height, unsigned bits ) {
@@ -322,33 +1710,102 @@ namespace oglw {
         }
 
         bool process() {
-            MSG msg;
-            if (PeekMessageW(&msg, NULL, 0, 0, PM_REMOVE))    // Is There A Message Waiting?
+            bool running;
             {
-                if (msg.message == WM_QUIT) {
-                    return false;
+                PhaseTimer timer(this->frameProfiler, FramePhase::Process);
+                running = processMessages();
+            }
+            this->frameProfiler.endFrame();
+            return running;
+        }
+
+        // Paced alternative to `while (win.display(), win.process());` that sleeps between
+        // frames and calls onUpdate/updateFunc at a fixed rate.
+        RunStats run(FramePacing const& pacing = FramePacing()) {
+            timeBeginPeriod(1);        // Default Sleep Granularity Is Too Coarse For Pacing
+            try {
+                RunStats stats = this->runPaced(pacing, [this]() { display(); }, [this]() { return process(); });
+                timeEndPeriod(1);
+                return stats;
+            }
+            catch (...) {
+                timeEndPeriod(1);
+                throw;
+            }
+        }
+
+    protected:
+        // Drains the whole message queue; mouse moves and resizes are collapsed into
+        // one callback each (see BasicWindowBase::flushCoalescedEvents).
+        bool processMessages() {
+            this->beginEvents();
+            bool running = true;
+            if (m_EventQueue) {
+                // Threaded Mode: Take Everything The Pump Thread Queued So Far
+                m_EventQueue->consume([this](Event const& e) {
+                    if (e.type == Event::Type::Close)
+                        m_QuitRequested = true;
+                    else
+                        this->dispatchEvent(e);
+                });
+                running = !m_QuitRequested;
+            }
+            else {
+                MSG msg;
+                while (PeekMessageW(&msg, NULL, 0, 0, PM_REMOVE))    // Is There A Message Waiting?
+                {
+                    if (msg.message == WM_QUIT) {
+                        running = false;
+                        break;
+                    }
+                    TranslateMessage(&msg);                // Translate The Message
+                    DispatchMessageW(&msg);                // Dispatch The Message
                 }
-                TranslateMessage(&msg);                // Translate The Message
-                DispatchMessageW(&msg);                // Dispatch The Message
             }
-            return true;
+            this->endEvents();
+
+            std::string glError;
+            if (m_GlErrors.takeQueued(glError)) {
+                throw WindowOpenGLException("OpenGL Error occured: " + glError);
+            }
+            return running;
         }
 
+    public:
         /*void signalErrorMessage(const std::string& message, const std::string& caption = std::string()) {
             MessageBox(m_hWnd, message.c_str(), caption.c_str(), MB_OK | MB_ICONEXCLAMATION);
             throw std::runtime_error(message);
         }*/
 
-        WinAPIOGLWindow(
-            OpenGLWindowParams const& parameters,
+        BasicWinAPIOGLWindow(
+            OpenGLWindowParams const& parameters = OpenGLWindowParams(),
             std::function<HGLRC(HDC)> contextCreator = std::function<HGLRC(HDC)>()
             )
-            : m_Fullscreen(parameters.fullscreen)
-            , OpenGLWindowBase(parameters.width, parameters.height)
+            : Base(parameters.width, parameters.height)
+            , m_Fullscreen(parameters.fullscreen)
+        {
+            this->finishCaptureReadback = &drainCapture;
+            if (parameters.threadedEvents) {
+                m_EventQueue.reset(new EventQueue);
+                std::promise<bool> created;
+                std::future<bool> ready = created.get_future();
+                m_PumpThread = std::thread([this, &parameters, &contextCreator, &created]() {
+                    pumpMessages(parameters, contextCreator, created);
+                });
+                if (ready.get()) {
+                    wglMakeCurrent(m_hDC, m_hRC);
+                }
+            }
+            else {
+                create(parameters, contextCreator);
+            }
+        }
+
+        // Creates the window, its DC and GL context on the calling thread.
+        bool create(OpenGLWindowParams const& parameters, std::function<HGLRC(HDC)> const& contextCreator)
         {
             try {
                 unsigned        PixelFormat;            // Holds The Results After Searching For A Match
-                WNDCLASS    wc;                        // Windows Class Structure
                 DWORD        dwExStyle;                // Window Extended Style
                 DWORD        dwStyle;                // Window Style
                 RECT        WindowRect;                // Grabs Rectangle Upper Left / Lower Right Values
@@ -358,18 +1815,8 @@ namespace oglw {
                 WindowRect.bottom = (long) parameters.height;        // Set Bottom Value To Requested Height
 
                 m_hInstance = GetModuleHandleW(NULL);                // Grab An Instance For Our Window
-                wc.style = CS_HREDRAW | CS_VREDRAW | CS_OWNDC;    // Redraw On Size, And Own DC For Window.
-                wc.lpfnWndProc = (WNDPROC) WndProc;                    // WndProc Handles Messages
-                wc.cbClsExtra = 0;                                    // No Extra Window Data
-                wc.cbWndExtra = 0;                                    // No Extra Window Data
-                wc.hInstance = m_hInstance;                            // Set The Instance
-                wc.hIcon = LoadIconW(NULL, IDI_WINLOGO);            // Load The Default Icon
-                wc.hCursor = LoadCursorW(NULL, IDC_ARROW);            // Load The Arrow Pointer
-                wc.hbrBackground = NULL;                                    // No Background Required For GL
-                wc.lpszMenuName = NULL;                                    // We Don't Want A Menu
-                wc.lpszClassName = L"OpenGL";                                // Set The Class Name
-
-                if (!RegisterClassW(&wc))                                    // Attempt To Register The Window Class
+                m_ClassName = WindowClasses::acquire(m_hInstance, (WNDPROC) WndProc);    // Registered By The First Window Only
+                if (m_ClassName.empty())
                 {
                     MessageBoxW(NULL, L"Failed To Register The Window Class.", L"ERROR", MB_OK | MB_ICONEXCLAMATION);
                     throw WindowCreateException("Failed To Register The Window Class.");
@@ -396,7 +1843,7 @@ namespace oglw {
 
                 // Create The Window
                 if (!(m_hWnd = CreateWindowExW(dwExStyle,                            // Extended Style For The Window
-                    L"OpenGL",                            // Class Name
+                    m_ClassName.c_str(),                  // Class Name
                     wideTitle.c_str(),                           // Window Title
                     dwStyle |                                // Defined Window Style
                     WS_CLIPSIBLINGS |                        // Required Window Style
@@ -412,7 +1859,7 @@ namespace oglw {
                     throw WindowCreateException("Window Creation Error");
                 }
 
-                static PIXELFORMATDESCRIPTOR pfd =                // pfd Tells Windows How We Want Things To Be
+                PIXELFORMATDESCRIPTOR pfd =                       // pfd Tells Windows How We Want Things To Be
                 {
                     sizeof(PIXELFORMATDESCRIPTOR),                // Size Of This Pixel Format Descriptor
                     1,                                            // Version Number
@@ -426,8 +1873,8 @@ namespace oglw {
                     0,                                            // Shift Bit Ignored
                     0,                                            // No Accumulation Buffer
                     0, 0, 0, 0,                                    // Accumulation Bits Ignored
-                    16,                                            // 16Bit Z-Buffer (Depth Buffer)  
-                    8,                                            // No Stencil Buffer
+                    parameters.depthBits,                         // Z-Buffer (Depth Buffer) Bits
+                    parameters.stencilBits,                       // Stencil Buffer Bits
                     0,                                            // No Auxiliary Buffer
                     PFD_MAIN_PLANE,                                // Main Drawing Layer
                     0,                                            // Reserved
@@ -437,7 +1884,7 @@ namespace oglw {
                     // Did We Get A Device Context?
                     throw WindowCreateException("Can't Create A GL Device Context.");
                 }
-                if (!(PixelFormat = ChoosePixelFormat(m_hDC, &pfd))) {
+                if (!(PixelFormat = WindowClasses::pixelFormat(m_hDC, pfd))) {
                     // Did Windows Find A Matching Pixel Format?
                     throw WindowCreateException("Can't Find A Suitable PixelFormat.");
                 }
@@ -474,19 +1921,23 @@ namespace oglw {
                     m_hRC = BaselineContext;
                 }
 
+                setGlErrorCheck(parameters.glErrorCheck, parameters.glErrorCheckInterval);
+
                 ShowWindow(m_hWnd, SW_SHOW);                        // Show The Window
                 SetForegroundWindow(m_hWnd);                        // Slightly Higher Priority
                 SetFocus(m_hWnd);                                    // Sets Keyboard Focus To The Window
+                return true;
             }
             catch (WindowCreateException const&) {
                 kill();
+                return false;
             }
         }
 
        
 
 
-        ~WinAPIOGLWindow() {
+        ~BasicWinAPIOGLWindow() {
             try {
                 kill();
             }
@@ -498,14 +1949,32 @@ namespace oglw {
         }
     };
 
-    typedef WinAPIOGLWindow Window;
+    typedef BasicWinAPIOGLWindow<CallbackHandler> WinAPIOGLWindow;
+}
 
-    
+#endif // _WIN32
 
+namespace oglw {
+#if defined(_WIN32) && !defined(OGLW_HEADLESS)
+    template <class Handler> using BasicWindow = BasicWinAPIOGLWindow<Handler>;
 #else
-#error "This OS is not supported."
+    template <class Handler> using BasicWindow = BasicHeadlessWindow<Handler>;
 #endif
+    typedef BasicWindow<CallbackHandler> Window;
 
+    // Whether GL calls on this thread reach a driver. The headless backend never has a
+    // context, so timing GL entry points there measures nothing.
+    inline bool glContextCurrent() {
+#if defined(_WIN32) && !defined(OGLW_HEADLESS)
+        return wglGetCurrentContext() != NULL;
+#else
+        return false;
+#endif
+    }
 
+    // Lets a statically dispatched handler reach the window it is part of.
+    template <class Handler>
+    BasicWindow<Handler>& windowOf(Handler& handler) {
+        return static_cast<BasicWindow<Handler>&>(handler);
+    }
 }
-
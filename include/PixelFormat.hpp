@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "PixelKernels.hpp"
+
+// Pixel formats of BasicPixelSurface. Each format is a type with its storage type,
+// channel layout and conversions to and from RGBA8 as compile-time members, so
+// surfaces, kernels and the present conversion are specialized per format with no
+// per-pixel branching. glFormat/glType say how to upload the storage as is.
+namespace oglw {
+
+    // Packs a color into the RGBA8 layout (byte order R, G, B, A in memory on
+    // little-endian targets, i.e. what GL_RGBA/GL_UNSIGNED_BYTE expects).
+    inline std::uint32_t rgba(std::uint8_t r, std::uint8_t g, std::uint8_t b, std::uint8_t a = 255) {
+        return static_cast<std::uint32_t>(r)
+            | (static_cast<std::uint32_t>(g) << 8)
+            | (static_cast<std::uint32_t>(b) << 16)
+            | (static_cast<std::uint32_t>(a) << 24);
+    }
+
+    // Widens a bits-wide channel value to 8 bits by replicating its top bits, so that
+    // the maximum maps to 255 and narrowing back (>> (8 - bits)) gives the value again.
+    template <unsigned bits>
+    constexpr std::uint32_t expandChannel(std::uint32_t v) {
+        return bits >= 8 ? v : ((v << (8 - bits)) | (v >> (2 * bits >= 8 ? 2 * bits - 8 : 0)));
+    }
+
+    struct RGBA8 {
+        typedef std::uint32_t Pixel;
+        static const unsigned redBits = 8, greenBits = 8, blueBits = 8, alphaBits = 8;
+        static const unsigned redShift = 0, greenShift = 8, blueShift = 16, alphaShift = 24;
+        static const unsigned glFormat = 0x1908;        // GL_RGBA
+        static const unsigned glType = 0x1401;          // GL_UNSIGNED_BYTE
+        static const char* name() { return "rgba8"; }
+
+        static constexpr Pixel fromRGBA8(std::uint32_t c) { return c; }
+        static constexpr std::uint32_t toRGBA8(Pixel p) { return p; }
+    };
+
+    // Red in the top bits of a 16-bit word, no alpha.
+    struct RGB565 {
+        typedef std::uint16_t Pixel;
+        static const unsigned redBits = 5, greenBits = 6, blueBits = 5, alphaBits = 0;
+        static const unsigned redShift = 11, greenShift = 5, blueShift = 0, alphaShift = 0;
+        static const unsigned glFormat = 0x1907;        // GL_RGB
+        static const unsigned glType = 0x8363;          // GL_UNSIGNED_SHORT_5_6_5
+        static const char* name() { return "rgb565"; }
+
+        static constexpr Pixel fromRGBA8(std::uint32_t c) {
+            return static_cast<Pixel>((((c >> 3) & 0x1f) << redShift)
+                | (((c >> 10) & 0x3f) << greenShift)
+                | (((c >> 19) & 0x1f) << blueShift));
+        }
+        static constexpr std::uint32_t toRGBA8(Pixel p) {
+            return expandChannel<redBits>((p >> redShift) & 0x1f)
+                | (expandChannel<greenBits>((p >> greenShift) & 0x3f) << 8)
+                | (expandChannel<blueBits>((p >> blueShift) & 0x1f) << 16)
+                | 0xff000000u;
+        }
+    };
+
+    // One float channel, 0 to 1, taken from red and presented as gray.
+    struct R32F {
+        typedef float Pixel;
+        static const unsigned redBits = 32, greenBits = 0, blueBits = 0, alphaBits = 0;
+        static const unsigned redShift = 0, greenShift = 0, blueShift = 0, alphaShift = 0;
+        static const unsigned glFormat = 0x1909;        // GL_LUMINANCE
+        static const unsigned glType = 0x1406;          // GL_FLOAT
+        static const char* name() { return "r32f"; }
+
+        static constexpr Pixel fromRGBA8(std::uint32_t c) { return (c & 0xff) / 255.0f; }
+        static constexpr std::uint32_t gray(std::uint32_t v) { return v | (v << 8) | (v << 16) | 0xff000000u; }
+        static constexpr std::uint32_t toRGBA8(Pixel p) {
+            return gray(!(p > 0.0f) ? 0u : p >= 1.0f ? 255u : static_cast<std::uint32_t>(p * 255.0f + 0.5f));
+        }
+    };
+
+    // Row operations on a format's pixels. Formats without alpha copy instead of blending.
+    // The generic version is plain loops; the formats above use the SIMD kernels.
+    template <class Format>
+    struct PixelOps {
+        typedef typename Format::Pixel Pixel;
+
+        static void fill(Pixel* dst, std::size_t count, Pixel color) { std::fill(dst, dst + count, color); }
+        static void blend(Pixel* dst, Pixel const* src, std::size_t count) { std::memcpy(dst, src, count * sizeof(Pixel)); }
+
+        // To the RGBA8 the window presents.
+        static void toRGBA8(std::uint32_t* dst, Pixel const* src, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i)
+                dst[i] = Format::toRGBA8(src[i]);
+        }
+    };
+
+    template <>
+    struct PixelOps<RGBA8> {
+        typedef std::uint32_t Pixel;
+
+        static void fill(Pixel* dst, std::size_t count, Pixel color) { kernels::active().fill(dst, count, color); }
+        static void blend(Pixel* dst, Pixel const* src, std::size_t count) { kernels::active().blend(dst, src, count); }
+        static void toRGBA8(std::uint32_t* dst, Pixel const* src, std::size_t count) { std::memcpy(dst, src, count * sizeof(Pixel)); }
+    };
+
+    template <>
+    struct PixelOps<RGB565> {
+        typedef std::uint16_t Pixel;
+
+        static void fill(Pixel* dst, std::size_t count, Pixel color) { kernels::active().fill16(dst, count, color); }
+        static void blend(Pixel* dst, Pixel const* src, std::size_t count) { std::memcpy(dst, src, count * sizeof(Pixel)); }
+        static void toRGBA8(std::uint32_t* dst, Pixel const* src, std::size_t count) { kernels::active().rgb565ToRgba8(dst, src, count); }
+    };
+
+    template <>
+    struct PixelOps<R32F> {
+        typedef float Pixel;
+
+        // Same bits as a 32-bit fill.
+        static void fill(Pixel* dst, std::size_t count, Pixel color) {
+            std::uint32_t bits;
+            std::memcpy(&bits, &color, sizeof bits);
+            kernels::active().fill(reinterpret_cast<std::uint32_t*>(dst), count, bits);
+        }
+        static void blend(Pixel* dst, Pixel const* src, std::size_t count) { std::memcpy(dst, src, count * sizeof(Pixel)); }
+        static void toRGBA8(std::uint32_t* dst, Pixel const* src, std::size_t count) { kernels::active().grayToRgba8(dst, src, count); }
+    };
+}
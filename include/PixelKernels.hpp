@@ -0,0 +1,509 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if !defined(OGLW_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+    #define OGLW_X86_SIMD 1
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+        #define OGLW_TARGET_SSE2
+        #define OGLW_TARGET_AVX2
+    #else
+        #define OGLW_TARGET_SSE2 __attribute__((target("sse2")))
+        #define OGLW_TARGET_AVX2 __attribute__((target("avx2")))
+    #endif
+#endif
+
+// Row kernels behind PixelSurface's clear/fill/blit/line operations on RGBA8 pixels,
+// plus the fills and RGBA8 conversions of the other pixel formats and the color
+// modulation of sprite batches.
+// Each instruction set has its own implementation; the best one the CPU supports is
+// picked at runtime. All of them produce bit-identical results.
+namespace oglw {
+namespace kernels {
+
+    enum class Isa {
+        Scalar = 0, SSE2, AVX2,
+    };
+
+    inline const char* isaName(Isa isa) {
+        switch (isa) {
+            case Isa::SSE2: return "sse2";
+            case Isa::AVX2: return "avx2";
+            case Isa::Scalar: default: return "scalar";
+        }
+    }
+
+    struct KernelTable {
+        Isa isa;
+        // dst[0..count) = color
+        void (*fill)(std::uint32_t* dst, std::size_t count, std::uint32_t color);
+        // dst[i] = src[i] over dst[i], using the source alpha
+        void (*blend)(std::uint32_t* dst, std::uint32_t const* src, std::size_t count);
+        // dst[0..count) = color, for 16-bit pixels
+        void (*fill16)(std::uint16_t* dst, std::size_t count, std::uint16_t color);
+        // RGB565 to RGBA8, widening channels by bit replication; alpha 255
+        void (*rgb565ToRgba8)(std::uint32_t* dst, std::uint16_t const* src, std::size_t count);
+        // Float intensity to gray RGBA8: round(clamp(v, 0, 1) * 255), NaN as 0
+        void (*grayToRgba8)(std::uint32_t* dst, float const* src, std::size_t count);
+        // dst[i] = src[i] * color / 255 per channel, rounded; dst may be src
+        void (*modulate)(std::uint32_t* dst, std::uint32_t const* src, std::size_t count, std::uint32_t color);
+    };
+
+    namespace scalar {
+        inline void fill(std::uint32_t* dst, std::size_t count, std::uint32_t color) {
+            for (std::size_t i = 0; i < count; ++i)
+                dst[i] = color;
+        }
+
+        // Exact round(x / 255) for x in [0, 65025].
+        inline std::uint32_t div255(std::uint32_t x) {
+            x += 128;
+            return (x + (x >> 8)) >> 8;
+        }
+
+        // Color channels: (s * a + d * (255 - a)) / 255, alpha: a + da * (255 - a) / 255.
+        inline std::uint32_t blendPixel(std::uint32_t d, std::uint32_t s) {
+            const std::uint32_t a = s >> 24;
+            const std::uint32_t ia = 255 - a;
+            std::uint32_t out = 0;
+            for (unsigned shift = 0; shift < 24; shift += 8) {
+                const std::uint32_t sc = (s >> shift) & 0xff;
+                const std::uint32_t dc = (d >> shift) & 0xff;
+                out |= div255(sc * a + dc * ia) << shift;
+            }
+            out |= div255(a * 255 + (d >> 24) * ia) << 24;
+            return out;
+        }
+
+        inline void blend(std::uint32_t* dst, std::uint32_t const* src, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i)
+                dst[i] = blendPixel(dst[i], src[i]);
+        }
+
+        inline std::uint32_t modulatePixel(std::uint32_t s, std::uint32_t c) {
+            std::uint32_t out = 0;
+            for (unsigned shift = 0; shift < 32; shift += 8)
+                out |= div255(((s >> shift) & 0xff) * ((c >> shift) & 0xff)) << shift;
+            return out;
+        }
+
+        inline void modulate(std::uint32_t* dst, std::uint32_t const* src, std::size_t count, std::uint32_t color) {
+            for (std::size_t i = 0; i < count; ++i)
+                dst[i] = modulatePixel(src[i], color);
+        }
+
+        inline void fill16(std::uint16_t* dst, std::size_t count, std::uint16_t color) {
+            for (std::size_t i = 0; i < count; ++i)
+                dst[i] = color;
+        }
+
+        inline std::uint32_t rgb565Pixel(std::uint32_t p) {
+            const std::uint32_t r = p >> 11, g = (p >> 5) & 0x3f, b = p & 0x1f;
+            return ((r << 3) | (r >> 2)) | (((g << 2) | (g >> 4)) << 8) | (((b << 3) | (b >> 2)) << 16) | 0xff000000u;
+        }
+
+        inline void rgb565ToRgba8(std::uint32_t* dst, std::uint16_t const* src, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i)
+                dst[i] = rgb565Pixel(src[i]);
+        }
+
+        inline std::uint32_t grayPixel(float v) {
+            const std::uint32_t c = !(v > 0.0f) ? 0u : v >= 1.0f ? 255u : static_cast<std::uint32_t>(v * 255.0f + 0.5f);
+            return c | (c << 8) | (c << 16) | 0xff000000u;
+        }
+
+        inline void grayToRgba8(std::uint32_t* dst, float const* src, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i)
+                dst[i] = grayPixel(src[i]);
+        }
+    }
+
+#ifdef OGLW_X86_SIMD
+    namespace sse2 {
+        OGLW_TARGET_SSE2 inline void fill(std::uint32_t* dst, std::size_t count, std::uint32_t color) {
+            const __m128i c = _mm_set1_epi32(static_cast<int>(color));
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4)
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), c);
+            for (; i < count; ++i)
+                dst[i] = color;
+        }
+
+        // Two pixels widened to 16 bits per channel.
+        OGLW_TARGET_SSE2 inline __m128i blend2(__m128i d, __m128i s) {
+            const __m128i alphaLanes = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+            const __m128i c255 = _mm_set1_epi16(255);
+            const __m128i c128 = _mm_set1_epi16(128);
+
+            __m128i a = _mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3));
+            a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+            const __m128i ia = _mm_sub_epi16(c255, a);
+            // The alpha channel itself is weighted by 255 rather than by a.
+            const __m128i sa = _mm_or_si128(_mm_andnot_si128(alphaLanes, a), _mm_and_si128(alphaLanes, c255));
+
+            __m128i x = _mm_add_epi16(_mm_mullo_epi16(s, sa), _mm_mullo_epi16(d, ia));
+            x = _mm_add_epi16(x, c128);
+            x = _mm_add_epi16(x, _mm_srli_epi16(x, 8));
+            return _mm_srli_epi16(x, 8);
+        }
+
+        OGLW_TARGET_SSE2 inline void blend(std::uint32_t* dst, std::uint32_t const* src, std::size_t count) {
+            const __m128i zero = _mm_setzero_si128();
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                const __m128i s = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+                const __m128i d = _mm_loadu_si128(reinterpret_cast<__m128i const*>(dst + i));
+                const __m128i lo = blend2(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero));
+                const __m128i hi = blend2(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+            }
+            for (; i < count; ++i)
+                dst[i] = scalar::blendPixel(dst[i], src[i]);
+        }
+
+        // Pixels widened to 16 bits per channel, times color widened the same way.
+        OGLW_TARGET_SSE2 inline __m128i modulate2(__m128i s, __m128i c) {
+            __m128i x = _mm_add_epi16(_mm_mullo_epi16(s, c), _mm_set1_epi16(128));
+            x = _mm_add_epi16(x, _mm_srli_epi16(x, 8));
+            return _mm_srli_epi16(x, 8);
+        }
+
+        OGLW_TARGET_SSE2 inline void modulate(std::uint32_t* dst, std::uint32_t const* src, std::size_t count, std::uint32_t color) {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i c = _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int>(color)), zero);
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                const __m128i s = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+                const __m128i lo = modulate2(_mm_unpacklo_epi8(s, zero), c);
+                const __m128i hi = modulate2(_mm_unpackhi_epi8(s, zero), c);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+            }
+            for (; i < count; ++i)
+                dst[i] = scalar::modulatePixel(src[i], color);
+        }
+
+        OGLW_TARGET_SSE2 inline void fill16(std::uint16_t* dst, std::size_t count, std::uint16_t color) {
+            const __m128i c = _mm_set1_epi16(static_cast<short>(color));
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), c);
+            for (; i < count; ++i)
+                dst[i] = color;
+        }
+
+        // Eight RGB565 pixels as R | G << 8 (lo) and B | A << 8 (hi) per 16-bit lane.
+        OGLW_TARGET_SSE2 inline void expand565(__m128i p, __m128i& lo, __m128i& hi) {
+            const __m128i mask5 = _mm_set1_epi16(0x1f), mask6 = _mm_set1_epi16(0x3f);
+            const __m128i r = _mm_srli_epi16(p, 11);
+            const __m128i g = _mm_and_si128(_mm_srli_epi16(p, 5), mask6);
+            const __m128i b = _mm_and_si128(p, mask5);
+            const __m128i r8 = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+            const __m128i g8 = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+            const __m128i b8 = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+            lo = _mm_or_si128(r8, _mm_slli_epi16(g8, 8));
+            hi = _mm_or_si128(b8, _mm_set1_epi16(static_cast<short>(0xff00)));
+        }
+
+        OGLW_TARGET_SSE2 inline void rgb565ToRgba8(std::uint32_t* dst, std::uint16_t const* src, std::size_t count) {
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                __m128i lo, hi;
+                expand565(_mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i)), lo, hi);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi16(lo, hi));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(lo, hi));
+            }
+            for (; i < count; ++i)
+                dst[i] = scalar::rgb565Pixel(src[i]);
+        }
+
+        // max/min return their second operand for NaN, so NaN becomes 0 as in scalar::grayPixel.
+        OGLW_TARGET_SSE2 inline void grayToRgba8(std::uint32_t* dst, float const* src, std::size_t count) {
+            const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+            const __m128 scale = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+            const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000u));
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                const __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), zero), one);
+                const __m128i c = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half));
+                const __m128i gray = _mm_or_si128(_mm_or_si128(c, _mm_slli_epi32(c, 8)), _mm_slli_epi32(c, 16));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_or_si128(gray, alpha));
+            }
+            for (; i < count; ++i)
+                dst[i] = scalar::grayPixel(src[i]);
+        }
+    }
+
+    namespace avx2 {
+        OGLW_TARGET_AVX2 inline void fill(std::uint32_t* dst, std::size_t count, std::uint32_t color) {
+            const __m256i c = _mm256_set1_epi32(static_cast<int>(color));
+            std::size_t i = 0;
+            for (; i + 16 <= count; i += 16) {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), c);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 8), c);
+            }
+            for (; i + 8 <= count; i += 8)
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), c);
+            for (; i < count; ++i)
+                dst[i] = color;
+        }
+
+        // Same arithmetic as sse2::blend2, on four pixels.
+        OGLW_TARGET_AVX2 inline __m256i blend4(__m256i d, __m256i s) {
+            const __m256i alphaLanes = _mm256_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0);
+            const __m256i c255 = _mm256_set1_epi16(255);
+            const __m256i c128 = _mm256_set1_epi16(128);
+
+            __m256i a = _mm256_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3));
+            a = _mm256_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+            const __m256i ia = _mm256_sub_epi16(c255, a);
+            const __m256i sa = _mm256_blendv_epi8(a, c255, alphaLanes);
+
+            __m256i x = _mm256_add_epi16(_mm256_mullo_epi16(s, sa), _mm256_mullo_epi16(d, ia));
+            x = _mm256_add_epi16(x, c128);
+            x = _mm256_add_epi16(x, _mm256_srli_epi16(x, 8));
+            return _mm256_srli_epi16(x, 8);
+        }
+
+        OGLW_TARGET_AVX2 inline void blend(std::uint32_t* dst, std::uint32_t const* src, std::size_t count) {
+            const __m256i zero = _mm256_setzero_si256();
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                const __m256i s = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i));
+                const __m256i d = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(dst + i));
+                const __m256i lo = blend4(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi8(s, zero));
+                const __m256i hi = blend4(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi8(s, zero));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_packus_epi16(lo, hi));
+            }
+            sse2::blend(dst + i, src + i, count - i);
+        }
+
+        OGLW_TARGET_AVX2 inline __m256i modulate4(__m256i s, __m256i c) {
+            __m256i x = _mm256_add_epi16(_mm256_mullo_epi16(s, c), _mm256_set1_epi16(128));
+            x = _mm256_add_epi16(x, _mm256_srli_epi16(x, 8));
+            return _mm256_srli_epi16(x, 8);
+        }
+
+        OGLW_TARGET_AVX2 inline void modulate(std::uint32_t* dst, std::uint32_t const* src, std::size_t count, std::uint32_t color) {
+            const __m256i zero = _mm256_setzero_si256();
+            const __m256i c = _mm256_unpacklo_epi8(_mm256_set1_epi32(static_cast<int>(color)), zero);
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                const __m256i s = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i));
+                const __m256i lo = modulate4(_mm256_unpacklo_epi8(s, zero), c);
+                const __m256i hi = modulate4(_mm256_unpackhi_epi8(s, zero), c);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_packus_epi16(lo, hi));
+            }
+            sse2::modulate(dst + i, src + i, count - i, color);
+        }
+
+        OGLW_TARGET_AVX2 inline void fill16(std::uint16_t* dst, std::size_t count, std::uint16_t color) {
+            const __m256i c = _mm256_set1_epi16(static_cast<short>(color));
+            std::size_t i = 0;
+            for (; i + 16 <= count; i += 16)
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), c);
+            sse2::fill16(dst + i, count - i, color);
+        }
+
+        OGLW_TARGET_AVX2 inline void rgb565ToRgba8(std::uint32_t* dst, std::uint16_t const* src, std::size_t count) {
+            const __m256i mask5 = _mm256_set1_epi16(0x1f), mask6 = _mm256_set1_epi16(0x3f);
+            const __m256i alpha = _mm256_set1_epi16(static_cast<short>(0xff00));
+            std::size_t i = 0;
+            for (; i + 16 <= count; i += 16) {
+                // Quarters 0 2 1 3, so that the in-lane unpacks below come out in order.
+                const __m256i p = _mm256_permute4x64_epi64(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i)), 0xd8);
+                const __m256i r = _mm256_srli_epi16(p, 11);
+                const __m256i g = _mm256_and_si256(_mm256_srli_epi16(p, 5), mask6);
+                const __m256i b = _mm256_and_si256(p, mask5);
+                const __m256i r8 = _mm256_or_si256(_mm256_slli_epi16(r, 3), _mm256_srli_epi16(r, 2));
+                const __m256i g8 = _mm256_or_si256(_mm256_slli_epi16(g, 2), _mm256_srli_epi16(g, 4));
+                const __m256i b8 = _mm256_or_si256(_mm256_slli_epi16(b, 3), _mm256_srli_epi16(b, 2));
+                const __m256i lo = _mm256_or_si256(r8, _mm256_slli_epi16(g8, 8));
+                const __m256i hi = _mm256_or_si256(b8, alpha);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_unpacklo_epi16(lo, hi));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 8), _mm256_unpackhi_epi16(lo, hi));
+            }
+            sse2::rgb565ToRgba8(dst + i, src + i, count - i);
+        }
+
+        OGLW_TARGET_AVX2 inline void grayToRgba8(std::uint32_t* dst, float const* src, std::size_t count) {
+            const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+            const __m256 scale = _mm256_set1_ps(255.0f), half = _mm256_set1_ps(0.5f);
+            const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xff000000u));
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                const __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), zero), one);
+                const __m256i c = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, scale), half));
+                const __m256i gray = _mm256_or_si256(_mm256_or_si256(c, _mm256_slli_epi32(c, 8)), _mm256_slli_epi32(c, 16));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_or_si256(gray, alpha));
+            }
+            sse2::grayToRgba8(dst + i, src + i, count - i);
+        }
+    }
+#endif // OGLW_X86_SIMD
+
+    inline bool isaSupported(Isa isa) {
+        switch (isa) {
+        case Isa::Scalar:
+            return true;
+#ifdef OGLW_X86_SIMD
+    #ifdef _MSC_VER
+        case Isa::SSE2: {
+            int info[4];
+            __cpuid(info, 1);
+            return (info[3] & (1 << 26)) != 0;
+        }
+        case Isa::AVX2: {
+            int info[4];
+            __cpuid(info, 1);
+            const bool osxsave = (info[2] & (1 << 27)) != 0;
+            if (!osxsave || (_xgetbv(0) & 0x6) != 0x6)    // OS saves the YMM registers?
+                return false;
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+        }
+    #else
+        case Isa::SSE2:
+            return __builtin_cpu_supports("sse2") != 0;
+        case Isa::AVX2:
+            return __builtin_cpu_supports("avx2") != 0;
+    #endif
+#endif
+        default:
+            return false;
+        }
+    }
+
+    // Kernels for a specific instruction set; falls back to scalar ones if it isn't compiled in.
+    inline KernelTable kernelsFor(Isa isa) {
+#ifdef OGLW_X86_SIMD
+        if (isa == Isa::AVX2)
+            return KernelTable { Isa::AVX2, &avx2::fill, &avx2::blend, &avx2::fill16, &avx2::rgb565ToRgba8, &avx2::grayToRgba8, &avx2::modulate };
+        if (isa == Isa::SSE2)
+            return KernelTable { Isa::SSE2, &sse2::fill, &sse2::blend, &sse2::fill16, &sse2::rgb565ToRgba8, &sse2::grayToRgba8, &sse2::modulate };
+#endif
+        (void) isa;
+        return KernelTable { Isa::Scalar, &scalar::fill, &scalar::blend, &scalar::fill16, &scalar::rgb565ToRgba8, &scalar::grayToRgba8, &scalar::modulate };
+    }
+
+    inline KernelTable detectKernels() {
+        // OGLW_ISA=scalar|sse2|avx2 caps the selection, mostly for comparing paths.
+        Isa cap = Isa::AVX2;
+        if (const char* env = std::getenv("OGLW_ISA")) {
+            if (std::strcmp(env, "scalar") == 0)
+                cap = Isa::Scalar;
+            else if (std::strcmp(env, "sse2") == 0)
+                cap = Isa::SSE2;
+        }
+        for (Isa isa = cap; isa != Isa::Scalar; isa = static_cast<Isa>(static_cast<int>(isa) - 1)) {
+            if (isaSupported(isa))
+                return kernelsFor(isa);
+        }
+        return kernelsFor(Isa::Scalar);
+    }
+
+    // Selected once, on first use.
+    inline KernelTable const& active() {
+        static const KernelTable table = detectKernels();
+        return table;
+    }
+
+    // A Bresenham line with major extent d and minor extent e (e <= d), error term starting
+    // at d / 2: the minor axis has moved movesBefore(k) times before major step k, and
+    // first moves m times at major step firstStepWith(m). Past the end if it never does.
+    inline long long movesBefore(long long d, long long e, long long k) {
+        const long long n = k * e - d / 2;
+        return n <= 0 ? 0 : (n + d - 1) / d;
+    }
+
+    inline long long firstStepWith(long long d, long long e, long long m) {
+        if (m <= 0)
+            return 0;
+        return e ? ((m - 1) * d + d / 2) / e + 1 : d + 1;
+    }
+
+    // Clips such a line, running from a0 (major) and b0 (minor, direction sb), to an image
+    // aSize by bSize: the steps [first, last] whose pixels are on it. False if none are.
+    inline bool clipLine(int d, int e, int a0, int aSize, int b0, int sb, int bSize,
+        long long& first, long long& last) {
+        const long long mLo = sb > 0 ? -static_cast<long long>(b0) : static_cast<long long>(b0) - (bSize - 1);
+        const long long mHi = sb > 0 ? static_cast<long long>(bSize) - 1 - b0 : b0;
+        first = std::max(std::max(0ll, -static_cast<long long>(a0)), firstStepWith(d, e, mLo));
+        last = std::min(std::min(static_cast<long long>(d), static_cast<long long>(aSize) - 1 - a0),
+                        firstStepWith(d, e, mHi + 1) - 1);
+        return mHi >= 0 && first <= last;
+    }
+
+    // Bresenham line from (x0, y0) to (x1, y1), both ends inclusive, clipped to the image.
+    // Only the part on the image is walked: the error term is computed for its first pixel,
+    // so the pixels are the same as the unclipped line's. Lines closer to horizontal are
+    // emitted as row spans through fill(dst, count, color).
+    template <typename Pixel, typename Fill>
+    inline void lineSpans(Pixel* pixels, std::size_t pitch, int width, int height,
+        int x0, int y0, int x1, int y1, Pixel color, Fill fill) {
+        const int dx = std::abs(x1 - x0);
+        const int dy = std::abs(y1 - y0);
+        long long first, last;
+
+        if (dx >= dy) {
+            if (x0 > x1) {
+                int t = x0; x0 = x1; x1 = t;
+                t = y0; y0 = y1; y1 = t;
+            }
+            const int sy = y0 < y1 ? 1 : -1;
+            if (!clipLine(dx, dy, x0, width, y0, sy, height, first, last))
+                return;
+            const long long moves = movesBefore(dx, dy, first);
+            int err = static_cast<int>(dx / 2 - first * dy + moves * dx);
+            int y = y0 + sy * static_cast<int>(moves);
+            const int xEnd = x0 + static_cast<int>(last);
+            int spanStart = x0 + static_cast<int>(first);
+
+            for (int x = spanStart; x <= xEnd; ++x) {
+                err -= dy;
+                const bool stepY = err < 0;
+                if (stepY || x == xEnd) {
+                    fill(pixels + static_cast<std::size_t>(y) * pitch + spanStart, x - spanStart + 1, color);
+                    spanStart = x + 1;
+                }
+                if (stepY) {
+                    y += sy;
+                    err += dx;
+                }
+            }
+        }
+        else {
+            if (y0 > y1) {
+                int t = x0; x0 = x1; x1 = t;
+                t = y0; y0 = y1; y1 = t;
+            }
+            const int sx = x0 < x1 ? 1 : -1;
+            if (!clipLine(dy, dx, y0, height, x0, sx, width, first, last))
+                return;
+            const long long moves = movesBefore(dy, dx, first);
+            int err = static_cast<int>(dy / 2 - first * dx + moves * dy);
+            int x = x0 + sx * static_cast<int>(moves);
+            const int yEnd = y0 + static_cast<int>(last);
+
+            for (int y = y0 + static_cast<int>(first); y <= yEnd; ++y) {
+                pixels[static_cast<std::size_t>(y) * pitch + x] = color;
+                err -= dx;
+                if (err < 0) {
+                    x += sx;
+                    err += dy;
+                }
+            }
+        }
+    }
+
+    inline void line(std::uint32_t* pixels, std::size_t pitch, int width, int height,
+        int x0, int y0, int x1, int y1, std::uint32_t color, KernelTable const& k = active()) {
+        lineSpans(pixels, pitch, width, height, x0, y0, x1, y1, color, k.fill);
+    }
+}
+}
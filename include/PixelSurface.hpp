@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include "DirtyRegion.hpp"
+#include "PixelFormat.hpp"
+
+namespace oglw {
+
+    // CPU-side image the window presents in one go at the end of display(), with pixels
+    // in Format (see PixelFormat.hpp); conversion to what the window shows happens once,
+    // while presenting. Rows start on cache line boundaries; pitch() is the distance
+    // between rows in pixels.
+    //
+    // The drawing functions record what they change in a DirtyRegion, so presenting can
+    // skip unchanged pixels. Writes through data() and row() aren't tracked; follow them
+    // with markDirty() or markAllDirty().
+    template <class Format>
+    class BasicPixelSurface {
+    public:
+        typedef Format PixelFormat;
+        typedef typename Format::Pixel Pixel;
+        typedef PixelOps<Format> Ops;
+        static const std::size_t alignment = 64;
+
+        // Converts an RGBA8 color (see rgba()) to the surface's format.
+        static constexpr Pixel color(std::uint32_t rgba8) { return Format::fromRGBA8(rgba8); }
+
+    private:
+        std::unique_ptr<std::uint8_t[]> m_Storage;
+        Pixel* m_Pixels = nullptr;
+        unsigned m_Width = 0;
+        unsigned m_Height = 0;
+        unsigned m_Pitch = 0;
+
+        DirtyRegion m_Dirty;
+        bool m_Tracking = true;
+        // Bounding box of setPixel/plot writes, folded into m_Dirty on demand (cheaper
+        // than adding a rectangle per pixel).
+        int m_PointX0 = 0, m_PointY0 = 0, m_PointX1 = 0, m_PointY1 = 0;
+
+        void markPoint(int x, int y) {
+            if (m_PointX0 >= m_PointX1) {
+                m_PointX0 = x; m_PointY0 = y; m_PointX1 = x + 1; m_PointY1 = y + 1;
+                return;
+            }
+            m_PointX0 = std::min(m_PointX0, x);
+            m_PointY0 = std::min(m_PointY0, y);
+            m_PointX1 = std::max(m_PointX1, x + 1);
+            m_PointY1 = std::max(m_PointY1, y + 1);
+        }
+
+        void markClipped(int x0, int y0, int x1, int y1) {
+            if (m_Tracking)
+                m_Dirty.add(DirtyRect { x0, y0, x1, y1 });
+        }
+
+    public:
+        unsigned width() const { return m_Width; }
+        unsigned height() const { return m_Height; }
+        unsigned pitch() const { return m_Pitch; }
+        std::size_t sizeInBytes() const { return static_cast<std::size_t>(m_Pitch) * m_Height * sizeof(Pixel); }
+
+        Pixel* data() { return m_Pixels; }
+        Pixel const* data() const { return m_Pixels; }
+        Pixel* row(unsigned y) { return m_Pixels + static_cast<std::size_t>(y) * m_Pitch; }
+        Pixel const* row(unsigned y) const { return m_Pixels + static_cast<std::size_t>(y) * m_Pitch; }
+
+        // No bounds checking; use plot() for coordinates that may fall outside.
+        void setPixel(unsigned x, unsigned y, Pixel color) {
+            row(y)[x] = color;
+            if (m_Tracking)
+                markPoint(x, y);
+        }
+        Pixel getPixel(unsigned x, unsigned y) const { return row(y)[x]; }
+
+        void plot(int x, int y, Pixel color) {
+            if (x >= 0 && y >= 0 && static_cast<unsigned>(x) < m_Width && static_cast<unsigned>(y) < m_Height)
+                setPixel(x, y, color);
+        }
+
+        void clear(Pixel color = Pixel()) {
+            Ops::fill(m_Pixels, static_cast<std::size_t>(m_Pitch) * m_Height, color);
+            markAllDirty();
+        }
+
+        // Solid rectangle, clipped to the surface.
+        void fillRect(int x, int y, int width, int height, Pixel color) {
+            const int x0 = std::max(x, 0), y0 = std::max(y, 0);
+            const int x1 = std::min(x + width, static_cast<int>(m_Width));
+            const int y1 = std::min(y + height, static_cast<int>(m_Height));
+            if (x0 >= x1 || y0 >= y1)
+                return;
+
+            for (int yy = y0; yy < y1; ++yy)
+                Ops::fill(row(yy) + x0, x1 - x0, color);
+            markClipped(x0, y0, x1, y1);
+        }
+
+        // Alpha-blends a width*height image (rows srcPitch pixels apart) with its
+        // top left corner at (x, y), clipped to the surface. Formats without alpha copy.
+        void blit(Pixel const* src, unsigned width, unsigned height, unsigned srcPitch, int x, int y) {
+            const int x0 = std::max(x, 0), y0 = std::max(y, 0);
+            const int x1 = std::min(x + static_cast<int>(width), static_cast<int>(m_Width));
+            const int y1 = std::min(y + static_cast<int>(height), static_cast<int>(m_Height));
+            if (x0 >= x1 || y0 >= y1)
+                return;
+
+            for (int yy = y0; yy < y1; ++yy) {
+                Pixel const* srcRow = src + static_cast<std::size_t>(yy - y) * srcPitch + (x0 - x);
+                Ops::blend(row(yy) + x0, srcRow, x1 - x0);
+            }
+            markClipped(x0, y0, x1, y1);
+        }
+
+        void blit(BasicPixelSurface const& sprite, int x, int y) {
+            blit(sprite.data(), sprite.width(), sprite.height(), sprite.pitch(), x, y);
+        }
+
+        // Both end points inclusive, clipped to the surface.
+        void drawLine(int x0, int y0, int x1, int y1, Pixel color) {
+            kernels::lineSpans(m_Pixels, m_Pitch, m_Width, m_Height, x0, y0, x1, y1, color, &Ops::fill);
+            markClipped(std::max(std::min(x0, x1), 0), std::max(std::min(y0, y1), 0),
+                std::min(std::max(x0, x1) + 1, static_cast<int>(m_Width)), std::min(std::max(y0, y1) + 1, static_cast<int>(m_Height)));
+        }
+
+        // For writes through data() or row(); clipped to the surface.
+        void markDirty(int x, int y, int width, int height) {
+            markClipped(std::max(x, 0), std::max(y, 0),
+                std::min(x + width, static_cast<int>(m_Width)), std::min(y + height, static_cast<int>(m_Height)));
+        }
+
+        void markAllDirty() {
+            if (m_Tracking)
+                m_Dirty.markAll();
+        }
+
+        // Everything changed since the last clearDirty().
+        DirtyRegion const& dirtyRegion() {
+            if (m_PointX0 < m_PointX1) {
+                m_Dirty.add(DirtyRect { m_PointX0, m_PointY0, m_PointX1, m_PointY1 });
+                m_PointX0 = m_PointX1 = 0;
+            }
+            return m_Dirty;
+        }
+
+        void clearDirty() {
+            m_Dirty.clear();
+            m_PointX0 = m_PointX1 = 0;
+        }
+
+        // Off while several threads draw into the surface (the tracking isn't thread-safe);
+        // the window marks the whole surface dirty afterwards.
+        void setDirtyTracking(bool enabled) { m_Tracking = enabled; }
+        bool dirtyTracking() const { return m_Tracking; }
+
+        // Contents are undefined after a resize.
+        void resize(unsigned width, unsigned height) {
+            if (width == m_Width && height == m_Height)
+                return;
+
+            const unsigned pixelsPerLine = alignment / sizeof(Pixel);
+            const unsigned pitch = (width + pixelsPerLine - 1) / pixelsPerLine * pixelsPerLine;
+            const std::size_t bytes = static_cast<std::size_t>(pitch) * height * sizeof(Pixel);
+
+            std::unique_ptr<std::uint8_t[]> storage(new std::uint8_t[bytes + alignment]);
+            const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(storage.get());
+            const std::uintptr_t aligned = (address + alignment - 1) & ~static_cast<std::uintptr_t>(alignment - 1);
+
+            m_Storage = std::move(storage);
+            m_Pixels = reinterpret_cast<Pixel*>(aligned);
+            m_Width = width;
+            m_Height = height;
+            m_Pitch = pitch;
+            m_Dirty.markAll();
+        }
+
+        // Copies one rectangle, converted to RGBA8, into the same place of a tightly
+        // packed width*height image.
+        void copyRectTo(std::uint32_t* destination, DirtyRect const& r) const {
+            for (int y = r.y0; y < r.y1; ++y)
+                Ops::toRGBA8(destination + static_cast<std::size_t>(y) * m_Width + r.x0, row(y) + r.x0, r.x1 - r.x0);
+        }
+
+        // Copies the visible part of the surface, converted to RGBA8, into a tightly packed
+        // width*height image.
+        void copyTo(std::uint32_t* destination) const {
+            if (m_Pitch == m_Width) {
+                Ops::toRGBA8(destination, m_Pixels, static_cast<std::size_t>(m_Width) * m_Height);
+                return;
+            }
+            for (unsigned y = 0; y < m_Height; ++y)
+                Ops::toRGBA8(destination + static_cast<std::size_t>(y) * m_Width, row(y), m_Width);
+        }
+
+        BasicPixelSurface() = default;
+        BasicPixelSurface(unsigned width, unsigned height) { resize(width, height); }
+    };
+
+    typedef BasicPixelSurface<RGBA8> PixelSurface;
+}
@@ -0,0 +1,806 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "PixelSurface.hpp"
+
+// Triangles with depth and stencil testing in software, for drawing 3D scenes into a
+// pixel surface where there's no GL. Vertices come in clip space and follow GL's
+// conventions: counterclockwise front faces, depth range [0, 1], pixel centers at half
+// coordinates and the top-left fill rule, so triangles sharing an edge cover each pixel
+// along it once. Edges are half-space functions in 28.4 fixed point, evaluated first
+// for 32x32 pixel blocks and 8x8 tiles: those outside the triangle are skipped, those
+// inside it are filled without testing edges per pixel, and the rest are tested a row
+// of 8 pixels at a time, with AVX2 where the CPU has it. The scalar and AVX2 paths
+// produce identical results.
+namespace oglw {
+
+    enum class DepthFormat {
+        D16,        // 16-bit normalized
+        D24,        // 24-bit normalized, in 32-bit words
+        D32F,       // 32-bit float
+    };
+
+    inline unsigned depthBits(DepthFormat format) {
+        return format == DepthFormat::D16 ? 16 : format == DepthFormat::D24 ? 24 : 32;
+    }
+
+    // The smallest format with at least bits bits of depth (D32F above 24).
+    inline DepthFormat depthFormatFor(unsigned bits) {
+        return bits <= 16 ? DepthFormat::D16 : bits <= 24 ? DepthFormat::D24 : DepthFormat::D32F;
+    }
+
+    // A test passes if (incoming value) func (stored value), as in GL.
+    enum class CompareFunc {
+        Never, Less, Equal, LessEqual, Greater, NotEqual, GreaterEqual, Always,
+    };
+
+    enum class StencilOp {
+        Keep, Zero, Replace, Increment, Decrement, Invert, IncrementWrap, DecrementWrap,
+    };
+
+    enum class CullMode {
+        None, Back, Front,
+    };
+
+    // Vertex in clip space, i.e. after the projection: visible where -w <= x, y, z <= w.
+    // The color (see rgba()) is interpolated across the triangle in screen space.
+    struct RasterVertex {
+        float x, y, z, w;
+        std::uint32_t color;
+    };
+
+    struct RasterState {
+        CullMode cull = CullMode::Back;
+        bool depthTest = true;
+        bool depthWrite = true;                 // only with depthTest, as in GL
+        CompareFunc depthFunc = CompareFunc::Less;
+        bool colorWrite = true;
+        // Ignored without a stencil buffer; the stencil buffer only changes with stencilTest on.
+        bool stencilTest = false;
+        CompareFunc stencilFunc = CompareFunc::Always;
+        std::uint8_t stencilRef = 0;
+        std::uint8_t stencilReadMask = 0xFF;
+        std::uint8_t stencilWriteMask = 0xFF;
+        StencilOp stencilFail = StencilOp::Keep;
+        StencilOp depthFail = StencilOp::Keep;
+        StencilOp depthPass = StencilOp::Keep;
+    };
+
+    struct RasterStats {
+        unsigned long long triangles = 0;       // submitted
+        unsigned long long clipped = 0;         // crossed a clip plane and were cut
+        unsigned long long culled = 0;          // back or front facing, outside the view or without area
+        unsigned long long rasterized = 0;      // after clipping, including pieces of clipped ones
+        unsigned long long blocksRejected = 0;  // 32x32 blocks of the bounding boxes outside the triangle
+        unsigned long long tilesRejected = 0;   // 8x8 tiles
+        unsigned long long tilesCovered = 0;    // inside the triangle, no edge tests
+        unsigned long long tilesPartial = 0;    // edge tests per pixel
+        unsigned long long pixelsCovered = 0;   // pixel centers inside triangles
+        unsigned long long pixelsWritten = 0;   // passed the stencil and depth tests
+    };
+
+    // Depth and stencil values for a render target. Rows are padded to whole 8-pixel
+    // groups and there are whole 8-row tiles, so the rasterizer reads and writes tile
+    // rows without bounds checks.
+    class DepthStencilBuffer {
+        DepthFormat m_Format;
+        bool m_HasStencil;
+        unsigned m_Width = 0, m_Height = 0, m_Pitch = 0, m_Rows = 0;
+        std::vector<std::uint16_t> m_Depth16;
+        std::vector<std::uint32_t> m_Depth24;
+        std::vector<float> m_Depth32F;
+        std::vector<std::uint8_t> m_Stencil;
+        float m_ClearDepth = 1.f;
+        std::uint8_t m_ClearStencil = 0;
+
+        void allocate() {
+            const std::size_t size = static_cast<std::size_t>(m_Pitch) * m_Rows;
+            m_Depth16.assign(m_Format == DepthFormat::D16 ? size : 0, 0);
+            m_Depth24.assign(m_Format == DepthFormat::D24 ? size : 0, 0);
+            m_Depth32F.assign(m_Format == DepthFormat::D32F ? size : 0, 0.f);
+            m_Stencil.assign(m_HasStencil ? size : 0, 0);
+            clear(m_ClearDepth, m_ClearStencil);
+        }
+
+    public:
+        explicit DepthStencilBuffer(DepthFormat format = DepthFormat::D24, bool stencil = true)
+            : m_Format(format)
+            , m_HasStencil(stencil)
+        { }
+
+        // Contents are cleared (to the last clear values) when the format or size changes.
+        void setFormat(DepthFormat format, bool stencil) {
+            if (format == m_Format && stencil == m_HasStencil)
+                return;
+            m_Format = format;
+            m_HasStencil = stencil;
+            allocate();
+        }
+
+        void resize(unsigned width, unsigned height) {
+            if (width == m_Width && height == m_Height)
+                return;
+            m_Width = width;
+            m_Height = height;
+            m_Pitch = (width + 7) & ~7u;
+            m_Rows = (height + 7) & ~7u;
+            allocate();
+        }
+
+        void clear(float depth = 1.f, std::uint8_t stencil = 0) {
+            clearDepth(depth);
+            clearStencil(stencil);
+        }
+
+        void clearDepth(float depth) {
+            m_ClearDepth = std::min(std::max(depth, 0.f), 1.f);
+            std::fill(m_Depth16.begin(), m_Depth16.end(), static_cast<std::uint16_t>(m_ClearDepth * 65535.f + 0.5f));
+            std::fill(m_Depth24.begin(), m_Depth24.end(), static_cast<std::uint32_t>(m_ClearDepth * 16777215.f + 0.5f));
+            std::fill(m_Depth32F.begin(), m_Depth32F.end(), m_ClearDepth);
+        }
+
+        void clearStencil(std::uint8_t stencil) {
+            m_ClearStencil = stencil;
+            std::fill(m_Stencil.begin(), m_Stencil.end(), stencil);
+        }
+
+        DepthFormat format() const { return m_Format; }
+        bool hasStencil() const { return m_HasStencil; }
+        unsigned width() const { return m_Width; }
+        unsigned height() const { return m_Height; }
+        unsigned pitch() const { return m_Pitch; }
+
+        // Depth at a pixel, normalized to [0, 1].
+        float depth(unsigned x, unsigned y) const {
+            const std::size_t i = static_cast<std::size_t>(y) * m_Pitch + x;
+            switch (m_Format) {
+                case DepthFormat::D16: return m_Depth16[i] / 65535.f;
+                case DepthFormat::D24: return m_Depth24[i] / 16777215.f;
+                case DepthFormat::D32F: default: return m_Depth32F[i];
+            }
+        }
+
+        std::uint8_t stencil(unsigned x, unsigned y) const {
+            return m_HasStencil ? m_Stencil[static_cast<std::size_t>(y) * m_Pitch + x] : 0;
+        }
+
+        std::uint16_t* depth16Row(unsigned y) { return m_Depth16.data() + static_cast<std::size_t>(y) * m_Pitch; }
+        std::uint32_t* depth24Row(unsigned y) { return m_Depth24.data() + static_cast<std::size_t>(y) * m_Pitch; }
+        float* depth32FRow(unsigned y) { return m_Depth32F.data() + static_cast<std::size_t>(y) * m_Pitch; }
+        std::uint8_t* stencilRow(unsigned y) { return m_Stencil.data() + static_cast<std::size_t>(y) * m_Pitch; }
+    };
+
+    namespace raster {
+
+        // Stored depth values; depth tests compare quantized values, as GL does.
+        template <DepthFormat F>
+        struct DepthTraits;
+
+        template <>
+        struct DepthTraits<DepthFormat::D16> {
+            typedef std::uint16_t Value;
+            static float scale() { return 65535.f; }
+            static Value quantize(float z) { return static_cast<Value>(static_cast<int>(z * 65535.f + 0.5f)); }
+            static Value* row(DepthStencilBuffer& buffer, unsigned y) { return buffer.depth16Row(y); }
+        };
+
+        template <>
+        struct DepthTraits<DepthFormat::D24> {
+            typedef std::uint32_t Value;
+            static float scale() { return 16777215.f; }
+            static Value quantize(float z) { return static_cast<Value>(static_cast<int>(z * 16777215.f + 0.5f)); }
+            static Value* row(DepthStencilBuffer& buffer, unsigned y) { return buffer.depth24Row(y); }
+        };
+
+        template <>
+        struct DepthTraits<DepthFormat::D32F> {
+            typedef float Value;
+            static Value quantize(float z) { return z; }
+            static Value* row(DepthStencilBuffer& buffer, unsigned y) { return buffer.depth32FRow(y); }
+        };
+
+        template <class T>
+        inline bool passes(CompareFunc func, T value, T stored) {
+            switch (func) {
+                case CompareFunc::Never: return false;
+                case CompareFunc::Less: return value < stored;
+                case CompareFunc::Equal: return value == stored;
+                case CompareFunc::LessEqual: return value <= stored;
+                case CompareFunc::Greater: return value > stored;
+                case CompareFunc::NotEqual: return value != stored;
+                case CompareFunc::GreaterEqual: return value >= stored;
+                case CompareFunc::Always: default: return true;
+            }
+        }
+
+        inline std::uint8_t applyStencil(StencilOp op, std::uint8_t stencil, RasterState const& state) {
+            std::uint8_t value;
+            switch (op) {
+                case StencilOp::Keep: return stencil;
+                case StencilOp::Zero: value = 0; break;
+                case StencilOp::Replace: value = state.stencilRef; break;
+                case StencilOp::Increment: value = stencil == 255 ? 255 : static_cast<std::uint8_t>(stencil + 1); break;
+                case StencilOp::Decrement: value = stencil == 0 ? 0 : static_cast<std::uint8_t>(stencil - 1); break;
+                case StencilOp::Invert: value = static_cast<std::uint8_t>(~stencil); break;
+                case StencilOp::IncrementWrap: value = static_cast<std::uint8_t>(stencil + 1); break;
+                case StencilOp::DecrementWrap: default: value = static_cast<std::uint8_t>(stencil - 1); break;
+            }
+            return static_cast<std::uint8_t>((stencil & ~state.stencilWriteMask) | (value & state.stencilWriteMask));
+        }
+
+        inline std::uint32_t channel(float v) {
+            return static_cast<std::uint32_t>(static_cast<int>(std::min(std::max(v, 0.f), 255.f) + 0.5f));
+        }
+
+        inline unsigned bitCount(unsigned mask) {
+            unsigned n = 0;
+            for (; mask; mask &= mask - 1)
+                ++n;
+            return n;
+        }
+
+        // z, then red, green, blue and alpha (0 to 255)
+        static const unsigned planeCount = 5;
+
+        // Per-triangle constants for the tiles. Edge i is inside where
+        // a[i] * x + b[i] * y + c[i] >= 0, in 1/16 pixels at pixel centers.
+        struct Triangle {
+            std::int64_t a[3], b[3], c[3];
+            std::int32_t edgeLane[3][8];        // a * 16 * lane
+            std::int32_t edgeRow[3][8];         // b * 16 * row
+            double plane0[planeCount];          // value at pixel (0, 0)
+            double planeDx[planeCount], planeDy[planeCount];
+            float planeLane[planeCount][8];     // planeDx * lane
+            float planeRow[planeCount][8];      // planeDy * row
+            bool flat;                          // one color, not interpolated
+            std::uint32_t color;
+        };
+
+        struct Tile {
+            int x, y;
+            unsigned rows;                      // 8 but at the bottom of the target
+            bool partial;
+            std::int32_t edge[3];               // at the first pixel (partial tiles only)
+            float plane[planeCount];            // at the first pixel
+        };
+
+        template <DepthFormat F, class Format>
+        void tileScalar(Triangle const& t, Tile const& tile, RasterState const& state,
+            DepthStencilBuffer& depthStencil, BasicPixelSurface<Format>& target, RasterStats& stats) {
+            typedef DepthTraits<F> Depth;
+            const bool stencil = state.stencilTest && depthStencil.hasStencil();
+            const std::uint8_t ref = state.stencilRef & state.stencilReadMask;
+
+            for (unsigned r = 0; r < tile.rows; ++r) {
+                const unsigned y = static_cast<unsigned>(tile.y) + r;
+                typename Depth::Value* depth = Depth::row(depthStencil, y) + tile.x;
+                std::uint8_t* stencilValues = stencil ? depthStencil.stencilRow(y) + tile.x : nullptr;
+                typename Format::Pixel* color = target.row(y) + tile.x;
+                const std::int32_t e0 = tile.edge[0] + t.edgeRow[0][r];
+                const std::int32_t e1 = tile.edge[1] + t.edgeRow[1][r];
+                const std::int32_t e2 = tile.edge[2] + t.edgeRow[2][r];
+                float p[planeCount];
+                for (unsigned i = 0; i < planeCount; ++i)
+                    p[i] = tile.plane[i] + t.planeRow[i][r];
+
+                for (unsigned l = 0; l < 8; ++l) {
+                    if (tile.partial && ((e0 + t.edgeLane[0][l]) | (e1 + t.edgeLane[1][l]) | (e2 + t.edgeLane[2][l])) < 0)
+                        continue;
+                    ++stats.pixelsCovered;
+                    const typename Depth::Value z = Depth::quantize(std::min(std::max(p[0] + t.planeLane[0][l], 0.f), 1.f));
+                    const bool depthPasses = !state.depthTest || passes(state.depthFunc, z, depth[l]);
+                    if (stencil) {
+                        const std::uint8_t s = stencilValues[l];
+                        if (!passes(state.stencilFunc, ref, static_cast<std::uint8_t>(s & state.stencilReadMask))) {
+                            stencilValues[l] = applyStencil(state.stencilFail, s, state);
+                            continue;
+                        }
+                        stencilValues[l] = applyStencil(depthPasses ? state.depthPass : state.depthFail, s, state);
+                    }
+                    if (!depthPasses)
+                        continue;
+                    ++stats.pixelsWritten;
+                    if (state.depthTest && state.depthWrite)
+                        depth[l] = z;
+                    if (state.colorWrite) {
+                        const std::uint32_t c = t.flat ? t.color : channel(p[1] + t.planeLane[1][l])
+                            | channel(p[2] + t.planeLane[2][l]) << 8
+                            | channel(p[3] + t.planeLane[3][l]) << 16
+                            | channel(p[4] + t.planeLane[4][l]) << 24;
+                        color[l] = Format::fromRGBA8(c);
+                    }
+                }
+            }
+        }
+
+#ifdef OGLW_X86_SIMD
+        // Tiles without stencil testing, eight pixels per instruction.
+        namespace avx2 {
+            template <DepthFormat F>
+            struct DepthLanes;
+
+            // D16 and D24 compare as floats, which hold their values exactly.
+            template <>
+            struct DepthLanes<DepthFormat::D16> {
+                OGLW_TARGET_AVX2 static __m256 load(std::uint16_t const* p) {
+                    return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const*>(p))));
+                }
+                OGLW_TARGET_AVX2 static __m256 quantize(__m256 z) {
+                    const __m256 scaled = _mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(DepthTraits<DepthFormat::D16>::scale())), _mm256_set1_ps(0.5f));
+                    return _mm256_cvtepi32_ps(_mm256_cvttps_epi32(scaled));
+                }
+                OGLW_TARGET_AVX2 static void store(std::uint16_t* p, __m256 z, __m256i mask) {
+                    const __m256i v = _mm256_cvttps_epi32(z);
+                    const __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+                    const __m128i mask16 = _mm_packs_epi32(_mm256_castsi256_si128(mask), _mm256_extracti128_si256(mask, 1));
+                    const __m128i old = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_blendv_epi8(old, packed, mask16));
+                }
+            };
+
+            template <>
+            struct DepthLanes<DepthFormat::D24> {
+                OGLW_TARGET_AVX2 static __m256 load(std::uint32_t const* p) {
+                    return _mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(p)));
+                }
+                OGLW_TARGET_AVX2 static __m256 quantize(__m256 z) {
+                    const __m256 scaled = _mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(DepthTraits<DepthFormat::D24>::scale())), _mm256_set1_ps(0.5f));
+                    return _mm256_cvtepi32_ps(_mm256_cvttps_epi32(scaled));
+                }
+                OGLW_TARGET_AVX2 static void store(std::uint32_t* p, __m256 z, __m256i mask) {
+                    const __m256i old = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm256_blendv_epi8(old, _mm256_cvttps_epi32(z), mask));
+                }
+            };
+
+            template <>
+            struct DepthLanes<DepthFormat::D32F> {
+                OGLW_TARGET_AVX2 static __m256 load(float const* p) { return _mm256_loadu_ps(p); }
+                OGLW_TARGET_AVX2 static __m256 quantize(__m256 z) { return z; }
+                OGLW_TARGET_AVX2 static void store(float* p, __m256 z, __m256i mask) {
+                    _mm256_storeu_ps(p, _mm256_blendv_ps(_mm256_loadu_ps(p), z, _mm256_castsi256_ps(mask)));
+                }
+            };
+
+            OGLW_TARGET_AVX2 inline __m256i compare(CompareFunc func, __m256 value, __m256 stored) {
+                __m256 m;
+                switch (func) {
+                    case CompareFunc::Never: return _mm256_setzero_si256();
+                    case CompareFunc::Less: m = _mm256_cmp_ps(value, stored, _CMP_LT_OQ); break;
+                    case CompareFunc::Equal: m = _mm256_cmp_ps(value, stored, _CMP_EQ_OQ); break;
+                    case CompareFunc::LessEqual: m = _mm256_cmp_ps(value, stored, _CMP_LE_OQ); break;
+                    case CompareFunc::Greater: m = _mm256_cmp_ps(value, stored, _CMP_GT_OQ); break;
+                    case CompareFunc::NotEqual: m = _mm256_cmp_ps(value, stored, _CMP_NEQ_OQ); break;
+                    case CompareFunc::GreaterEqual: m = _mm256_cmp_ps(value, stored, _CMP_GE_OQ); break;
+                    case CompareFunc::Always: default: return _mm256_set1_epi32(-1);
+                }
+                return _mm256_castps_si256(m);
+            }
+
+            OGLW_TARGET_AVX2 inline __m256i channel(__m256 v) {
+                v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(255.f));
+                return _mm256_cvttps_epi32(_mm256_add_ps(v, _mm256_set1_ps(0.5f)));
+            }
+
+            template <class Format>
+            OGLW_TARGET_AVX2 inline void storeColor(std::uint32_t* dst, __m256i colors, __m256i mask, unsigned, std::true_type) {
+                _mm256_maskstore_epi32(reinterpret_cast<int*>(dst), mask, colors);
+            }
+
+            template <class Format>
+            OGLW_TARGET_AVX2 inline void storeColor(typename Format::Pixel* dst, __m256i colors, __m256i, unsigned bits, std::false_type) {
+                alignas(32) std::uint32_t c[8];
+                _mm256_store_si256(reinterpret_cast<__m256i*>(c), colors);
+                for (unsigned l = 0; l < 8; ++l) {
+                    if (bits >> l & 1)
+                        dst[l] = Format::fromRGBA8(c[l]);
+                }
+            }
+
+            template <DepthFormat F, class Format>
+            OGLW_TARGET_AVX2 void tile(Triangle const& t, Tile const& tile, RasterState const& state,
+                DepthStencilBuffer& depthStencil, BasicPixelSurface<Format>& target, RasterStats& stats) {
+                typedef DepthTraits<F> Depth;
+                typedef DepthLanes<F> Lanes;
+                const __m256i edgeLane0 = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(t.edgeLane[0]));
+                const __m256i edgeLane1 = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(t.edgeLane[1]));
+                const __m256i edgeLane2 = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(t.edgeLane[2]));
+                const __m256 zLane = _mm256_loadu_ps(t.planeLane[0]);
+                const __m256 one = _mm256_set1_ps(1.f), zero = _mm256_setzero_ps();
+                const bool writeDepth = state.depthTest && state.depthWrite;
+
+                for (unsigned r = 0; r < tile.rows; ++r) {
+                    const unsigned y = static_cast<unsigned>(tile.y) + r;
+                    __m256i mask = _mm256_set1_epi32(-1);
+                    if (tile.partial) {
+                        const __m256i e0 = _mm256_add_epi32(_mm256_set1_epi32(tile.edge[0] + t.edgeRow[0][r]), edgeLane0);
+                        const __m256i e1 = _mm256_add_epi32(_mm256_set1_epi32(tile.edge[1] + t.edgeRow[1][r]), edgeLane1);
+                        const __m256i e2 = _mm256_add_epi32(_mm256_set1_epi32(tile.edge[2] + t.edgeRow[2][r]), edgeLane2);
+                        mask = _mm256_cmpgt_epi32(_mm256_or_si256(_mm256_or_si256(e0, e1), e2), _mm256_set1_epi32(-1));
+                    }
+                    unsigned bits = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(mask)));
+                    if (!bits)
+                        continue;
+                    stats.pixelsCovered += bitCount(bits);
+
+                    typename Depth::Value* depth = Depth::row(depthStencil, y) + tile.x;
+                    __m256 z = _mm256_add_ps(_mm256_set1_ps(tile.plane[0] + t.planeRow[0][r]), zLane);
+                    z = Lanes::quantize(_mm256_min_ps(_mm256_max_ps(z, zero), one));
+                    if (state.depthTest) {
+                        mask = _mm256_and_si256(mask, compare(state.depthFunc, z, Lanes::load(depth)));
+                        bits = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(mask)));
+                        if (!bits)
+                            continue;
+                    }
+                    stats.pixelsWritten += bitCount(bits);
+                    if (writeDepth)
+                        Lanes::store(depth, z, mask);
+
+                    if (state.colorWrite) {
+                        __m256i colors;
+                        if (t.flat) {
+                            colors = _mm256_set1_epi32(static_cast<int>(t.color));
+                        }
+                        else {
+                            __m256i c[4];
+                            for (unsigned i = 0; i < 4; ++i)
+                                c[i] = channel(_mm256_add_ps(_mm256_set1_ps(tile.plane[i + 1] + t.planeRow[i + 1][r]), _mm256_loadu_ps(t.planeLane[i + 1])));
+                            colors = _mm256_or_si256(_mm256_or_si256(c[0], _mm256_slli_epi32(c[1], 8)),
+                                _mm256_or_si256(_mm256_slli_epi32(c[2], 16), _mm256_slli_epi32(c[3], 24)));
+                        }
+                        storeColor<Format>(target.row(y) + tile.x, colors, mask, bits, std::is_same<Format, RGBA8>());
+                    }
+                }
+            }
+        }
+#endif // OGLW_X86_SIMD
+    }
+
+    // Draws triangles into a pixel surface of the given format, with its own depth and
+    // stencil buffer that follows the surface's size. Not thread-safe; one per thread.
+    template <class Format>
+    class SoftwareRasterizer {
+        typedef BasicPixelSurface<Format> Surface;
+
+        // Clip-space vertex with the color as floats, for interpolating while clipping.
+        struct ClipVertex {
+            float x, y, z, w;
+            float color[4];
+        };
+
+        // The six frustum planes, and w > 0 so that nothing is divided by 0.
+        static const unsigned clipPlanes = 7;
+        static const unsigned maxClipVertices = 3 + clipPlanes;
+        static const int blockSize = 32, tileSize = 8;
+        static const std::int32_t insideEdge = 1 << 29;
+
+        DepthStencilBuffer m_DepthStencil;
+        kernels::Isa m_Isa;
+        RasterStats m_Stats;
+        int m_DirtyX0 = 0, m_DirtyY0 = 0, m_DirtyX1 = 0, m_DirtyY1 = 0;
+
+        static float distance(ClipVertex const& v, unsigned plane) {
+            switch (plane) {
+                case 0: return v.w - v.x;
+                case 1: return v.w + v.x;
+                case 2: return v.w - v.y;
+                case 3: return v.w + v.y;
+                case 4: return v.w - v.z;
+                case 5: return v.w + v.z;
+                default: return v.w - 1e-6f;
+            }
+        }
+
+        static unsigned outcode(ClipVertex const& v) {
+            unsigned code = 0;
+            for (unsigned p = 0; p < clipPlanes; ++p)
+                code |= (distance(v, p) < 0.f) << p;
+            return code;
+        }
+
+        static ClipVertex clipVertex(RasterVertex const& v) {
+            ClipVertex c = { v.x, v.y, v.z, v.w, { 0.f, 0.f, 0.f, 0.f } };
+            for (unsigned i = 0; i < 4; ++i)
+                c.color[i] = static_cast<float>(v.color >> (8 * i) & 255);
+            return c;
+        }
+
+        static ClipVertex lerp(ClipVertex const& a, ClipVertex const& b, float t) {
+            ClipVertex v;
+            v.x = a.x + (b.x - a.x) * t;
+            v.y = a.y + (b.y - a.y) * t;
+            v.z = a.z + (b.z - a.z) * t;
+            v.w = a.w + (b.w - a.w) * t;
+            for (unsigned i = 0; i < 4; ++i)
+                v.color[i] = a.color[i] + (b.color[i] - a.color[i]) * t;
+            return v;
+        }
+
+        // Sutherland-Hodgman against the planes in mask, then a fan of what's left.
+        void clipTriangle(Surface& target, ClipVertex const& a, ClipVertex const& b, ClipVertex const& c,
+            unsigned mask, RasterState const& state) {
+            ClipVertex buffers[2][maxClipVertices];
+            ClipVertex* in = buffers[0];
+            ClipVertex* out = buffers[1];
+            in[0] = a;
+            in[1] = b;
+            in[2] = c;
+            unsigned count = 3;
+            for (unsigned p = 0; p < clipPlanes && count >= 3; ++p) {
+                if (!(mask & (1u << p)))
+                    continue;
+                unsigned kept = 0;
+                for (unsigned i = 0; i < count; ++i) {
+                    ClipVertex const& v0 = in[i];
+                    ClipVertex const& v1 = in[(i + 1) % count];
+                    const float d0 = distance(v0, p), d1 = distance(v1, p);
+                    if (d0 >= 0.f)
+                        out[kept++] = v0;
+                    if ((d0 >= 0.f) != (d1 >= 0.f))
+                        out[kept++] = lerp(v0, v1, d0 / (d0 - d1));
+                }
+                std::swap(in, out);
+                count = kept;
+            }
+            for (unsigned i = 1; i + 1 < count; ++i)
+                rasterize(target, in[0], in[i], in[i + 1], state);
+        }
+
+        void drawTriangle(Surface& target, RasterVertex const& a, RasterVertex const& b, RasterVertex const& c,
+            RasterState const& state) {
+            ++m_Stats.triangles;
+            const ClipVertex v0 = clipVertex(a), v1 = clipVertex(b), v2 = clipVertex(c);
+            const unsigned c0 = outcode(v0), c1 = outcode(v1), c2 = outcode(v2);
+            if (c0 & c1 & c2) {
+                ++m_Stats.culled;
+                return;
+            }
+            if (c0 | c1 | c2) {
+                ++m_Stats.clipped;
+                clipTriangle(target, v0, v1, v2, c0 | c1 | c2, state);
+                return;
+            }
+            rasterize(target, v0, v1, v2, state);
+        }
+
+        // Snaps a clipped triangle to 1/16 pixels and sets up its edges and planes.
+        void rasterize(Surface& target, ClipVertex const& a, ClipVertex const& b, ClipVertex const& c,
+            RasterState const& state) {
+            const int width = static_cast<int>(target.width()), height = static_cast<int>(target.height());
+            ClipVertex const* v[3] = { &a, &b, &c };
+            std::int64_t sx[3], sy[3];
+            double z[3];
+            for (unsigned i = 0; i < 3; ++i) {
+                const double w = 1.0 / v[i]->w;
+                const double x = (v[i]->x * w * 0.5 + 0.5) * width;
+                const double y = (0.5 - v[i]->y * w * 0.5) * height;
+                sx[i] = std::min(std::max(static_cast<std::int64_t>(std::floor(x * 16 + 0.5)), std::int64_t(0)), std::int64_t(width) * 16);
+                sy[i] = std::min(std::max(static_cast<std::int64_t>(std::floor(y * 16 + 0.5)), std::int64_t(0)), std::int64_t(height) * 16);
+                z[i] = v[i]->z * w * 0.5 + 0.5;
+            }
+
+            // Counterclockwise in clip space is clockwise here, with y down: negative area.
+            std::int64_t area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+            const bool front = area < 0;
+            if (area == 0 || (state.cull == CullMode::Back && !front) || (state.cull == CullMode::Front && front)) {
+                ++m_Stats.culled;
+                return;
+            }
+            unsigned order[3] = { 0, 1, 2 };
+            if (area < 0) {
+                std::swap(order[1], order[2]);
+                area = -area;
+            }
+            std::int64_t x[3], y[3];
+            for (unsigned i = 0; i < 3; ++i) {
+                x[i] = sx[order[i]];
+                y[i] = sy[order[i]];
+            }
+
+            // Pixels whose centers are in the bounding box.
+            const std::int64_t minX = std::min(std::min(x[0], x[1]), x[2]), maxX = std::max(std::max(x[0], x[1]), x[2]);
+            const std::int64_t minY = std::min(std::min(y[0], y[1]), y[2]), maxY = std::max(std::max(y[0], y[1]), y[2]);
+            const int px0 = static_cast<int>((minX + 7) >> 4), px1 = std::min(static_cast<int>((maxX - 8) >> 4), width - 1);
+            const int py0 = static_cast<int>((minY + 7) >> 4), py1 = std::min(static_cast<int>((maxY - 8) >> 4), height - 1);
+            if (px0 > px1 || py0 > py1) {
+                ++m_Stats.culled;
+                return;
+            }
+            ++m_Stats.rasterized;
+
+            raster::Triangle t;
+            for (unsigned e = 0; e < 3; ++e) {
+                // Edge from vertex e + 1 to vertex e + 2, i.e. opposite vertex e; the
+                // interior is on its positive side. Top and left edges include their pixels.
+                const unsigned i = (e + 1) % 3, j = (e + 2) % 3;
+                t.a[e] = y[i] - y[j];
+                t.b[e] = x[j] - x[i];
+                t.c[e] = -(t.a[e] * x[i] + t.b[e] * y[i]);
+                if (!(t.a[e] > 0 || (t.a[e] == 0 && t.b[e] > 0)))
+                    t.c[e] -= 1;
+                for (int l = 0; l < 8; ++l) {
+                    t.edgeLane[e][l] = static_cast<std::int32_t>(t.a[e] * 16 * l);
+                    t.edgeRow[e][l] = static_cast<std::int32_t>(t.b[e] * 16 * l);
+                }
+            }
+
+            // Planes through the snapped vertices, in pixels.
+            double attributes[raster::planeCount][3];
+            for (unsigned i = 0; i < 3; ++i) {
+                ClipVertex const& vertex = *v[order[i]];
+                attributes[0][i] = z[order[i]];
+                for (unsigned k = 0; k < 4; ++k)
+                    attributes[k + 1][i] = vertex.color[k];
+            }
+            const double x10 = (x[1] - x[0]) / 16.0, y10 = (y[1] - y[0]) / 16.0;
+            const double x20 = (x[2] - x[0]) / 16.0, y20 = (y[2] - y[0]) / 16.0;
+            const double areaPixels = area / 256.0;
+            for (unsigned k = 0; k < raster::planeCount; ++k) {
+                const double d10 = attributes[k][1] - attributes[k][0], d20 = attributes[k][2] - attributes[k][0];
+                t.planeDx[k] = (d10 * y20 - d20 * y10) / areaPixels;
+                t.planeDy[k] = (d20 * x10 - d10 * x20) / areaPixels;
+                t.plane0[k] = attributes[k][0] - t.planeDx[k] * (x[0] / 16.0 - 0.5) - t.planeDy[k] * (y[0] / 16.0 - 0.5);
+                for (int l = 0; l < 8; ++l) {
+                    t.planeLane[k][l] = static_cast<float>(t.planeDx[k] * l);
+                    t.planeRow[k][l] = static_cast<float>(t.planeDy[k] * l);
+                }
+            }
+            t.flat = a.color[0] == b.color[0] && a.color[0] == c.color[0] && a.color[1] == b.color[1] && a.color[1] == c.color[1]
+                && a.color[2] == b.color[2] && a.color[2] == c.color[2] && a.color[3] == b.color[3] && a.color[3] == c.color[3];
+            if (t.flat) {
+                t.color = 0;
+                for (unsigned k = 0; k < 4; ++k)
+                    t.color |= raster::channel(a.color[k]) << (8 * k);
+            }
+
+            switch (m_DepthStencil.format()) {
+                case DepthFormat::D16: drawTiles<DepthFormat::D16>(target, t, px0, py0, px1, py1, state); break;
+                case DepthFormat::D24: drawTiles<DepthFormat::D24>(target, t, px0, py0, px1, py1, state); break;
+                case DepthFormat::D32F: drawTiles<DepthFormat::D32F>(target, t, px0, py0, px1, py1, state); break;
+            }
+
+            if (m_DirtyX0 >= m_DirtyX1) {
+                m_DirtyX0 = px0; m_DirtyY0 = py0; m_DirtyX1 = px1 + 1; m_DirtyY1 = py1 + 1;
+            }
+            else {
+                m_DirtyX0 = std::min(m_DirtyX0, px0);
+                m_DirtyY0 = std::min(m_DirtyY0, py0);
+                m_DirtyX1 = std::max(m_DirtyX1, px1 + 1);
+                m_DirtyY1 = std::max(m_DirtyY1, py1 + 1);
+            }
+        }
+
+        // Edge e's range over the pixel centers of a size x size square at (x, y): -1 if
+        // the square is outside, 1 if inside, 0 if the edge crosses it.
+        static int classify(raster::Triangle const& t, unsigned e, int x, int y, int size, std::int64_t& atOrigin) {
+            atOrigin = t.a[e] * (x * 16 + 8) + t.b[e] * (y * 16 + 8) + t.c[e];
+            const std::int64_t spanX = t.a[e] * 16 * (size - 1), spanY = t.b[e] * 16 * (size - 1);
+            const std::int64_t low = atOrigin + std::min(spanX, std::int64_t(0)) + std::min(spanY, std::int64_t(0));
+            const std::int64_t high = atOrigin + std::max(spanX, std::int64_t(0)) + std::max(spanY, std::int64_t(0));
+            return high < 0 ? -1 : low >= 0 ? 1 : 0;
+        }
+
+        template <DepthFormat F>
+        void drawTiles(Surface& target, raster::Triangle const& t, int px0, int py0, int px1, int py1, RasterState const& state) {
+            const int height = static_cast<int>(target.height());
+            for (int by = py0 & ~(blockSize - 1); by <= py1; by += blockSize) {
+                for (int bx = px0 & ~(blockSize - 1); bx <= px1; bx += blockSize) {
+                    std::int64_t origin;
+                    int inside = 0;
+                    bool outside = false;
+                    for (unsigned e = 0; e < 3 && !outside; ++e) {
+                        const int c = classify(t, e, bx, by, blockSize, origin);
+                        outside = c < 0;
+                        inside += c > 0;
+                    }
+                    if (outside) {
+                        ++m_Stats.blocksRejected;
+                        continue;
+                    }
+
+                    const int tx0 = std::max(bx, px0 & ~(tileSize - 1)), tx1 = std::min(bx + blockSize - 1, px1);
+                    const int ty0 = std::max(by, py0 & ~(tileSize - 1)), ty1 = std::min(by + blockSize - 1, py1);
+                    for (int ty = ty0; ty <= ty1; ty += tileSize) {
+                        for (int tx = tx0; tx <= tx1; tx += tileSize) {
+                            raster::Tile tile;
+                            tile.x = tx;
+                            tile.y = ty;
+                            tile.rows = static_cast<unsigned>(std::min(tileSize, height - ty));
+                            tile.partial = false;
+                            tile.edge[0] = tile.edge[1] = tile.edge[2] = insideEdge;
+                            if (inside < 3) {
+                                bool rejected = false;
+                                for (unsigned e = 0; e < 3 && !rejected; ++e) {
+                                    const int c = classify(t, e, tx, ty, tileSize, origin);
+                                    rejected = c < 0;
+                                    tile.partial = tile.partial || c == 0;
+                                    // A crossing edge is within its range over the tile, which fits
+                                    // in 32 bits; one the tile is inside of just has to stay positive.
+                                    tile.edge[e] = c == 0 ? static_cast<std::int32_t>(origin) : insideEdge;
+                                }
+                                if (rejected) {
+                                    ++m_Stats.tilesRejected;
+                                    continue;
+                                }
+                            }
+                            ++(tile.partial ? m_Stats.tilesPartial : m_Stats.tilesCovered);
+                            for (unsigned k = 0; k < raster::planeCount; ++k)
+                                tile.plane[k] = static_cast<float>(t.plane0[k] + t.planeDx[k] * tx + t.planeDy[k] * ty);
+                            drawTile<F>(target, t, tile, state);
+                        }
+                    }
+                }
+            }
+        }
+
+        template <DepthFormat F>
+        void drawTile(Surface& target, raster::Triangle const& t, raster::Tile const& tile, RasterState const& state) {
+#ifdef OGLW_X86_SIMD
+            if (m_Isa == kernels::Isa::AVX2 && !(state.stencilTest && m_DepthStencil.hasStencil())) {
+                raster::avx2::tile<F>(t, tile, state, m_DepthStencil, target, m_Stats);
+                return;
+            }
+#endif
+            raster::tileScalar<F>(t, tile, state, m_DepthStencil, target, m_Stats);
+        }
+
+        void begin(Surface& target) {
+            m_DepthStencil.resize(target.width(), target.height());
+            m_DirtyX0 = m_DirtyX1 = 0;
+        }
+
+        void end(Surface& target) {
+            if (m_DirtyX0 < m_DirtyX1)
+                target.markDirty(m_DirtyX0, m_DirtyY0, m_DirtyX1 - m_DirtyX0, m_DirtyY1 - m_DirtyY0);
+        }
+
+    public:
+        explicit SoftwareRasterizer(DepthFormat depth = DepthFormat::D24, bool stencil = true)
+            : m_DepthStencil(depth, stencil)
+            , m_Isa(kernels::active().isa)
+        { }
+
+        DepthStencilBuffer& depthStencil() { return m_DepthStencil; }
+        DepthStencilBuffer const& depthStencil() const { return m_DepthStencil; }
+
+        // AVX2 tiles if isa is AVX2 and the CPU has it, scalar ones otherwise; by default
+        // whatever kernels::active() picked.
+        void setIsa(kernels::Isa isa) {
+            m_Isa = isa == kernels::Isa::AVX2 && kernels::isaSupported(isa) ? isa : kernels::Isa::Scalar;
+        }
+        kernels::Isa isa() const { return m_Isa; }
+
+        // Clears depth and stencil, sized to target first.
+        void clear(Surface const& target, float depth = 1.f, std::uint8_t stencil = 0) {
+            m_DepthStencil.resize(target.width(), target.height());
+            m_DepthStencil.clear(depth, stencil);
+        }
+
+        // Triangles from consecutive vertices; count is the number of vertices.
+        void drawTriangles(Surface& target, RasterVertex const* vertices, std::size_t count,
+            RasterState const& state = RasterState()) {
+            begin(target);
+            for (std::size_t i = 0; i + 3 <= count; i += 3)
+                drawTriangle(target, vertices[i], vertices[i + 1], vertices[i + 2], state);
+            end(target);
+        }
+
+        // Triangles from every three indices into vertices.
+        void drawIndexed(Surface& target, RasterVertex const* vertices, std::uint32_t const* indices, std::size_t count,
+            RasterState const& state = RasterState()) {
+            begin(target);
+            for (std::size_t i = 0; i + 3 <= count; i += 3)
+                drawTriangle(target, vertices[indices[i]], vertices[indices[i + 1]], vertices[indices[i + 2]], state);
+            end(target);
+        }
+
+        RasterStats const& stats() const { return m_Stats; }
+        void resetStats() { m_Stats = RasterStats(); }
+    };
+}
@@ -0,0 +1,312 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+
+#ifdef _WIN32
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "FrameTiming.hpp"
+
+// Frames published into a named shared memory segment (POSIX shm_open, or a named file
+// mapping on Windows) for another process to read in place. The segment holds a header
+// and three RGBA8 frame slots used as a triple buffer: the producer owns one slot, the
+// consumer another, and the third is the latest complete frame. Either side swaps its
+// slot with the latest one in a single atomic exchange, so neither ever waits for the
+// other and the consumer never sees a frame being written. One consumer at a time.
+namespace oglw {
+
+    static_assert(ATOMIC_INT_LOCK_FREE == 2, "shared frames need lock-free atomics to work across processes");
+
+    struct SharedFrameSlot {
+        std::uint64_t frame;        // producer's count of published frames
+        std::uint64_t timeNs;       // clockNs() of the producer when published
+        std::uint32_t bottomUp;     // rows stored bottom to top (GL readback)
+        std::uint32_t pad;
+    };
+
+    struct SharedFrameHeader {
+        static const unsigned slotCount = 3;
+        static const std::uint32_t freshBit = 4;        // in latest: not yet taken by the consumer
+
+        char magic[8];                          // "OGLWSHM1"
+        std::uint32_t width, height;
+        std::uint32_t pitch;                    // bytes between rows
+        std::uint32_t slots;
+        std::uint64_t slotBytes;                // distance between slots
+        std::uint64_t dataOffset;               // of slot 0 from the start of the segment
+        std::atomic<std::uint32_t> ready;       // set once the producer has filled in the above
+        std::atomic<std::uint32_t> latest;      // slot index | freshBit
+        std::atomic<std::uint32_t> front;       // consumer's slot, kept here for the next consumer
+        std::uint32_t pad;
+        SharedFrameSlot slot[slotCount];        // each belongs to whoever owns the slot
+    };
+
+    // A named read-write shared memory segment.
+    class SharedMemory {
+        std::uint8_t* m_Data = nullptr;
+        std::size_t m_Size = 0;
+        std::string m_Name;
+        bool m_Owner = false;
+#ifdef _WIN32
+        HANDLE m_Mapping = NULL;
+#endif
+
+        static std::string systemName(std::string const& name) {
+#ifdef _WIN32
+            return name;
+#else
+            return name.empty() || name[0] != '/' ? "/" + name : name;
+#endif
+        }
+
+    public:
+        // Creates the segment, replacing any stale one of the same name; zero-filled.
+        bool create(std::string const& name, std::size_t size) {
+            close();
+            m_Name = systemName(name);
+#ifdef _WIN32
+            m_Mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                static_cast<DWORD>(static_cast<std::uint64_t>(size) >> 32), static_cast<DWORD>(size), m_Name.c_str());
+            if (!m_Mapping)
+                return false;
+            m_Data = static_cast<std::uint8_t*>(MapViewOfFile(m_Mapping, FILE_MAP_ALL_ACCESS, 0, 0, size));
+#else
+            shm_unlink(m_Name.c_str());
+            const int fd = shm_open(m_Name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+            if (fd < 0)
+                return false;
+            m_Owner = true;
+            if (ftruncate(fd, static_cast<off_t>(size)) == 0) {
+                void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (p != MAP_FAILED)
+                    m_Data = static_cast<std::uint8_t*>(p);
+            }
+            ::close(fd);
+#endif
+            m_Size = size;
+            if (!m_Data) {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        // Maps an existing segment whole.
+        bool open(std::string const& name) {
+            close();
+            m_Name = systemName(name);
+#ifdef _WIN32
+            m_Mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, m_Name.c_str());
+            if (!m_Mapping)
+                return false;
+            m_Data = static_cast<std::uint8_t*>(MapViewOfFile(m_Mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+            MEMORY_BASIC_INFORMATION info;
+            if (m_Data && VirtualQuery(m_Data, &info, sizeof(info)))
+                m_Size = info.RegionSize;
+#else
+            const int fd = shm_open(m_Name.c_str(), O_RDWR, 0);
+            if (fd < 0)
+                return false;
+            struct stat st;
+            if (fstat(fd, &st) == 0 && st.st_size > 0) {
+                void* p = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (p != MAP_FAILED) {
+                    m_Data = static_cast<std::uint8_t*>(p);
+                    m_Size = static_cast<std::size_t>(st.st_size);
+                }
+            }
+            ::close(fd);
+#endif
+            if (!m_Data) {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        // Unmaps; the creator also removes the name (open mappings stay valid).
+        void close() {
+#ifdef _WIN32
+            if (m_Data)
+                UnmapViewOfFile(m_Data);
+            if (m_Mapping)
+                CloseHandle(m_Mapping);
+            m_Mapping = NULL;
+#else
+            if (m_Data)
+                munmap(m_Data, m_Size);
+            if (m_Owner)
+                shm_unlink(m_Name.c_str());
+#endif
+            m_Data = nullptr;
+            m_Size = 0;
+            m_Owner = false;
+        }
+
+        std::uint8_t* data() const { return m_Data; }
+        std::size_t size() const { return m_Size; }
+
+        SharedMemory() = default;
+        SharedMemory(SharedMemory const&) = delete;
+        SharedMemory& operator=(SharedMemory const&) = delete;
+        ~SharedMemory() { close(); }
+    };
+
+    struct SharedFrameStats {
+        unsigned long long published = 0;
+        unsigned long long dropped = 0;     // frames of another size than the segment's
+    };
+
+    // Producer side, e.g. the window's render thread.
+    class SharedFrameWriter {
+        SharedMemory m_Memory;
+        SharedFrameHeader* m_Header = nullptr;
+        std::uint32_t m_Back = 0;
+        SharedFrameStats m_Stats;
+
+    public:
+        bool create(std::string const& name, unsigned width, unsigned height) {
+            const std::size_t page = 4096;
+            const std::size_t pitch = static_cast<std::size_t>(width) * 4;
+            const std::size_t slotBytes = (pitch * height + page - 1) / page * page;
+            const std::size_t dataOffset = (sizeof(SharedFrameHeader) + page - 1) / page * page;
+            if (!m_Memory.create(name, dataOffset + SharedFrameHeader::slotCount * slotBytes))
+                return false;
+
+            m_Header = new (m_Memory.data()) SharedFrameHeader;
+            std::memcpy(m_Header->magic, "OGLWSHM1", 8);
+            m_Header->width = width;
+            m_Header->height = height;
+            m_Header->pitch = static_cast<std::uint32_t>(pitch);
+            m_Header->slots = SharedFrameHeader::slotCount;
+            m_Header->slotBytes = slotBytes;
+            m_Header->dataOffset = dataOffset;
+            std::memset(m_Header->slot, 0, sizeof(m_Header->slot));
+            m_Back = 0;
+            m_Header->latest.store(1, std::memory_order_relaxed);
+            m_Header->front.store(2, std::memory_order_relaxed);
+            m_Header->ready.store(1, std::memory_order_release);
+            m_Stats = SharedFrameStats();
+            return true;
+        }
+
+        void close() {
+            m_Memory.close();
+            m_Header = nullptr;
+        }
+
+        bool isOpen() const { return m_Header != nullptr; }
+        unsigned width() const { return m_Header->width; }
+        unsigned height() const { return m_Header->height; }
+        std::size_t pitch() const { return m_Header->pitch; }
+
+        // Where the next frame goes, top row first unless published as bottomUp;
+        // write it there (e.g. with glReadPixels), then publish().
+        std::uint8_t* back() { return m_Memory.data() + m_Header->dataOffset + m_Back * m_Header->slotBytes; }
+
+        void publish(bool bottomUp = false) {
+            SharedFrameSlot& s = m_Header->slot[m_Back];
+            s.frame = ++m_Stats.published;
+            s.timeNs = clockNs();
+            s.bottomUp = bottomUp;
+            m_Back = m_Header->latest.exchange(m_Back | SharedFrameHeader::freshBit, std::memory_order_acq_rel) & 3;
+        }
+
+        // Copies a width*height RGBA8 image (rows pitch pixels apart) into the back slot and publishes it.
+        void write(std::uint32_t const* pixels, std::size_t pitch, bool bottomUp = false) {
+            std::uint8_t* dst = back();
+            const std::size_t rowBytes = m_Header->pitch;
+            if (pitch * 4 == rowBytes) {
+                std::memcpy(dst, pixels, rowBytes * m_Header->height);
+            }
+            else {
+                for (unsigned y = 0; y < m_Header->height; ++y)
+                    std::memcpy(dst + y * rowBytes, pixels + y * pitch, rowBytes);
+            }
+            publish(bottomUp);
+        }
+
+        void dropFrame() { ++m_Stats.dropped; }
+        SharedFrameStats const& stats() const { return m_Stats; }
+
+        SharedFrameWriter() = default;
+        SharedFrameWriter(SharedFrameWriter const&) = delete;
+        SharedFrameWriter& operator=(SharedFrameWriter const&) = delete;
+    };
+
+    // Consumer side, usually in another process. The held frame stays valid and unchanged
+    // until the next acquireLatest() that returns true.
+    class SharedFrameReader {
+        SharedMemory m_Memory;
+        SharedFrameHeader* m_Header = nullptr;
+        std::uint32_t m_Front = 0;
+        bool m_Holding = false;
+
+    public:
+        // False if there's no such segment or its producer hasn't finished setting it up.
+        bool open(std::string const& name) {
+            close();
+            if (!m_Memory.open(name) || m_Memory.size() < sizeof(SharedFrameHeader))
+                return false;
+            SharedFrameHeader* header = reinterpret_cast<SharedFrameHeader*>(m_Memory.data());
+            if (header->ready.load(std::memory_order_acquire) != 1 || std::memcmp(header->magic, "OGLWSHM1", 8) != 0
+                || m_Memory.size() < header->dataOffset + header->slots * header->slotBytes) {
+                m_Memory.close();
+                return false;
+            }
+            m_Header = header;
+            m_Front = m_Header->front.load(std::memory_order_relaxed) & 3;
+            return true;
+        }
+
+        void close() {
+            m_Memory.close();
+            m_Header = nullptr;
+            m_Holding = false;
+        }
+
+        // Takes the newest complete frame if one was published since the last call.
+        bool acquireLatest() {
+            if (!(m_Header->latest.load(std::memory_order_acquire) & SharedFrameHeader::freshBit))
+                return false;
+            m_Front = m_Header->latest.exchange(m_Front, std::memory_order_acq_rel) & 3;
+            m_Header->front.store(m_Front, std::memory_order_relaxed);
+            m_Holding = true;
+            return true;
+        }
+
+        bool holding() const { return m_Holding; }
+        unsigned width() const { return m_Header->width; }
+        unsigned height() const { return m_Header->height; }
+        std::size_t pitch() const { return m_Header->pitch; }
+        std::uint64_t frame() const { return m_Header->slot[m_Front].frame; }
+        std::uint64_t timeNs() const { return m_Header->slot[m_Front].timeNs; }
+        bool bottomUp() const { return m_Header->slot[m_Front].bottomUp != 0; }
+
+        const std::uint8_t* data() const { return m_Memory.data() + m_Header->dataOffset + m_Front * m_Header->slotBytes; }
+
+        // Row y counted from the top, whichever way the frame is stored.
+        std::uint32_t const* row(unsigned y) const {
+            const unsigned stored = bottomUp() ? m_Header->height - 1 - y : y;
+            return reinterpret_cast<std::uint32_t const*>(data() + static_cast<std::size_t>(stored) * m_Header->pitch);
+        }
+
+        SharedFrameReader() = default;
+        SharedFrameReader(SharedFrameReader const&) = delete;
+        SharedFrameReader& operator=(SharedFrameReader const&) = delete;
+    };
+}
@@ -0,0 +1,386 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "PixelSurface.hpp"
+
+// Many small textured quads per frame, drawn in as few batches as possible. Quads are
+// written straight into a vertex stream whose storage is kept from frame to frame;
+// before drawing they are ordered by layer and texture (keeping submission order
+// otherwise), and each run of quads with the same texture becomes one draw. The WinAPI
+// window draws the runs with GL, the headless one rasterizes them into its pixel surface
+// with SoftwareSpriteRenderer.
+namespace oglw {
+
+    // Index of a texture added to a SpriteBatch; 0 is no texture, i.e. the quad is its color.
+    typedef std::uint32_t SpriteTexture;
+
+    // Corner of a quad as streamed to GL: position in window pixels (y down), texture
+    // coordinates in [0, 1] across the texture, and an RGBA8 color multiplied with the texel.
+    struct SpriteVertex {
+        float x, y;
+        float u, v;
+        std::uint32_t color;
+    };
+
+    // Quads sharing a texture, drawn together: quads first to first + count - 1 of drawOrder().
+    struct SpriteRun {
+        SpriteTexture texture;
+        std::uint32_t first, count;
+    };
+
+    struct SpriteStats {
+        unsigned long long frames = 0;
+        unsigned long long quads = 0;
+        unsigned long long draws = 0;
+        unsigned lastQuads = 0;
+        unsigned lastDraws = 0;
+
+        double quadsPerDraw() const { return draws ? double(quads) / draws : 0; }
+    };
+
+    class SpriteBatch {
+    public:
+        enum class SortMode {
+            Texture,        // by layer, then texture; fewest draws
+            Submission,     // as drawn; only neighbours with the same texture share a draw
+        };
+
+        static const unsigned maxTextures = 0xFFFF;
+        static const unsigned maxLayers = 0x10000;
+
+        struct Texture {
+            PixelSurface image;     // RGBA8
+            unsigned version;       // bumped by updateTexture(), for renderers that keep a copy
+        };
+
+    private:
+        std::vector<Texture> m_Textures;            // SpriteTexture n is m_Textures[n - 1]
+        std::vector<SpriteVertex> m_Vertices;       // four per quad: top left, top right, bottom right, bottom left
+        std::vector<std::uint64_t> m_Keys;          // layer << 48 | texture << 32 | quad, per quad
+        std::vector<std::uint32_t> m_Order;         // quads in drawing order
+        std::vector<std::uint32_t> m_Indices;       // their vertices, for glDrawElements
+        std::vector<SpriteRun> m_Runs;
+        std::vector<std::uint64_t> m_Sorted;        // keys sorted, when there are too many buckets
+        std::vector<std::uint32_t> m_Buckets;       // quads per (layer, texture), then where they start
+        SortMode m_SortMode = SortMode::Texture;
+        unsigned m_Layer = 0;
+        bool m_Prepared = false;
+        SpriteStats m_Stats;
+
+        // Stable counting sort of the quads by (layer, texture) into m_Order, used when there
+        // are no more buckets than quads; a few textures and layers are the common case.
+        bool bucketSort() {
+            if (m_Keys.empty())
+                return true;
+            std::uint64_t minKey = ~std::uint64_t(0), maxKey = 0;
+            for (std::uint64_t key : m_Keys) {
+                minKey = std::min(minKey, key);
+                maxKey = std::max(maxKey, key);
+            }
+            const std::size_t textures = m_Textures.size() + 1;
+            const std::size_t minLayer = static_cast<std::size_t>(minKey >> 48);
+            const std::size_t layers = static_cast<std::size_t>(maxKey >> 48) - minLayer + 1;
+            if (layers * textures > std::max<std::size_t>(m_Keys.size(), 256))
+                return false;
+
+            m_Buckets.assign(layers * textures, 0);
+            for (std::uint64_t key : m_Keys)
+                ++m_Buckets[((key >> 48) - minLayer) * textures + (key >> 32 & 0xFFFF)];
+            std::uint32_t start = 0;
+            for (std::uint32_t& bucket : m_Buckets) {
+                const std::uint32_t n = bucket;
+                bucket = start;
+                start += n;
+            }
+            const std::uint32_t count = static_cast<std::uint32_t>(m_Keys.size());
+            for (std::uint32_t quad = 0; quad < count; ++quad) {
+                const std::uint64_t key = m_Keys[quad];
+                m_Order[m_Buckets[((key >> 48) - minLayer) * textures + (key >> 32 & 0xFFFF)]++] = quad;
+            }
+            return true;
+        }
+
+    public:
+        // Copies a width*height RGBA8 image (rows pitch pixels apart).
+        SpriteTexture addTexture(std::uint32_t const* pixels, unsigned width, unsigned height, unsigned pitch) {
+            if (m_Textures.size() >= maxTextures)
+                return 0;
+            m_Textures.push_back(Texture());
+            updateTexture(static_cast<SpriteTexture>(m_Textures.size()), pixels, width, height, pitch);
+            return static_cast<SpriteTexture>(m_Textures.size());
+        }
+
+        SpriteTexture addTexture(PixelSurface const& image) {
+            return addTexture(image.data(), image.width(), image.height(), image.pitch());
+        }
+
+        void updateTexture(SpriteTexture texture, std::uint32_t const* pixels, unsigned width, unsigned height, unsigned pitch) {
+            Texture& t = m_Textures[texture - 1];
+            t.image.resize(width, height);
+            for (unsigned y = 0; y < height; ++y)
+                std::copy(pixels + static_cast<std::size_t>(y) * pitch, pixels + static_cast<std::size_t>(y) * pitch + width, t.image.row(y));
+            ++t.version;
+        }
+
+        std::size_t textureCount() const { return m_Textures.size(); }
+        Texture const& texture(SpriteTexture texture) const { return m_Textures[texture - 1]; }
+
+        // Quads drawn after this go under those of higher layers, whatever their texture.
+        void setLayer(unsigned layer) { m_Layer = std::min(layer, maxLayers - 1); }
+        unsigned layer() const { return m_Layer; }
+
+        void setSortMode(SortMode mode) { m_SortMode = mode; }
+
+        // Part (u0, v0)-(u1, v1) of the texture, scaled to width x height at (x, y).
+        void draw(SpriteTexture texture, float x, float y, float width, float height,
+            float u0, float v0, float u1, float v1, std::uint32_t color = 0xFFFFFFFFu) {
+            const std::uint32_t quad = static_cast<std::uint32_t>(m_Keys.size());
+            m_Keys.push_back(std::uint64_t(m_Layer) << 48 | std::uint64_t(texture) << 32 | quad);
+            const float x1 = x + width, y1 = y + height;
+            m_Vertices.push_back(SpriteVertex { x, y, u0, v0, color });
+            m_Vertices.push_back(SpriteVertex { x1, y, u1, v0, color });
+            m_Vertices.push_back(SpriteVertex { x1, y1, u1, v1, color });
+            m_Vertices.push_back(SpriteVertex { x, y1, u0, v1, color });
+            m_Prepared = false;
+        }
+
+        // The whole texture.
+        void draw(SpriteTexture texture, float x, float y, float width, float height, std::uint32_t color = 0xFFFFFFFFu) {
+            draw(texture, x, y, width, height, 0.f, 0.f, 1.f, 1.f, color);
+        }
+
+        // The whole texture at its own size.
+        void draw(SpriteTexture texture, float x, float y, std::uint32_t color = 0xFFFFFFFFu) {
+            PixelSurface const& image = m_Textures[texture - 1].image;
+            draw(texture, x, y, float(image.width()), float(image.height()), 0.f, 0.f, 1.f, 1.f, color);
+        }
+
+        // A rectangle of color, alpha-blended.
+        void fill(float x, float y, float width, float height, std::uint32_t color) {
+            draw(0, x, y, width, height, 0.f, 0.f, 0.f, 0.f, color);
+        }
+
+        std::size_t size() const { return m_Keys.size(); }
+        bool empty() const { return m_Keys.empty(); }
+
+        // Puts the quads in drawing order and splits them into runs; for renderers.
+        void prepare() {
+            if (m_Prepared)
+                return;
+            const std::uint32_t count = static_cast<std::uint32_t>(m_Keys.size());
+            m_Order.resize(count);
+            if (m_SortMode == SortMode::Submission) {
+                for (std::uint32_t i = 0; i < count; ++i)
+                    m_Order[i] = i;
+            }
+            else if (!bucketSort()) {
+                m_Sorted.assign(m_Keys.begin(), m_Keys.end());
+                std::sort(m_Sorted.begin(), m_Sorted.end());
+                for (std::uint32_t i = 0; i < count; ++i)
+                    m_Order[i] = static_cast<std::uint32_t>(m_Sorted[i]);
+            }
+
+            m_Indices.resize(std::size_t(count) * 4);
+            m_Runs.clear();
+            for (std::uint32_t i = 0; i < count; ++i) {
+                const std::uint32_t quad = m_Order[i];
+                const SpriteTexture texture = static_cast<SpriteTexture>(m_Keys[quad] >> 32 & 0xFFFF);
+                for (unsigned c = 0; c < 4; ++c)
+                    m_Indices[std::size_t(i) * 4 + c] = quad * 4 + c;
+                if (m_Runs.empty() || m_Runs.back().texture != texture)
+                    m_Runs.push_back(SpriteRun { texture, i, 0 });
+                ++m_Runs.back().count;
+            }
+            m_Prepared = true;
+        }
+
+        std::vector<SpriteVertex> const& vertices() const { return m_Vertices; }
+        std::vector<std::uint32_t> const& drawOrder() const { return m_Order; }
+        std::vector<std::uint32_t> const& indices() const { return m_Indices; }
+        std::vector<SpriteRun> const& runs() const { return m_Runs; }
+
+        // Called by the window once the quads are drawn; keeps all storage for the next frame.
+        void finishFrame() {
+            prepare();
+            ++m_Stats.frames;
+            m_Stats.lastQuads = static_cast<unsigned>(m_Keys.size());
+            m_Stats.lastDraws = static_cast<unsigned>(m_Runs.size());
+            m_Stats.quads += m_Stats.lastQuads;
+            m_Stats.draws += m_Stats.lastDraws;
+            clear();
+        }
+
+        // Drops the quads drawn so far; textures stay.
+        void clear() {
+            m_Keys.clear();
+            m_Vertices.clear();
+            m_Runs.clear();
+            m_Layer = 0;
+            m_Prepared = false;
+        }
+
+        SpriteStats const& stats() const { return m_Stats; }
+        void resetStats() { m_Stats = SpriteStats(); }
+    };
+
+    // Rasterizes a SpriteBatch into a pixel surface: nearest texel sampling, modulated by
+    // the quad's color and blended over the surface. A pixel is covered if its center is
+    // inside the quad. Spans go through the surface format's SIMD kernels where there are
+    // some: opaque color quads are fills, and textures drawn at their own size and color
+    // are blended straight from the texture's rows. Texel coordinates are stepped in 16.16
+    // fixed point and only clamped for quads that sample past the texture's edges.
+    template <class Format>
+    class SoftwareSpriteRenderer {
+        typedef BasicPixelSurface<Format> Surface;
+        typedef typename Surface::Pixel Pixel;
+        typedef void (*BlendSpan)(Pixel* dst, std::uint32_t const* src, std::size_t count);
+
+        std::vector<std::uint32_t> m_Span;      // RGBA8 source of the span being blended
+        BlendSpan m_Blend = nullptr;
+        static const std::uint32_t prefetchDistance = 8;     // quads ahead
+
+        static void blendConverted(Pixel* dst, std::uint32_t const* src, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i)
+                dst[i] = Format::fromRGBA8(kernels::scalar::blendPixel(Format::toRGBA8(dst[i]), src[i]));
+        }
+
+        static BlendSpan blendFunction(std::true_type) { return kernels::active().blend; }
+        static BlendSpan blendFunction(std::false_type) { return &blendConverted; }
+
+        // First pixel whose center is at or right of edge, i.e. ceil(edge - 0.5).
+        static int firstCovered(float edge) {
+            const float e = edge - 0.5f;
+            const int i = static_cast<int>(e);
+            return i + (static_cast<float>(i) < e);
+        }
+
+        static std::int64_t fixed(float value) { return static_cast<std::int64_t>(value * 65536.f); }
+
+        // Sorted by texture, quads are visited all over the vertex stream.
+        static void prefetch(void const* p) {
+#if defined(__GNUC__) || defined(__clang__)
+            __builtin_prefetch(p);
+#elif defined(OGLW_X86_SIMD)
+            _mm_prefetch(static_cast<char const*>(p), _MM_HINT_T0);
+#else
+            (void) p;
+#endif
+        }
+
+        // Pixels x0..x1-1 of rows y0..y1-1 covered by a textured quad with corners a and b.
+        void texturedQuad(Surface& target, PixelSurface const& image,
+            SpriteVertex const& a, SpriteVertex const& b, int x0, int x1, int y0, int y1) {
+            const int texW = static_cast<int>(image.width()), texH = static_cast<int>(image.height());
+            const std::size_t count = static_cast<std::size_t>(x1 - x0);
+            const float dudx = (b.u - a.u) * texW / (b.x - a.x);
+            const float dvdy = (b.v - a.v) * texH / (b.y - a.y);
+            const std::int64_t uStart = fixed(a.u * texW + (x0 + 0.5f - a.x) * dudx), uStep = fixed(dudx);
+            const std::int64_t vStart = fixed(a.v * texH + (y0 + 0.5f - a.y) * dvdy), vStep = fixed(dvdy);
+            const std::int64_t uLast = uStart + uStep * static_cast<std::int64_t>(count - 1);
+            const std::int64_t vLast = vStart + vStep * (y1 - y0 - 1);
+            const bool clampU = std::min(uStart, uLast) < 0 || (std::max(uStart, uLast) >> 16) >= texW;
+            const bool clampV = std::min(vStart, vLast) < 0 || (std::max(vStart, vLast) >> 16) >= texH;
+            const bool white = a.color == 0xFFFFFFFFu;
+
+            const BlendSpan blend = m_Blend;
+            if (white && uStep == 65536 && !clampU) {
+                if (vStep == 65536 && !clampV) {
+                    std::uint32_t const* src = image.row(static_cast<int>(vStart >> 16)) + (uStart >> 16);
+                    for (int y = y0; y < y1; ++y, src += image.pitch())
+                        blend(target.row(y) + x0, src, count);
+                    return;
+                }
+                std::int64_t vf = vStart;
+                for (int y = y0; y < y1; ++y, vf += vStep) {
+                    const int ty = clampV ? std::min(std::max(static_cast<int>(vf >> 16), 0), texH - 1) : static_cast<int>(vf >> 16);
+                    blend(target.row(y) + x0, image.row(ty) + (uStart >> 16), count);
+                }
+                return;
+            }
+
+            // Sampled (and tinted) once per texel row; magnified quads reuse the span for
+            // the pixel rows that fall on the same texel row.
+            std::uint32_t* span = m_Span.data();
+            int spanRow = -1;
+            std::int64_t vf = vStart;
+            for (int y = y0; y < y1; ++y, vf += vStep) {
+                const int ty = clampV ? std::min(std::max(static_cast<int>(vf >> 16), 0), texH - 1) : static_cast<int>(vf >> 16);
+                if (ty != spanRow) {
+                    std::uint32_t const* texRow = image.row(ty);
+                    std::int64_t uf = uStart;
+                    if (clampU) {
+                        for (std::size_t x = 0; x < count; ++x, uf += uStep)
+                            span[x] = texRow[std::min(std::max(static_cast<int>(uf >> 16), 0), texW - 1)];
+                    }
+                    else {
+                        for (std::size_t x = 0; x < count; ++x, uf += uStep)
+                            span[x] = texRow[uf >> 16];
+                    }
+                    if (!white)
+                        kernels::active().modulate(span, span, count, a.color);
+                    spanRow = ty;
+                }
+                blend(target.row(y) + x0, span, count);
+            }
+        }
+
+    public:
+        void render(SpriteBatch& batch, Surface& target) {
+            batch.prepare();
+            const int width = static_cast<int>(target.width()), height = static_cast<int>(target.height());
+            if (m_Span.size() < target.width())
+                m_Span.resize(target.width());
+            m_Blend = blendFunction(std::is_same<Format, RGBA8>());
+
+            int boundsX0 = width, boundsY0 = height, boundsX1 = 0, boundsY1 = 0;
+            SpriteVertex const* vertices = batch.vertices().data();
+            std::uint32_t const* order = batch.drawOrder().data();
+            for (SpriteRun const& run : batch.runs()) {
+                PixelSurface const* image = run.texture ? &batch.texture(run.texture).image : nullptr;
+                const std::uint32_t end = run.first + run.count;
+                for (std::uint32_t i = run.first; i < end; ++i) {
+                    if (i + prefetchDistance < end) {
+                        prefetch(vertices + std::size_t(order[i + prefetchDistance]) * 4);
+                        prefetch(vertices + std::size_t(order[i + prefetchDistance]) * 4 + 2);
+                    }
+                    SpriteVertex const& a = vertices[std::size_t(order[i]) * 4];
+                    SpriteVertex const& b = vertices[std::size_t(order[i]) * 4 + 2];
+                    const int x0 = std::max(firstCovered(std::min(a.x, b.x)), 0);
+                    const int x1 = std::min(firstCovered(std::max(a.x, b.x)), width);
+                    const int y0 = std::max(firstCovered(std::min(a.y, b.y)), 0);
+                    const int y1 = std::min(firstCovered(std::max(a.y, b.y)), height);
+                    if (x0 >= x1 || y0 >= y1)
+                        continue;
+                    boundsX0 = std::min(boundsX0, x0);
+                    boundsY0 = std::min(boundsY0, y0);
+                    boundsX1 = std::max(boundsX1, x1);
+                    boundsY1 = std::max(boundsY1, y1);
+
+                    if (image) {
+                        texturedQuad(target, *image, a, b, x0, x1, y0, y1);
+                        continue;
+                    }
+                    const std::size_t count = static_cast<std::size_t>(x1 - x0);
+                    if ((a.color >> 24) == 255) {
+                        const Pixel color = Format::fromRGBA8(a.color);
+                        for (int y = y0; y < y1; ++y)
+                            Surface::Ops::fill(target.row(y) + x0, count, color);
+                    }
+                    else if (a.color >> 24) {
+                        std::fill(m_Span.begin(), m_Span.begin() + count, a.color);
+                        for (int y = y0; y < y1; ++y)
+                            m_Blend(target.row(y) + x0, m_Span.data(), count);
+                    }
+                }
+            }
+            if (boundsX0 < boundsX1)
+                target.markDirty(boundsX0, boundsY0, boundsX1 - boundsX0, boundsY1 - boundsY0);
+        }
+    };
+}
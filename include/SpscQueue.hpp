@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace oglw {
+
+    // Bounded wait-free queue for exactly one producer thread and one consumer thread.
+    // Each side keeps a cached copy of the other side's index and only reloads it when
+    // the queue looks full (or empty), so the shared cache lines are touched rarely.
+    template <typename T, std::size_t Capacity>
+    class SpscQueue {
+        static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+        static const std::size_t cacheLine = 64;
+
+        // Consumer side
+        std::atomic<std::size_t> m_Head;
+        std::size_t m_CachedTail = 0;
+        char m_PadConsumer[cacheLine];
+
+        // Producer side
+        std::atomic<std::size_t> m_Tail;
+        std::size_t m_CachedHead = 0;
+        char m_PadProducer[cacheLine];
+
+        T m_Slots[Capacity];
+
+    public:
+        static std::size_t capacity() { return Capacity; }
+
+        // Producer only. Fails if the queue is full.
+        bool tryPush(T const& value) {
+            const std::size_t tail = m_Tail.load(std::memory_order_relaxed);
+            if (tail - m_CachedHead == Capacity) {
+                m_CachedHead = m_Head.load(std::memory_order_acquire);
+                if (tail - m_CachedHead == Capacity)
+                    return false;
+            }
+            m_Slots[tail & (Capacity - 1)] = value;
+            m_Tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer only. Fails if the queue is empty.
+        bool tryPop(T& value) {
+            const std::size_t head = m_Head.load(std::memory_order_relaxed);
+            if (head == m_CachedTail) {
+                m_CachedTail = m_Tail.load(std::memory_order_acquire);
+                if (head == m_CachedTail)
+                    return false;
+            }
+            value = m_Slots[head & (Capacity - 1)];
+            m_Head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer only. Calls f(T const&) on everything queued at the time of the call
+        // (at most max items) and releases the slots in one go. Returns the count.
+        template <typename F>
+        std::size_t consume(F f, std::size_t max = Capacity) {
+            const std::size_t head = m_Head.load(std::memory_order_relaxed);
+            m_CachedTail = m_Tail.load(std::memory_order_acquire);
+            std::size_t count = m_CachedTail - head;
+            if (count > max)
+                count = max;
+            for (std::size_t i = 0; i < count; ++i)
+                f(static_cast<T const&>(m_Slots[(head + i) & (Capacity - 1)]));
+            m_Head.store(head + count, std::memory_order_release);
+            return count;
+        }
+
+        // Exact only when called from one of the two sides with the other one idle.
+        std::size_t sizeApprox() const {
+            return m_Tail.load(std::memory_order_acquire) - m_Head.load(std::memory_order_acquire);
+        }
+
+        SpscQueue() : m_Head(0), m_Tail(0) { }
+        SpscQueue(SpscQueue const&) = delete;
+        SpscQueue& operator=(SpscQueue const&) = delete;
+    };
+}
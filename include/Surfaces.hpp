@@ -0,0 +1,375 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "OpenGLWindow.hpp"
+
+// Offscreen render targets and the registry that owns them, for rendering many views
+// in one process. Surfaces come and go much more cheaply than windows: the registry keeps
+// what they have in common (window class, pixel format, shared GL objects) and recycles
+// the storage of destroyed surfaces for new ones of the same size.
+namespace oglw {
+
+    struct OffscreenParams {
+        unsigned width = 256;
+        unsigned height = 256;
+        // GL: share textures, buffers and display lists with the registry's sharedContext()
+        // and every other sharing surface. No effect on the headless backend.
+        bool shareResources = true;
+    };
+
+    // Offscreen surface on the headless backend: just a pixel surface.
+    class HeadlessSurface {
+        PixelSurface m_Pixels;
+        bool m_Shared;
+        std::size_t m_Slot = 0;     // index in the registry
+
+        friend class HeadlessSurfaceRegistry;
+
+    public:
+        unsigned width() const { return m_Pixels.width(); }
+        unsigned height() const { return m_Pixels.height(); }
+        bool sharesResources() const { return m_Shared; }
+
+        PixelSurface& pixels() { return m_Pixels; }
+        PixelSurface const& pixels() const { return m_Pixels; }
+
+        void makeCurrent() { }
+
+        // width * height RGBA8 pixels, top row first.
+        void readPixels(std::uint32_t* destination) const { m_Pixels.copyTo(destination); }
+
+        HeadlessSurface(OffscreenParams const& params)
+            : m_Pixels(params.width, params.height)
+            , m_Shared(params.shareResources)
+        { }
+    };
+
+    class HeadlessSurfaceRegistry {
+        std::vector<std::unique_ptr<HeadlessSurface>> m_Surfaces;
+        std::vector<std::unique_ptr<HeadlessSurface>> m_Spare;     // destroyed, kept for reuse
+
+        HeadlessSurface& add(std::unique_ptr<HeadlessSurface> s) {
+            s->m_Slot = m_Surfaces.size();
+            m_Surfaces.push_back(std::move(s));
+            return *m_Surfaces.back();
+        }
+
+    public:
+        typedef HeadlessSurface Surface;
+
+        // Contents of a new surface are undefined (recycled surfaces keep their old pixels).
+        HeadlessSurface& create(OffscreenParams const& params = OffscreenParams()) {
+            for (std::size_t i = 0; i < m_Spare.size(); ++i) {
+                if (m_Spare[i]->width() == params.width && m_Spare[i]->height() == params.height) {
+                    std::unique_ptr<HeadlessSurface> s = std::move(m_Spare[i]);
+                    m_Spare[i] = std::move(m_Spare.back());
+                    m_Spare.pop_back();
+                    s->m_Shared = params.shareResources;
+                    return add(std::move(s));
+                }
+            }
+            return add(std::unique_ptr<HeadlessSurface>(new HeadlessSurface(params)));
+        }
+
+        void destroy(HeadlessSurface& surface) {
+            const std::size_t i = surface.m_Slot;
+            if (i >= m_Surfaces.size() || m_Surfaces[i].get() != &surface)
+                return;
+            m_Spare.push_back(std::move(m_Surfaces[i]));
+            m_Surfaces[i] = std::move(m_Surfaces.back());
+            m_Surfaces.pop_back();
+            if (i < m_Surfaces.size())
+                m_Surfaces[i]->m_Slot = i;
+        }
+
+        // Frees the storage kept for recycling.
+        void trim() { m_Spare.clear(); }
+
+        std::size_t size() const { return m_Surfaces.size(); }
+
+        template <typename F>
+        void forEach(F f) {
+            for (auto& s : m_Surfaces)
+                f(*s);
+        }
+    };
+}
+
+#ifdef _WIN32
+
+namespace oglw {
+
+    class WinAPISurfaceRegistry;
+
+    // Offscreen surface on WGL: a context of its own on the registry's hidden window,
+    // rendering into a framebuffer object (RGBA8 color, 24-bit depth, 8-bit stencil).
+    class WinAPISurface {
+        WinAPISurfaceRegistry* m_Registry;
+        HGLRC m_hRC = nullptr;
+        GLuint m_Framebuffer = 0;
+        GLuint m_Renderbuffers[2] = { 0, 0 };
+        unsigned m_Width, m_Height;
+        bool m_Shared;
+        std::size_t m_Slot = 0;
+
+        friend class WinAPISurfaceRegistry;
+
+    public:
+        unsigned width() const { return m_Width; }
+        unsigned height() const { return m_Height; }
+        bool sharesResources() const { return m_Shared; }
+        HGLRC context() const { return m_hRC; }
+
+        // Makes the surface's context current on the calling thread, drawing into its framebuffer.
+        inline void makeCurrent();
+
+        // width * height RGBA8 pixels, top row first. Makes the surface current.
+        inline void readPixels(std::uint32_t* destination);
+
+        WinAPISurface(WinAPISurfaceRegistry* registry, unsigned width, unsigned height, bool shared)
+            : m_Registry(registry), m_Width(width), m_Height(height), m_Shared(shared)
+        { }
+    };
+
+    class WinAPISurfaceRegistry {
+        // ARB_framebuffer_object / GL 3.0 entry points, not in the GL 1.1 headers.
+        typedef void (OGLW_GL_CALLBACK *GenProc)(GLsizei, GLuint*);
+        typedef void (OGLW_GL_CALLBACK *DeleteProc)(GLsizei, const GLuint*);
+        typedef void (OGLW_GL_CALLBACK *BindProc)(GLenum, GLuint);
+        typedef void (OGLW_GL_CALLBACK *RenderbufferStorageProc)(GLenum, GLenum, GLsizei, GLsizei);
+        typedef void (OGLW_GL_CALLBACK *FramebufferRenderbufferProc)(GLenum, GLenum, GLenum, GLuint);
+        typedef GLenum (OGLW_GL_CALLBACK *CheckFramebufferStatusProc)(GLenum);
+
+        static const GLenum glFramebuffer = 0x8D40;
+        static const GLenum glRenderbuffer = 0x8D41;
+        static const GLenum glColorAttachment0 = 0x8CE0;
+        static const GLenum glDepthStencilAttachment = 0x821A;
+        static const GLenum glDepth24Stencil8 = 0x88F0;
+        static const GLenum glFramebufferComplete = 0x8CD5;
+
+        HINSTANCE m_hInstance = nullptr;
+        std::wstring m_ClassName;
+        HWND m_hWnd = nullptr;              // hidden, never shown; only its DC is used
+        HDC m_hDC = nullptr;
+        HGLRC m_SharedContext = nullptr;    // root of the share group, never drawn with
+
+        GenProc m_GenFramebuffers = nullptr, m_GenRenderbuffers = nullptr;
+        DeleteProc m_DeleteFramebuffers = nullptr, m_DeleteRenderbuffers = nullptr;
+        BindProc m_BindFramebuffer = nullptr, m_BindRenderbuffer = nullptr;
+        RenderbufferStorageProc m_RenderbufferStorage = nullptr;
+        FramebufferRenderbufferProc m_FramebufferRenderbuffer = nullptr;
+        CheckFramebufferStatusProc m_CheckFramebufferStatus = nullptr;
+
+        std::vector<std::unique_ptr<WinAPISurface>> m_Surfaces;
+        std::vector<std::unique_ptr<WinAPISurface>> m_Spare;
+
+        friend class WinAPISurface;
+
+        WinAPISurface& add(std::unique_ptr<WinAPISurface> s) {
+            s->m_Slot = m_Surfaces.size();
+            m_Surfaces.push_back(std::move(s));
+            return *m_Surfaces.back();
+        }
+
+        static LRESULT CALLBACK surfaceProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+            return DefWindowProcW(hWnd, uMsg, wParam, lParam);
+        }
+
+        template <typename T>
+        static T load(const char* name) { return reinterpret_cast<T>(wglGetProcAddress(name)); }
+
+        // The hidden window, its pixel format and the share group root, on first use.
+        void setUp() {
+            if (m_hDC)
+                return;
+            m_hInstance = GetModuleHandleW(NULL);
+            m_ClassName = WindowClasses::acquire(m_hInstance, (WNDPROC) surfaceProc);
+            if (m_ClassName.empty())
+                throw WindowCreateException("Failed To Register The Window Class.");
+            m_hWnd = CreateWindowExW(0, m_ClassName.c_str(), L"", WS_POPUP, 0, 0, 1, 1, NULL, NULL, m_hInstance, NULL);
+            if (!m_hWnd || !(m_hDC = GetDC(m_hWnd)))
+                throw WindowCreateException("Can't Create The Offscreen Window.");
+
+            PIXELFORMATDESCRIPTOR pfd;
+            memset(&pfd, 0, sizeof(pfd));
+            pfd.nSize = sizeof(pfd);
+            pfd.nVersion = 1;
+            pfd.dwFlags = PFD_DRAW_TO_WINDOW | PFD_SUPPORT_OPENGL;
+            pfd.iPixelType = PFD_TYPE_RGBA;
+            pfd.cColorBits = 32;
+            pfd.iLayerType = PFD_MAIN_PLANE;
+            const int format = WindowClasses::pixelFormat(m_hDC, pfd);
+            if (!format || !SetPixelFormat(m_hDC, format, &pfd))
+                throw WindowCreateException("Can't Set The PixelFormat.");
+
+            if (!(m_SharedContext = wglCreateContext(m_hDC)))
+                throw WindowCreateException("Can't Create A GL Rendering Context.");
+
+            ContextScope scope(m_hDC, m_SharedContext);
+            m_GenFramebuffers = load<GenProc>("glGenFramebuffers");
+            m_GenRenderbuffers = load<GenProc>("glGenRenderbuffers");
+            m_DeleteFramebuffers = load<DeleteProc>("glDeleteFramebuffers");
+            m_DeleteRenderbuffers = load<DeleteProc>("glDeleteRenderbuffers");
+            m_BindFramebuffer = load<BindProc>("glBindFramebuffer");
+            m_BindRenderbuffer = load<BindProc>("glBindRenderbuffer");
+            m_RenderbufferStorage = load<RenderbufferStorageProc>("glRenderbufferStorage");
+            m_FramebufferRenderbuffer = load<FramebufferRenderbufferProc>("glFramebufferRenderbuffer");
+            m_CheckFramebufferStatus = load<CheckFramebufferStatusProc>("glCheckFramebufferStatus");
+            if (!m_GenFramebuffers || !m_GenRenderbuffers || !m_DeleteFramebuffers || !m_DeleteRenderbuffers
+                || !m_BindFramebuffer || !m_BindRenderbuffer || !m_RenderbufferStorage
+                || !m_FramebufferRenderbuffer || !m_CheckFramebufferStatus)
+                throw WindowCreateException("Offscreen Surfaces Need Framebuffer Objects.");
+        }
+
+        // Restores whatever context was current on the thread.
+        struct ContextScope {
+            HDC dc;
+            HGLRC rc;
+            ContextScope(HDC hDC, HGLRC hRC) : dc(wglGetCurrentDC()), rc(wglGetCurrentContext()) { wglMakeCurrent(hDC, hRC); }
+            ~ContextScope() { wglMakeCurrent(dc, rc); }
+        };
+
+        void release(WinAPISurface& s) {
+            if (!s.m_hRC)
+                return;
+            {
+                ContextScope scope(m_hDC, s.m_hRC);
+                m_DeleteFramebuffers(1, &s.m_Framebuffer);
+                m_DeleteRenderbuffers(2, s.m_Renderbuffers);
+            }
+            wglDeleteContext(s.m_hRC);
+            s.m_hRC = nullptr;
+        }
+
+    public:
+        typedef WinAPISurface Surface;
+
+        // Throws WindowCreateException. Contents of a new surface are undefined.
+        WinAPISurface& create(OffscreenParams const& params = OffscreenParams()) {
+            for (std::size_t i = 0; i < m_Spare.size(); ++i) {
+                WinAPISurface& spare = *m_Spare[i];
+                if (spare.m_Width == params.width && spare.m_Height == params.height && spare.m_Shared == params.shareResources) {
+                    std::unique_ptr<WinAPISurface> s = std::move(m_Spare[i]);
+                    m_Spare[i] = std::move(m_Spare.back());
+                    m_Spare.pop_back();
+                    return add(std::move(s));
+                }
+            }
+
+            setUp();
+            std::unique_ptr<WinAPISurface> s(new WinAPISurface(this, params.width, params.height, params.shareResources));
+            if (!(s->m_hRC = wglCreateContext(m_hDC)))
+                throw WindowCreateException("Can't Create A GL Rendering Context.");
+            if (params.shareResources && !wglShareLists(m_SharedContext, s->m_hRC)) {
+                wglDeleteContext(s->m_hRC);
+                throw WindowCreateException("Can't Share GL Resources.");
+            }
+
+            ContextScope scope(m_hDC, s->m_hRC);
+            m_GenFramebuffers(1, &s->m_Framebuffer);
+            m_GenRenderbuffers(2, s->m_Renderbuffers);
+            m_BindRenderbuffer(glRenderbuffer, s->m_Renderbuffers[0]);
+            m_RenderbufferStorage(glRenderbuffer, GL_RGBA8, params.width, params.height);
+            m_BindRenderbuffer(glRenderbuffer, s->m_Renderbuffers[1]);
+            m_RenderbufferStorage(glRenderbuffer, glDepth24Stencil8, params.width, params.height);
+            m_BindFramebuffer(glFramebuffer, s->m_Framebuffer);
+            m_FramebufferRenderbuffer(glFramebuffer, glColorAttachment0, glRenderbuffer, s->m_Renderbuffers[0]);
+            m_FramebufferRenderbuffer(glFramebuffer, glDepthStencilAttachment, glRenderbuffer, s->m_Renderbuffers[1]);
+            if (m_CheckFramebufferStatus(glFramebuffer) != glFramebufferComplete) {
+                release(*s);
+                throw WindowCreateException("Offscreen Framebuffer Is Incomplete.");
+            }
+            glViewport(0, 0, params.width, params.height);
+
+            return add(std::move(s));
+        }
+
+        // The surface's GL objects are kept and reused by the next create() of the same size.
+        void destroy(WinAPISurface& surface) {
+            const std::size_t i = surface.m_Slot;
+            if (i >= m_Surfaces.size() || m_Surfaces[i].get() != &surface)
+                return;
+            m_Spare.push_back(std::move(m_Surfaces[i]));
+            m_Surfaces[i] = std::move(m_Surfaces.back());
+            m_Surfaces.pop_back();
+            if (i < m_Surfaces.size())
+                m_Surfaces[i]->m_Slot = i;
+        }
+
+        void trim() {
+            for (auto& s : m_Spare)
+                release(*s);
+            m_Spare.clear();
+        }
+
+        std::size_t size() const { return m_Surfaces.size(); }
+
+        template <typename F>
+        void forEach(F f) {
+            for (auto& s : m_Surfaces)
+                f(*s);
+        }
+
+        // Windows can join the share group with window.shareResources(registry.sharedContext()).
+        HGLRC sharedContext() {
+            setUp();
+            return m_SharedContext;
+        }
+
+        WinAPISurfaceRegistry() = default;
+        WinAPISurfaceRegistry(WinAPISurfaceRegistry const&) = delete;
+        WinAPISurfaceRegistry& operator=(WinAPISurfaceRegistry const&) = delete;
+
+        ~WinAPISurfaceRegistry() {
+            trim();
+            for (auto& s : m_Surfaces)
+                release(*s);
+            if (m_SharedContext)
+                wglDeleteContext(m_SharedContext);
+            if (m_hDC)
+                ReleaseDC(m_hWnd, m_hDC);
+            if (m_hWnd)
+                DestroyWindow(m_hWnd);
+            if (!m_ClassName.empty())
+                WindowClasses::release(m_hInstance, (WNDPROC) surfaceProc);
+        }
+    };
+
+    void WinAPISurface::makeCurrent() {
+        wglMakeCurrent(m_Registry->m_hDC, m_hRC);
+        m_Registry->m_BindFramebuffer(WinAPISurfaceRegistry::glFramebuffer, m_Framebuffer);
+    }
+
+    void WinAPISurface::readPixels(std::uint32_t* destination) {
+        makeCurrent();
+        glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+        glReadPixels(0, 0, m_Width, m_Height, GL_RGBA, GL_UNSIGNED_BYTE, destination);
+        glPopClientAttrib();
+
+        // GL rows are bottom to top
+        std::vector<std::uint32_t> row(m_Width);
+        for (unsigned y = 0; y < m_Height / 2; ++y) {
+            std::uint32_t* a = destination + static_cast<std::size_t>(y) * m_Width;
+            std::uint32_t* b = destination + static_cast<std::size_t>(m_Height - 1 - y) * m_Width;
+            std::copy(a, a + m_Width, row.begin());
+            std::copy(b, b + m_Width, a);
+            std::copy(row.begin(), row.end(), b);
+        }
+    }
+}
+
+#endif // _WIN32
+
+namespace oglw {
+#if defined(_WIN32) && !defined(OGLW_HEADLESS)
+    typedef WinAPISurfaceRegistry SurfaceRegistry;
+#else
+    typedef HeadlessSurfaceRegistry SurfaceRegistry;
+#endif
+    typedef SurfaceRegistry::Surface OffscreenSurface;
+}
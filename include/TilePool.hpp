@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace oglw {
+
+    // Fixed set of worker threads for data-parallel frame work. parallelFor() splits the
+    // index range evenly between the workers and the calling thread; whoever runs out
+    // steals half of the remaining range of another. Ranges are packed into one atomic
+    // word each, so claiming and stealing are single compare-and-swaps.
+    class TilePool {
+        // Padded so that no two workers' ranges share a cache line.
+        struct Range {
+            std::atomic<std::uint64_t> bounds;      // begin << 32 | end
+            char pad[64 - sizeof(std::atomic<std::uint64_t>)];
+
+            Range() : bounds(0) { }
+        };
+
+        static std::uint64_t pack(std::uint32_t begin, std::uint32_t end) { return (std::uint64_t(begin) << 32) | end; }
+        static std::uint32_t beginOf(std::uint64_t r) { return static_cast<std::uint32_t>(r >> 32); }
+        static std::uint32_t endOf(std::uint64_t r) { return static_cast<std::uint32_t>(r); }
+
+        unsigned m_Workers;                         // including the calling thread
+        std::unique_ptr<Range[]> m_Ranges;
+        std::vector<std::thread> m_Threads;
+
+        // Current job; written before m_Generation is bumped under m_Mutex.
+        void (*m_Run)(void*, unsigned, unsigned) = nullptr;
+        void* m_Context = nullptr;
+
+        std::mutex m_Mutex;
+        std::condition_variable m_Wake;
+        unsigned long long m_Generation = 0;
+        bool m_Stopping = false;
+        std::atomic<unsigned> m_Finished;
+
+        bool claim(unsigned self, std::uint32_t& index) {
+            std::atomic<std::uint64_t>& own = m_Ranges[self].bounds;
+            std::uint64_t r = own.load(std::memory_order_acquire);
+            while (beginOf(r) < endOf(r)) {
+                if (own.compare_exchange_weak(r, pack(beginOf(r) + 1, endOf(r)), std::memory_order_acq_rel)) {
+                    index = beginOf(r);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Moves the upper half of someone's range into ours.
+        bool steal(unsigned self) {
+            for (unsigned k = 1; k < m_Workers; ++k) {
+                std::atomic<std::uint64_t>& victim = m_Ranges[(self + k) % m_Workers].bounds;
+                std::uint64_t r = victim.load(std::memory_order_acquire);
+                while (beginOf(r) < endOf(r)) {
+                    const std::uint32_t remaining = endOf(r) - beginOf(r);
+                    const std::uint32_t split = endOf(r) - (remaining + 1) / 2;
+                    if (victim.compare_exchange_weak(r, pack(beginOf(r), split), std::memory_order_acq_rel)) {
+                        m_Ranges[self].bounds.store(pack(split, endOf(r)), std::memory_order_release);
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        void work(unsigned self) {
+            std::uint32_t index;
+            do {
+                while (claim(self, index))
+                    m_Run(m_Context, index, self);
+            } while (steal(self));
+        }
+
+        void workerLoop(unsigned self) {
+            unsigned long long seen = 0;
+            for (;;) {
+                {
+                    std::unique_lock<std::mutex> lock(m_Mutex);
+                    m_Wake.wait(lock, [&] { return m_Generation != seen || m_Stopping; });
+                    if (m_Stopping)
+                        return;
+                    seen = m_Generation;
+                }
+                work(self);
+                m_Finished.fetch_add(1, std::memory_order_acq_rel);
+            }
+        }
+
+        template <typename F>
+        static void invoke(void* f, unsigned index, unsigned worker) { (*static_cast<F*>(f))(index, worker); }
+
+    public:
+        // 0 threads: one per hardware thread.
+        explicit TilePool(unsigned threads = 0)
+            : m_Finished(0)
+        {
+            if (threads == 0)
+                threads = std::thread::hardware_concurrency();
+            m_Workers = threads ? threads : 1;
+            m_Ranges.reset(new Range[m_Workers]);
+            for (unsigned i = 1; i < m_Workers; ++i)
+                m_Threads.emplace_back([this, i] { workerLoop(i); });
+        }
+
+        TilePool(TilePool const&) = delete;
+        TilePool& operator=(TilePool const&) = delete;
+
+        ~TilePool() {
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Stopping = true;
+            }
+            m_Wake.notify_all();
+            for (auto& t : m_Threads)
+                t.join();
+        }
+
+        unsigned threads() const { return m_Workers; }
+
+        // Calls f(index, worker) for every index in [0, count), worker being 0..threads()-1.
+        // Returns once all calls have returned. Not reentrant.
+        template <typename F>
+        void parallelFor(std::uint32_t count, F f) {
+            if (m_Workers == 1 || count <= 1) {
+                for (std::uint32_t i = 0; i < count; ++i)
+                    f(i, 0u);
+                return;
+            }
+
+            for (unsigned w = 0; w < m_Workers; ++w) {
+                const std::uint32_t begin = static_cast<std::uint32_t>(std::uint64_t(count) * w / m_Workers);
+                const std::uint32_t end = static_cast<std::uint32_t>(std::uint64_t(count) * (w + 1) / m_Workers);
+                m_Ranges[w].bounds.store(pack(begin, end), std::memory_order_relaxed);
+            }
+            m_Finished.store(0, std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Run = &invoke<F>;
+                m_Context = &f;
+                ++m_Generation;
+            }
+            m_Wake.notify_all();
+
+            work(0);
+
+            // Barrier: every worker has run out of work and is done with f.
+            while (m_Finished.load(std::memory_order_acquire) != m_Workers - 1)
+                std::this_thread::yield();
+        }
+    };
+}